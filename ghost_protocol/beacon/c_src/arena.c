@@ -0,0 +1,148 @@
+/*
+ * Ghost Protocol Beacon - Arena Allocator Implementation
+ * Bump allocation scoped to one check-in cycle
+ */
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN_UP(n) (((n) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define BLOCK_DATA(block) ((char*)(block) + ALIGN_UP(sizeof(arena_block_t)))
+
+static arena_block_t* block_create(size_t size) {
+    arena_block_t* block = malloc(ALIGN_UP(sizeof(arena_block_t)) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+int arena_init(arena_t* arena, size_t block_size) {
+    memset(arena, 0, sizeof(arena_t));
+    arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->head = block_create(arena->block_size);
+    if (!arena->head) {
+        return -1;
+    }
+    arena->current = arena->head;
+    return 0;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size_t needed = ALIGN_UP(size > 0 ? size : 1);
+    arena_block_t* block = arena->current;
+    
+    if (!block || block->size - block->used < needed) {
+        // Reuse a block kept from an earlier cycle before allocating a new one
+        arena_block_t* next = block ? block->next : NULL;
+        if (next && next->size >= needed) {
+            block = next;
+        } else {
+            size_t block_size = arena->block_size;
+            while (block_size < needed) {
+                block_size *= 2;
+            }
+            arena_block_t* created = block_create(block_size);
+            if (!created) {
+                return NULL;
+            }
+            if (block) {
+                created->next = block->next;
+                block->next = created;
+            } else {
+                arena->head = created;
+            }
+            block = created;
+        }
+        block->used = 0;
+        arena->current = block;
+    }
+    
+    void* ptr = BLOCK_DATA(block) + block->used;
+    block->used += needed;
+    arena->last = ptr;
+    return ptr;
+}
+
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return arena_alloc(arena, new_size);
+    }
+    
+    // The newest allocation can simply extend into the rest of its block
+    arena_block_t* block = arena->current;
+    if (ptr == arena->last && block) {
+        size_t offset = (char*)ptr - BLOCK_DATA(block);
+        size_t needed = ALIGN_UP(new_size > 0 ? new_size : 1);
+        if (block->size - offset >= needed) {
+            block->used = offset + needed;
+            return ptr;
+        }
+    }
+    
+    void* grown = arena_alloc(arena, new_size);
+    if (grown) {
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return grown;
+}
+
+void arena_reset(arena_t* arena) {
+    size_t total = 0;
+    int block_count = 0;
+    
+    for (arena_block_t* block = arena->head; block; block = block->next) {
+        total += block->used;
+        block_count++;
+        block->used = 0;
+        if (block == arena->current) {
+            break;
+        }
+    }
+    arena->recent[arena->cycle++ % ARENA_HISTORY] = total;
+    
+    // Sized for the busiest of the recent cycles, so one large reply or upload window is
+    // given back once it has aged out instead of staying pinned for the beacon's lifetime
+    size_t wanted = 0;
+    for (int i = 0; i < ARENA_HISTORY; i++) {
+        if (arena->recent[i] > wanted) {
+            wanted = arena->recent[i];
+        }
+    }
+    if (wanted > ARENA_MAX_RETAINED) {
+        wanted = ARENA_MAX_RETAINED;
+    }
+    size_t block_size = arena->block_size;
+    while (block_size < wanted) {
+        block_size *= 2;
+    }
+    
+    // A cycle that spilled over several blocks gets one block big enough for next time,
+    // so the steady state never touches the heap
+    if (block_count > 1 || (arena->head && (arena->head->size != block_size || arena->head->next))) {
+        arena_block_t* merged = block_create(block_size);
+        if (merged) {
+            arena_destroy(arena);
+            arena->head = merged;
+        }
+    }
+    
+    arena->current = arena->head;
+    arena->last = NULL;
+}
+
+void arena_destroy(arena_t* arena) {
+    arena_block_t* block = arena->head;
+    while (block) {
+        arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->last = NULL;
+}
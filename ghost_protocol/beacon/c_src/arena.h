@@ -0,0 +1,40 @@
+/*
+ * Ghost Protocol Beacon - Arena Allocator
+ * Header file for the per-check-in bump allocator
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+#define ARENA_HISTORY 16                  // cycles the retained block is sized over
+#define ARENA_MAX_RETAINED (1024 * 1024)  // larger cycles go back to the heap when they end
+
+// One contiguous chunk of arena memory; the usable bytes follow the header
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+} arena_block_t;
+
+// Bump allocator; everything it hands out is released together by arena_reset
+typedef struct {
+    arena_block_t* head;
+    arena_block_t* current;
+    size_t block_size;
+    void* last;            // most recent allocation, which can grow in place
+    size_t recent[ARENA_HISTORY];   // bytes used by each of the last cycles
+    int cycle;
+} arena_t;
+
+// Arena functions
+int arena_init(arena_t* arena, size_t block_size);
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_realloc(arena_t* arena, void* ptr, size_t old_size, size_t new_size);
+void arena_reset(arena_t* arena);
+void arena_destroy(arena_t* arena);
+
+#endif // ARENA_H
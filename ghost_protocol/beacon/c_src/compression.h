@@ -0,0 +1,29 @@
+/*
+ * Ghost Protocol Beacon - Compression Module
+ * Header file for the deflate codec used on check-in bodies
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include "beacon.h"
+
+// Bodies below this size go out as-is; deflate framing would eat the savings
+#define COMPRESS_MIN_SIZE 1024
+
+// Upper bound for an inflated command batch, so a hostile body cannot exhaust memory
+#define COMPRESS_MAX_INFLATED (64 * 1024 * 1024)
+
+// Content-Encoding values understood on the wire
+typedef enum {
+    CONTENT_IDENTITY = 0,
+    CONTENT_DEFLATE,
+    CONTENT_UNKNOWN
+} content_encoding_t;
+
+// Compression functions (zlib-wrapped deflate, as HTTP "deflate" specifies)
+int compression_available(void);
+int compress_deflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length);
+int compress_inflate(arena_t* arena, const char* data, size_t length, char** output, size_t* output_length);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,200 @@
+/*
+ * Ghost Protocol Beacon - Event Loop Implementation
+ * Level-triggered readiness over epoll, kqueue or poll(), one interface for all three
+ */
+
+#include "event_loop.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+
+#if defined(EVENT_LOOP_EPOLL)
+#include <sys/epoll.h>
+#elif defined(EVENT_LOOP_KQUEUE)
+#include <sys/event.h>
+#else
+#include <poll.h>
+#endif
+
+long event_loop_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int event_loop_init(event_loop_t* loop) {
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->backend_fd = -1;
+
+#if defined(EVENT_LOOP_EPOLL)
+    loop->backend_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->backend_fd < 0) {
+        return -1;
+    }
+#elif defined(EVENT_LOOP_KQUEUE)
+    loop->backend_fd = kqueue();
+    if (loop->backend_fd < 0) {
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+static int reserve_watch(event_loop_t* loop, int fd) {
+    if (fd < loop->capacity) {
+        return 0;
+    }
+    
+    int capacity = loop->capacity > 0 ? loop->capacity : 64;
+    while (capacity <= fd) {
+        capacity *= 2;
+    }
+    event_watch_t* grown = realloc(loop->watches, capacity * sizeof(event_watch_t));
+    if (!grown) {
+        return -1;
+    }
+    memset(grown + loop->capacity, 0, (capacity - loop->capacity) * sizeof(event_watch_t));
+    loop->watches = grown;
+    loop->capacity = capacity;
+    return 0;
+}
+
+// Replaces the interest for fd; 0 stops watching it. Must be cleared before fd is closed
+int event_loop_set(event_loop_t* loop, int fd, int events, void* data) {
+    if (fd < 0 || reserve_watch(loop, fd) != 0) {
+        return -1;
+    }
+    
+    event_watch_t* watch = &loop->watches[fd];
+    int previous = watch->events;
+    events &= EVENT_READ | EVENT_WRITE;
+    watch->data = data;
+    if (events == previous) {
+        return 0;
+    }
+
+#if defined(EVENT_LOOP_EPOLL)
+    struct epoll_event change;
+    memset(&change, 0, sizeof(change));
+    change.events = (events & EVENT_READ ? EPOLLIN : 0) | (events & EVENT_WRITE ? EPOLLOUT : 0);
+    change.data.fd = fd;
+    int op = previous == 0 ? EPOLL_CTL_ADD : events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+    if (epoll_ctl(loop->backend_fd, op, fd, &change) != 0) {
+        return -1;
+    }
+#elif defined(EVENT_LOOP_KQUEUE)
+    // kqueue filters are per direction, so only the ones that changed are touched
+    struct kevent changes[2];
+    int count = 0;
+    if ((events ^ previous) & EVENT_READ) {
+        EV_SET(&changes[count++], fd, EVFILT_READ, events & EVENT_READ ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    }
+    if ((events ^ previous) & EVENT_WRITE) {
+        EV_SET(&changes[count++], fd, EVFILT_WRITE, events & EVENT_WRITE ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    }
+    if (kevent(loop->backend_fd, changes, count, NULL, 0, NULL) != 0) {
+        return -1;
+    }
+#endif
+
+    watch->events = events;
+    loop->watched += (events != 0) - (previous != 0);
+    if (events == 0) {
+        watch->data = NULL;
+    }
+    return 0;
+}
+
+// Collects up to max_ready descriptors that are ready; returns the count, 0 on timeout
+// or a signal, -1 on error. timeout_ms < 0 waits indefinitely
+int event_loop_wait(event_loop_t* loop, event_t* ready, int max_ready, int timeout_ms) {
+    int count = 0;
+    if (max_ready > EVENT_LOOP_MAX_READY) {
+        max_ready = EVENT_LOOP_MAX_READY;
+    }
+
+#if defined(EVENT_LOOP_EPOLL)
+    struct epoll_event fired[EVENT_LOOP_MAX_READY];
+    int fired_count = epoll_wait(loop->backend_fd, fired, max_ready, timeout_ms);
+    if (fired_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < fired_count; i++) {
+        int fd = fired[i].data.fd;
+        ready[count].fd = fd;
+        ready[count].events = (fired[i].events & EPOLLIN ? EVENT_READ : 0) |
+                              (fired[i].events & EPOLLOUT ? EVENT_WRITE : 0) |
+                              (fired[i].events & (EPOLLERR | EPOLLHUP) ? EVENT_ERROR : 0);
+        ready[count].data = loop->watches[fd].data;
+        count++;
+    }
+#elif defined(EVENT_LOOP_KQUEUE)
+    struct kevent fired[EVENT_LOOP_MAX_READY];
+    struct timespec timeout = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+    int fired_count = kevent(loop->backend_fd, NULL, 0, fired, max_ready, timeout_ms < 0 ? NULL : &timeout);
+    if (fired_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    // A descriptor ready both ways comes back as two reports; they are merged into one
+    for (int i = 0; i < fired_count; i++) {
+        int fd = (int)fired[i].ident;
+        int events = (fired[i].filter == EVFILT_READ ? EVENT_READ : EVENT_WRITE) |
+                     (fired[i].flags & (EV_EOF | EV_ERROR) ? EVENT_ERROR : 0);
+        int merged = 0;
+        for (int j = 0; j < count; j++) {
+            if (ready[j].fd == fd) {
+                ready[j].events |= events;
+                merged = 1;
+                break;
+            }
+        }
+        if (!merged) {
+            ready[count].fd = fd;
+            ready[count].events = events;
+            ready[count].data = loop->watches[fd].data;
+            count++;
+        }
+    }
+#else
+    // Rebuilt per call; the poll() fallback is for small descriptor counts
+    struct pollfd fds[EVENT_LOOP_MAX_READY];
+    int polled = 0;
+    for (int fd = 0; fd < loop->capacity && polled < EVENT_LOOP_MAX_READY; fd++) {
+        int events = loop->watches[fd].events;
+        if (events) {
+            fds[polled].fd = fd;
+            fds[polled].events = (events & EVENT_READ ? POLLIN : 0) | (events & EVENT_WRITE ? POLLOUT : 0);
+            fds[polled].revents = 0;
+            polled++;
+        }
+    }
+    int fired_count = poll(fds, polled, timeout_ms);
+    if (fired_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < polled && count < max_ready; i++) {
+        if (fds[i].revents) {
+            ready[count].fd = fds[i].fd;
+            ready[count].events = (fds[i].revents & POLLIN ? EVENT_READ : 0) |
+                                  (fds[i].revents & POLLOUT ? EVENT_WRITE : 0) |
+                                  (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL) ? EVENT_ERROR : 0);
+            ready[count].data = loop->watches[fds[i].fd].data;
+            count++;
+        }
+    }
+#endif
+
+    return count;
+}
+
+void event_loop_destroy(event_loop_t* loop) {
+    if (loop->backend_fd >= 0) {
+        close(loop->backend_fd);
+    }
+    free(loop->watches);
+    memset(loop, 0, sizeof(event_loop_t));
+    loop->backend_fd = -1;
+}
+
+#endif
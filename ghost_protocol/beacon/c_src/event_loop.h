@@ -0,0 +1,60 @@
+/*
+ * Ghost Protocol Beacon - Event Loop Module
+ * Header file for the socket readiness loop behind the non-blocking transport
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "beacon.h"
+
+#ifndef _WIN32
+
+// epoll on Linux, kqueue on the BSDs and macOS, poll() anywhere else
+#if defined(__linux__)
+#define EVENT_LOOP_EPOLL
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define EVENT_LOOP_KQUEUE
+#else
+#define EVENT_LOOP_POLL
+#endif
+
+#define EVENT_READ 1
+#define EVENT_WRITE 2
+#define EVENT_ERROR 4             // reported only, never requested
+
+#define EVENT_LOOP_MAX_READY 64   // readiness reports collected per wait
+
+// Interest registered for one descriptor
+typedef struct {
+    int events;
+    void* data;
+} event_watch_t;
+
+// One readiness report from event_loop_wait
+typedef struct {
+    int fd;
+    int events;
+    void* data;
+} event_t;
+
+// Watches are indexed by descriptor, which the kernel keeps small and dense
+typedef struct {
+    int backend_fd;           // epoll or kqueue descriptor, -1 with poll()
+    event_watch_t* watches;
+    int capacity;
+    int watched;              // descriptors with a non-zero interest
+} event_loop_t;
+
+// Event loop functions
+int event_loop_init(event_loop_t* loop);
+int event_loop_set(event_loop_t* loop, int fd, int events, void* data);
+int event_loop_wait(event_loop_t* loop, event_t* ready, int max_ready, int timeout_ms);
+void event_loop_destroy(event_loop_t* loop);
+
+// Shared clock for I/O deadlines
+long event_loop_now_ms(void);
+
+#endif
+
+#endif // EVENT_LOOP_H
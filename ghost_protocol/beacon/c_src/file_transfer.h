@@ -0,0 +1,33 @@
+/*
+ * Ghost Protocol Beacon - File Transfer
+ * Header file for range-addressed, resumable uploads and downloads
+ */
+
+#ifndef FILE_TRANSFER_H
+#define FILE_TRANSFER_H
+
+#include "beacon.h"
+
+#define TRANSFER_MAX_STREAMS 8
+#define TRANSFER_CHUNK_SIZE ((MAX_OUTPUT_SIZE / 4) * 3)   // file bytes per chunk; base64 fits MAX_OUTPUT_SIZE
+
+// One download, read from the file in place and handed out a chunk at a time
+typedef struct {
+    int in_use;
+    char command_id[COMMAND_ID_MAX];
+#ifdef _WIN32
+    HANDLE file;
+#else
+    int fd;
+#endif
+    long long size;       // length when the transfer started; later growth is not sent
+    long long offset;     // next byte to hand out
+} file_transfer_t;
+
+// Transfer functions
+int transfer_init(void);
+int transfer_collect(arena_t* arena, result_record_t** results, int max_results);
+int transfer_pending(void);
+void transfer_shutdown(void);
+
+#endif // FILE_TRANSFER_H
@@ -0,0 +1,237 @@
+/*
+ * Ghost Protocol Beacon - HTTP Response Parser Implementation
+ * Parses the status line, headers and Content-Length or chunked bodies as bytes arrive
+ */
+
+#include "http_parser.h"
+#include <ctype.h>
+
+void http_parser_init(http_parser_t* parser) {
+    memset(parser, 0, sizeof(http_parser_t));
+    parser->state = HTTP_PARSE_STATUS;
+    parser->content_length = -1;
+}
+
+static int value_starts_with(const char* value, const char* token) {
+    while (*value == ' ' || *value == '\t') value++;
+    return strncasecmp(value, token, strlen(token)) == 0;
+}
+
+// Matches one comma-separated token anywhere in a header value
+static int value_has_token(const char* value, const char* token) {
+    size_t token_len = strlen(token);
+    while (*value) {
+        while (*value == ' ' || *value == '\t' || *value == ',') value++;
+        if (strncasecmp(value, token, token_len) == 0 &&
+            (value[token_len] == '\0' || value[token_len] == ',' ||
+             value[token_len] == ';' || value[token_len] == ' ')) {
+            return 1;
+        }
+        while (*value && *value != ',') value++;
+    }
+    return 0;
+}
+
+static int header_is(const char* line, const char* name, const char** value) {
+    size_t name_len = strlen(name);
+    if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+        return 0;
+    }
+    *value = line + name_len + 1;
+    while (**value == ' ' || **value == '\t') (*value)++;
+    return 1;
+}
+
+static void parse_status_line(http_parser_t* parser, const char* line) {
+    // "HTTP/1.1 200 OK"
+    if (strncmp(line, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)line[7]) || line[8] != ' ') {
+        parser->state = HTTP_PARSE_ERROR;
+        return;
+    }
+    parser->keep_alive = line[7] != '0';   // HTTP/1.0 closes unless told otherwise
+    parser->status_code = atoi(line + 9);
+    parser->state = HTTP_PARSE_HEADERS;
+}
+
+static void parse_header_line(http_parser_t* parser, const char* line) {
+    const char* value;
+    
+    if (header_is(line, "Content-Length", &value)) {
+        parser->content_length = strtol(value, NULL, 10);
+    } else if (header_is(line, "Transfer-Encoding", &value)) {
+        parser->chunked = strstr(value, "chunked") != NULL;
+    } else if (header_is(line, "Content-Encoding", &value)) {
+        if (value_starts_with(value, "deflate")) {
+            parser->encoding = CONTENT_DEFLATE;
+        } else if (!value_starts_with(value, "identity") && *value) {
+            parser->encoding = CONTENT_UNKNOWN;
+        }
+    } else if (header_is(line, "Accept-Encoding", &value)) {
+        parser->accepts_deflate = value_has_token(value, "deflate");
+    } else if (header_is(line, "X-Long-Poll", &value)) {
+        parser->long_poll = atoi(value);
+    } else if (header_is(line, "Connection", &value)) {
+        if (value_starts_with(value, "close")) {
+            parser->keep_alive = 0;
+        } else if (value_starts_with(value, "keep-alive")) {
+            parser->keep_alive = 1;
+        }
+    }
+}
+
+// Picks the body framing once the header block is complete and sizes the buffer
+static void finish_headers(http_parser_t* parser, http_response_t* response) {
+    response->status_code = parser->status_code;
+    response->encoding = parser->encoding;
+    response->accepts_deflate = parser->accepts_deflate;
+    response->long_poll = parser->long_poll;
+    
+    // Interim 1xx responses are followed by the real one
+    if (parser->status_code >= 100 && parser->status_code < 200) {
+        http_parser_init(parser);
+        return;
+    }
+    
+    if (parser->status_code == 204 || parser->status_code == 304) {
+        parser->state = HTTP_PARSE_DONE;
+    } else if (parser->chunked) {
+        parser->state = HTTP_PARSE_CHUNK_SIZE;
+    } else if (parser->content_length > HTTP_MAX_BODY) {
+        // The length comes from the server unchecked; never reserve a hostile one
+        parser->state = HTTP_PARSE_ERROR;
+        return;
+    } else if (parser->content_length >= 0) {
+        parser->remaining = (size_t)parser->content_length;
+        parser->state = parser->remaining > 0 ? HTTP_PARSE_BODY : HTTP_PARSE_DONE;
+    } else {
+        parser->keep_alive = 0;
+        parser->state = HTTP_PARSE_BODY_UNTIL_CLOSE;
+    }
+    
+    // The announced length is allocated exactly once; other framings grow as needed
+    if (http_response_reserve(response, parser->remaining) != 0) {
+        parser->state = HTTP_PARSE_ERROR;
+        return;
+    }
+    response->data[response->size] = '\0';
+}
+
+static void handle_line(http_parser_t* parser, http_response_t* response) {
+    char* line = parser->line;
+    line[parser->line_len] = '\0';
+    if (parser->line_len > 0 && line[parser->line_len - 1] == '\r') {
+        line[--parser->line_len] = '\0';
+    }
+    
+    switch (parser->state) {
+        case HTTP_PARSE_STATUS:
+            parse_status_line(parser, line);
+            break;
+        case HTTP_PARSE_HEADERS:
+            if (parser->line_len == 0) {
+                finish_headers(parser, response);
+            } else {
+                parse_header_line(parser, line);
+            }
+            break;
+        case HTTP_PARSE_CHUNK_SIZE: {
+            char* end;
+            unsigned long size = strtoul(line, &end, 16);
+            if (end == line) {
+                parser->state = HTTP_PARSE_ERROR;
+            } else if (size == 0) {
+                parser->state = HTTP_PARSE_TRAILERS;
+            } else {
+                parser->remaining = size;
+                parser->state = HTTP_PARSE_CHUNK_DATA;
+            }
+            break;
+        }
+        case HTTP_PARSE_CHUNK_END:
+            parser->state = parser->line_len == 0 ? HTTP_PARSE_CHUNK_SIZE : HTTP_PARSE_ERROR;
+            break;
+        case HTTP_PARSE_TRAILERS:
+            if (parser->line_len == 0) {
+                parser->state = HTTP_PARSE_DONE;
+            }
+            break;
+        default:
+            break;
+    }
+    
+    parser->line_len = 0;
+}
+
+static void advance_body_state(http_parser_t* parser) {
+    if (parser->remaining == 0) {
+        if (parser->state == HTTP_PARSE_BODY) {
+            parser->state = HTTP_PARSE_DONE;
+        } else if (parser->state == HTTP_PARSE_CHUNK_DATA) {
+            parser->state = HTTP_PARSE_CHUNK_END;
+        }
+    }
+}
+
+static int line_state(http_parse_state_t state) {
+    return state == HTTP_PARSE_STATUS || state == HTTP_PARSE_HEADERS ||
+           state == HTTP_PARSE_CHUNK_SIZE || state == HTTP_PARSE_CHUNK_END ||
+           state == HTTP_PARSE_TRAILERS;
+}
+
+// Consumes bytes until the response is complete; returns the number of bytes used or -1
+long http_parser_feed(http_parser_t* parser, http_response_t* response, const char* data, size_t length) {
+    size_t pos = 0;
+    
+    while (pos < length && parser->state != HTTP_PARSE_DONE && parser->state != HTTP_PARSE_ERROR) {
+        if (line_state(parser->state)) {
+            const char* newline = memchr(data + pos, '\n', length - pos);
+            size_t take = newline ? (size_t)(newline - (data + pos)) : length - pos;
+            
+            // Overlong lines are truncated; nothing we act on is that long
+            size_t room = sizeof(parser->line) - 1 - parser->line_len;
+            memcpy(parser->line + parser->line_len, data + pos, take < room ? take : room);
+            parser->line_len += take < room ? take : room;
+            pos += take;
+            
+            if (newline) {
+                pos++;
+                handle_line(parser, response);
+            }
+            continue;
+        }
+        
+        size_t take = length - pos;
+        if (parser->state != HTTP_PARSE_BODY_UNTIL_CLOSE && take > parser->remaining) {
+            take = parser->remaining;
+        }
+        if (response->size + take > HTTP_MAX_BODY || http_response_append(response, data + pos, take) != 0) {
+            parser->state = HTTP_PARSE_ERROR;
+            break;
+        }
+        pos += take;
+        if (parser->state != HTTP_PARSE_BODY_UNTIL_CLOSE) {
+            parser->remaining -= take;
+        }
+        advance_body_state(parser);
+    }
+    
+    return parser->state == HTTP_PARSE_ERROR ? -1 : (long)pos;
+}
+
+// Accounts for `length` body bytes the caller received straight into response->data
+void http_parser_body_received(http_parser_t* parser, http_response_t* response, size_t length) {
+    response->size += length;
+    response->data[response->size] = '\0';
+    if (parser->state != HTTP_PARSE_BODY_UNTIL_CLOSE) {
+        parser->remaining -= length;
+    }
+    advance_body_state(parser);
+}
+
+// Called when the peer closes the connection; returns 0 if the response is complete
+int http_parser_finish(http_parser_t* parser) {
+    if (parser->state == HTTP_PARSE_BODY_UNTIL_CLOSE) {
+        parser->state = HTTP_PARSE_DONE;
+    }
+    return parser->state == HTTP_PARSE_DONE ? 0 : -1;
+}
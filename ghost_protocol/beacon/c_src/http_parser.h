@@ -0,0 +1,50 @@
+/*
+ * Ghost Protocol Beacon - HTTP Response Parser
+ * Header file for the incremental HTTP/1.x response parser
+ */
+
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include "communication.h"
+#include "compression.h"
+
+#define HTTP_MAX_LINE 2048
+#define HTTP_MAX_BODY COMPRESS_MAX_INFLATED   // larger replies are refused, whatever their framing
+
+// Parser states
+typedef enum {
+    HTTP_PARSE_STATUS = 0,
+    HTTP_PARSE_HEADERS,
+    HTTP_PARSE_BODY,            // Content-Length delimited
+    HTTP_PARSE_BODY_UNTIL_CLOSE,
+    HTTP_PARSE_CHUNK_SIZE,
+    HTTP_PARSE_CHUNK_DATA,
+    HTTP_PARSE_CHUNK_END,
+    HTTP_PARSE_TRAILERS,
+    HTTP_PARSE_DONE,
+    HTTP_PARSE_ERROR
+} http_parse_state_t;
+
+// Incremental parser; only the body is stored in the response buffer
+typedef struct {
+    http_parse_state_t state;
+    int status_code;
+    int keep_alive;
+    int chunked;
+    long content_length;        // -1 when not announced
+    content_encoding_t encoding;
+    int accepts_deflate;        // server advertised deflate for request bodies
+    int long_poll;              // longest hold the server offers, 0 when it does not
+    size_t remaining;           // bytes left in the current body or chunk
+    size_t line_len;
+    char line[HTTP_MAX_LINE];
+} http_parser_t;
+
+// Parser functions
+void http_parser_init(http_parser_t* parser);
+long http_parser_feed(http_parser_t* parser, http_response_t* response, const char* data, size_t length);
+void http_parser_body_received(http_parser_t* parser, http_response_t* response, size_t length);
+int http_parser_finish(http_parser_t* parser);
+
+#endif // HTTP_PARSER_H
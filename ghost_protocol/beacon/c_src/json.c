@@ -0,0 +1,660 @@
+/*
+ * Ghost Protocol Beacon - JSON Module Implementation
+ * Single-pass tokenizer returning views into the response buffer
+ */
+
+#include "json.h"
+#include "records.h"
+
+void json_parser_init(json_parser_t* parser, const char* json, size_t length) {
+    parser->pos = json;
+    parser->end = json + length;
+}
+
+static int match_literal(json_parser_t* parser, const char* literal, size_t length) {
+    if ((size_t)(parser->end - parser->pos) < length || memcmp(parser->pos, literal, length) != 0) {
+        return 0;
+    }
+    parser->pos += length;
+    return 1;
+}
+
+json_token_type_t json_next_token(json_parser_t* parser, json_token_t* token) {
+    // Separators carry no information for our fixed schemas
+    while (parser->pos < parser->end &&
+           (*parser->pos == ' ' || *parser->pos == '\t' || *parser->pos == '\r' ||
+            *parser->pos == '\n' || *parser->pos == ':' || *parser->pos == ',')) {
+        parser->pos++;
+    }
+    
+    token->start = parser->pos;
+    token->length = 1;
+    token->has_escapes = 0;
+    
+    if (parser->pos >= parser->end || *parser->pos == '\0') {
+        token->length = 0;
+        return token->type = JSON_END;
+    }
+    
+    switch (*parser->pos) {
+        case '{':
+            parser->pos++;
+            return token->type = JSON_OBJECT_START;
+        case '}':
+            parser->pos++;
+            return token->type = JSON_OBJECT_END;
+        case '[':
+            parser->pos++;
+            return token->type = JSON_ARRAY_START;
+        case ']':
+            parser->pos++;
+            return token->type = JSON_ARRAY_END;
+        case '"':
+            parser->pos++;
+            token->start = parser->pos;
+            while (parser->pos < parser->end && *parser->pos != '"') {
+                if (*parser->pos == '\\') {
+                    token->has_escapes = 1;
+                    parser->pos++;
+                }
+                parser->pos++;
+            }
+            if (parser->pos >= parser->end) {
+                return token->type = JSON_ERROR;
+            }
+            token->length = parser->pos - token->start;
+            parser->pos++;
+            return token->type = JSON_STRING;
+        case 't':
+            token->length = 4;
+            return token->type = match_literal(parser, "true", 4) ? JSON_TRUE : JSON_ERROR;
+        case 'f':
+            token->length = 5;
+            return token->type = match_literal(parser, "false", 5) ? JSON_FALSE : JSON_ERROR;
+        case 'n':
+            token->length = 4;
+            return token->type = match_literal(parser, "null", 4) ? JSON_NULL : JSON_ERROR;
+        default:
+            break;
+    }
+    
+    if (*parser->pos == '-' || (*parser->pos >= '0' && *parser->pos <= '9')) {
+        while (parser->pos < parser->end &&
+               ((*parser->pos >= '0' && *parser->pos <= '9') || *parser->pos == '-' ||
+                *parser->pos == '+' || *parser->pos == '.' || *parser->pos == 'e' || *parser->pos == 'E')) {
+            parser->pos++;
+        }
+        token->length = parser->pos - token->start;
+        return token->type = JSON_NUMBER;
+    }
+    
+    return token->type = JSON_ERROR;
+}
+
+// Skips the value that starts with `first`, including any nested containers
+int json_skip_value(json_parser_t* parser, const json_token_t* first) {
+    if (first->type != JSON_OBJECT_START && first->type != JSON_ARRAY_START) {
+        return (first->type == JSON_ERROR || first->type == JSON_END) ? -1 : 0;
+    }
+    
+    int depth = 1;
+    json_token_t token;
+    
+    while (depth > 0) {
+        switch (json_next_token(parser, &token)) {
+            case JSON_OBJECT_START:
+            case JSON_ARRAY_START:
+                depth++;
+                break;
+            case JSON_OBJECT_END:
+            case JSON_ARRAY_END:
+                depth--;
+                break;
+            case JSON_END:
+            case JSON_ERROR:
+                return -1;
+            default:
+                break;
+        }
+    }
+    
+    return 0;
+}
+
+int json_token_equals(const json_token_t* token, const char* literal) {
+    size_t length = strlen(literal);
+    return token->type == JSON_STRING && !token->has_escapes &&
+           token->length == length && memcmp(token->start, literal, length) == 0;
+}
+
+static size_t encode_utf8(unsigned long codepoint, char* output) {
+    if (codepoint < 0x80) {
+        output[0] = (char)codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        output[0] = (char)(0xC0 | (codepoint >> 6));
+        output[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    } else if (codepoint < 0x10000) {
+        output[0] = (char)(0xE0 | (codepoint >> 12));
+        output[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        output[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    output[0] = (char)(0xF0 | (codepoint >> 18));
+    output[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    output[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    output[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+static unsigned long parse_hex4(const char* p) {
+    unsigned long value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+    }
+    return value;
+}
+
+// Copies a token into `output`, unescaping strings; truncates to fit and always terminates
+size_t json_token_copy(const json_token_t* token, char* output, size_t output_size) {
+    if (output_size == 0) {
+        return 0;
+    }
+    
+    size_t limit = output_size - 1;
+    
+    if (token->type != JSON_STRING || !token->has_escapes) {
+        size_t length = token->length < limit ? token->length : limit;
+        memcpy(output, token->start, length);
+        output[length] = '\0';
+        return length;
+    }
+    
+    const char* p = token->start;
+    const char* end = token->start + token->length;
+    size_t written = 0;
+    
+    while (p < end && written < limit) {
+        if (*p != '\\' || p + 1 >= end) {
+            output[written++] = *p++;
+            continue;
+        }
+        
+        p++;
+        char decoded[4];
+        size_t decoded_len = 1;
+        
+        switch (*p) {
+            case 'b': decoded[0] = '\b'; break;
+            case 'f': decoded[0] = '\f'; break;
+            case 'n': decoded[0] = '\n'; break;
+            case 'r': decoded[0] = '\r'; break;
+            case 't': decoded[0] = '\t'; break;
+            case 'u':
+                if (end - p >= 5) {
+                    unsigned long codepoint = parse_hex4(p + 1);
+                    p += 4;
+                    // Combine UTF-16 surrogate pairs
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF &&
+                        end - p >= 7 && p[1] == '\\' && p[2] == 'u') {
+                        unsigned long low = parse_hex4(p + 3);
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                            p += 6;
+                        }
+                    }
+                    decoded_len = encode_utf8(codepoint, decoded);
+                } else {
+                    decoded[0] = 'u';
+                }
+                break;
+            default:
+                decoded[0] = *p;
+                break;
+        }
+        p++;
+        
+        if (written + decoded_len > limit) {
+            break;
+        }
+        memcpy(output + written, decoded, decoded_len);
+        written += decoded_len;
+    }
+    
+    output[written] = '\0';
+    return written;
+}
+
+// Reads the next value; containers are returned as one token spanning their raw text
+static json_token_type_t next_value(json_parser_t* parser, json_token_t* value) {
+    json_next_token(parser, value);
+    
+    if (value->type == JSON_OBJECT_START || value->type == JSON_ARRAY_START) {
+        json_token_type_t type = value->type;
+        if (json_skip_value(parser, value) != 0) {
+            return value->type = JSON_ERROR;
+        }
+        value->length = parser->pos - value->start;
+        value->type = type;
+    }
+    
+    return value->type;
+}
+
+int json_get_string(const char* json, size_t length, const char* key, char* output, size_t output_size) {
+    json_parser_t parser;
+    json_token_t token;
+    json_token_t value;
+    
+    json_parser_init(&parser, json, length);
+    if (json_next_token(&parser, &token) != JSON_OBJECT_START) {
+        return -1;
+    }
+    
+    while (json_next_token(&parser, &token) == JSON_STRING) {
+        if (next_value(&parser, &value) == JSON_ERROR || value.type == JSON_END) {
+            return -1;
+        }
+        if (json_token_equals(&token, key)) {
+            json_token_copy(&value, output, output_size);
+            return 0;
+        }
+    }
+    
+    return -1;
+}
+
+// Copies one field into the record and returns the bytes written, NUL excluded
+static unsigned int copy_field(const json_token_t* token, char* output, size_t limit) {
+    if (token->type == JSON_END) {
+        output[0] = '\0';
+        return 0;
+    }
+    return (unsigned int)json_token_copy(token, output, limit + 1);
+}
+
+static command_record_t* parse_command(json_parser_t* parser, arena_t* arena) {
+    json_token_t key;
+    json_token_t value;
+    json_token_t id = {JSON_END, NULL, 0, 0};
+    json_token_t name = {JSON_END, NULL, 0, 0};
+    json_token_t args = {JSON_END, NULL, 0, 0};
+    
+    while (json_next_token(parser, &key) == JSON_STRING) {
+        if (next_value(parser, &value) == JSON_ERROR || value.type == JSON_END) {
+            return NULL;
+        }
+        
+        if (json_token_equals(&key, "id")) {
+            id = value;
+        } else if (json_token_equals(&key, "command")) {
+            name = value;
+        } else if (json_token_equals(&key, "args") && value.type != JSON_NULL) {
+            // Object arguments are kept as raw JSON for the handler to pick apart
+            args = value;
+        }
+    }
+    if (key.type != JSON_OBJECT_END) {
+        return NULL;
+    }
+    
+    // Unescaping never lengthens a string, so the raw lengths bound the payload
+    size_t id_limit = id.length < COMMAND_ID_MAX - 1 ? id.length : COMMAND_ID_MAX - 1;
+    command_record_t* command = command_record_alloc(arena, id_limit + name.length + args.length + 3);
+    if (!command) {
+        return NULL;
+    }
+    
+    command->id_length = copy_field(&id, COMMAND_ID(command), id_limit);
+    command->name_length = copy_field(&name, COMMAND_NAME(command), name.length);
+    command->args_length = copy_field(&args, COMMAND_ARGS(command), args.length);
+    return command;
+}
+
+// ack receives the top-level "ack" number and is left alone when the reply has none
+int json_parse_commands(const char* json, size_t length, arena_t* arena,
+                        command_record_t** commands, int max_commands, long* ack) {
+    json_parser_t parser;
+    json_token_t token;
+    json_token_t value;
+    int count = 0;
+    
+    json_parser_init(&parser, json, length);
+    if (json_next_token(&parser, &token) != JSON_OBJECT_START) {
+        return 0;
+    }
+    
+    while (json_next_token(&parser, &token) == JSON_STRING) {
+        if (!json_token_equals(&token, "commands")) {
+            if (next_value(&parser, &value) == JSON_ERROR || value.type == JSON_END) {
+                break;
+            }
+            // The token ends at a delimiter, so strtol stops inside the buffer
+            if (ack && value.type == JSON_NUMBER && json_token_equals(&token, "ack")) {
+                *ack = strtol(value.start, NULL, 10);
+            }
+            continue;
+        }
+        
+        if (json_next_token(&parser, &value) != JSON_ARRAY_START) {
+            if (json_skip_value(&parser, &value) != 0) {
+                break;
+            }
+            continue;
+        }
+        
+        while (json_next_token(&parser, &value) == JSON_OBJECT_START) {
+            if (count < max_commands) {
+                if ((commands[count] = parse_command(&parser, arena)) == NULL) {
+                    return count;
+                }
+                count++;
+            } else if (json_skip_value(&parser, &value) != 0) {
+                return count;
+            }
+        }
+    }
+    
+    return count;
+}
+
+int json_writer_init(json_writer_t* writer, size_t initial_capacity) {
+    memset(writer, 0, sizeof(json_writer_t));
+    writer->capacity = initial_capacity > 0 ? initial_capacity : 256;
+    writer->data = malloc(writer->capacity);
+    if (!writer->data) {
+        writer->error = 1;
+        writer->capacity = 0;
+        return -1;
+    }
+    writer->data[0] = '\0';
+    return 0;
+}
+
+int json_writer_init_arena(json_writer_t* writer, arena_t* arena, size_t initial_capacity) {
+    memset(writer, 0, sizeof(json_writer_t));
+    writer->arena = arena;
+    writer->capacity = initial_capacity > 0 ? initial_capacity : 256;
+    writer->data = arena_alloc(arena, writer->capacity);
+    if (!writer->data) {
+        writer->error = 1;
+        writer->capacity = 0;
+        return -1;
+    }
+    writer->data[0] = '\0';
+    return 0;
+}
+
+void json_writer_free(json_writer_t* writer) {
+    // Arena-backed output is released with the arena
+    if (!writer->arena) {
+        free(writer->data);
+    }
+    memset(writer, 0, sizeof(json_writer_t));
+}
+
+// Grows geometrically so a payload of n bytes costs O(n) copying overall
+static int writer_reserve(json_writer_t* writer, size_t extra) {
+    if (writer->error) {
+        return -1;
+    }
+    if (writer->length + extra + 1 <= writer->capacity) {
+        return 0;
+    }
+    
+    size_t capacity = writer->capacity ? writer->capacity : 256;
+    while (writer->length + extra + 1 > capacity) {
+        capacity *= 2;
+    }
+    
+    char* grown = writer->arena
+        ? arena_realloc(writer->arena, writer->data, writer->capacity, capacity)
+        : realloc(writer->data, capacity);
+    if (!grown) {
+        writer->error = 1;
+        return -1;
+    }
+    writer->data = grown;
+    writer->capacity = capacity;
+    return 0;
+}
+
+static void writer_append(json_writer_t* writer, const char* data, size_t length) {
+    if (writer_reserve(writer, length) != 0) {
+        return;
+    }
+    memcpy(writer->data + writer->length, data, length);
+    writer->length += length;
+    writer->data[writer->length] = '\0';
+}
+
+// Emits the separator owed by the previous sibling, if any
+static void writer_before_value(json_writer_t* writer) {
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if (writer->depth > 0) {
+        unsigned int bit = 1u << ((writer->depth - 1) & 31);
+        if (writer->has_items & bit) {
+            writer_append(writer, ",", 1);
+        }
+        writer->has_items |= bit;
+    }
+}
+
+static void writer_open(json_writer_t* writer, char bracket) {
+    writer_before_value(writer);
+    writer_append(writer, &bracket, 1);
+    writer->depth++;
+    writer->has_items &= ~(1u << ((writer->depth - 1) & 31));
+}
+
+static void writer_close(json_writer_t* writer, char bracket) {
+    if (writer->depth > 0) {
+        writer->depth--;
+    }
+    writer_append(writer, &bracket, 1);
+}
+
+void json_writer_begin_object(json_writer_t* writer) {
+    writer_open(writer, '{');
+}
+
+void json_writer_end_object(json_writer_t* writer) {
+    writer_close(writer, '}');
+}
+
+void json_writer_begin_array(json_writer_t* writer) {
+    writer_open(writer, '[');
+}
+
+void json_writer_end_array(json_writer_t* writer) {
+    writer_close(writer, ']');
+}
+
+// Length of a valid UTF-8 sequence at `p`, or 0 if the bytes are malformed
+static size_t utf8_sequence_length(const unsigned char* p, const unsigned char* end) {
+    size_t length;
+    if (*p < 0x80) return 1;
+    else if ((*p & 0xE0) == 0xC0 && *p >= 0xC2) length = 2;
+    else if ((*p & 0xF0) == 0xE0) length = 3;
+    else if ((*p & 0xF8) == 0xF0 && *p <= 0xF4) length = 4;
+    else return 0;
+    
+    if ((size_t)(end - p) < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+void json_writer_string_len(json_writer_t* writer, const char* value, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* p = (const unsigned char*)value;
+    const unsigned char* end = p + length;
+    
+    writer_before_value(writer);
+    // Reserve for the common unescaped case up front
+    if (writer_reserve(writer, length + 2) != 0) {
+        return;
+    }
+    writer_append(writer, "\"", 1);
+    
+    while (p < end) {
+        // Copy runs of bytes that need no escaping in one go
+        const unsigned char* run = p;
+        while (p < end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\') {
+            p++;
+        }
+        if (p > run) {
+            writer_append(writer, (const char*)run, p - run);
+        }
+        if (p >= end) {
+            break;
+        }
+        
+        char escape[6];
+        switch (*p) {
+            case '"':  writer_append(writer, "\\\"", 2); p++; continue;
+            case '\\': writer_append(writer, "\\\\", 2); p++; continue;
+            case '\n': writer_append(writer, "\\n", 2); p++; continue;
+            case '\r': writer_append(writer, "\\r", 2); p++; continue;
+            case '\t': writer_append(writer, "\\t", 2); p++; continue;
+            case '\b': writer_append(writer, "\\b", 2); p++; continue;
+            case '\f': writer_append(writer, "\\f", 2); p++; continue;
+            default:
+                break;
+        }
+        
+        if (*p < 0x20) {
+            memcpy(escape, "\\u00", 4);
+            escape[4] = hex[*p >> 4];
+            escape[5] = hex[*p & 0x0F];
+            writer_append(writer, escape, 6);
+            p++;
+            continue;
+        }
+        
+        // Non-ASCII: pass valid UTF-8 through, replace stray bytes with U+FFFD
+        size_t sequence = utf8_sequence_length(p, end);
+        if (sequence > 0) {
+            writer_append(writer, (const char*)p, sequence);
+            p += sequence;
+        } else {
+            writer_append(writer, "\\ufffd", 6);
+            p++;
+        }
+    }
+    
+    writer_append(writer, "\"", 1);
+}
+
+void json_writer_string(json_writer_t* writer, const char* value) {
+    json_writer_string_len(writer, value ? value : "", value ? strlen(value) : 0);
+}
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Binary data as a padded base64 string; the alphabet never needs escaping
+void json_writer_base64(json_writer_t* writer, const char* value, size_t length) {
+    const unsigned char* p = (const unsigned char*)value;
+    
+    writer_before_value(writer);
+    if (writer_reserve(writer, (length + 2) / 3 * 4 + 2) != 0) {
+        return;
+    }
+    
+    char* out = writer->data + writer->length;
+    *out++ = '"';
+    size_t i = 0;
+    for (; i + 2 < length; i += 3) {
+        *out++ = base64_alphabet[p[i] >> 2];
+        *out++ = base64_alphabet[((p[i] & 0x03) << 4) | (p[i + 1] >> 4)];
+        *out++ = base64_alphabet[((p[i + 1] & 0x0F) << 2) | (p[i + 2] >> 6)];
+        *out++ = base64_alphabet[p[i + 2] & 0x3F];
+    }
+    if (i < length) {
+        *out++ = base64_alphabet[p[i] >> 2];
+        if (i + 1 < length) {
+            *out++ = base64_alphabet[((p[i] & 0x03) << 4) | (p[i + 1] >> 4)];
+            *out++ = base64_alphabet[(p[i + 1] & 0x0F) << 2];
+        } else {
+            *out++ = base64_alphabet[(p[i] & 0x03) << 4];
+            *out++ = '=';
+        }
+        *out++ = '=';
+    }
+    *out++ = '"';
+    *out = '\0';
+    writer->length = out - writer->data;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// Decodes into output, which may be input itself; returns the length, or -1 on a bad character
+long json_base64_decode(const char* input, size_t length, char* output) {
+    unsigned int bits = 0;
+    int pending = 0;
+    long written = 0;
+    
+    for (size_t i = 0; i < length && input[i] != '='; i++) {
+        int value = base64_value(input[i]);
+        if (value < 0) {
+            return -1;
+        }
+        bits = (bits << 6) | (unsigned int)value;
+        pending += 6;
+        if (pending >= 8) {
+            pending -= 8;
+            output[written++] = (char)((bits >> pending) & 0xFF);
+        }
+    }
+    return written;
+}
+
+void json_writer_key(json_writer_t* writer, const char* key) {
+    json_writer_string(writer, key);
+    writer_append(writer, ":", 1);
+    writer->after_key = 1;
+}
+
+void json_writer_int(json_writer_t* writer, long value) {
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%ld", value);
+    writer_before_value(writer);
+    writer_append(writer, buffer, length);
+}
+
+// For values that outgrow a 32-bit long, such as file offsets on Windows
+void json_writer_int64(json_writer_t* writer, long long value) {
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", value);
+    writer_before_value(writer);
+    writer_append(writer, buffer, length);
+}
+
+void json_writer_bool(json_writer_t* writer, int value) {
+    writer_before_value(writer);
+    if (value) {
+        writer_append(writer, "true", 4);
+    } else {
+        writer_append(writer, "false", 5);
+    }
+}
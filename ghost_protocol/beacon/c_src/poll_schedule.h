@@ -0,0 +1,38 @@
+/*
+ * Ghost Protocol Beacon - Poll Schedule Module
+ * Header file for the adaptive check-in interval
+ */
+
+#ifndef POLL_SCHEDULE_H
+#define POLL_SCHEDULE_H
+
+#include "beacon.h"
+
+// Poll schedule configuration
+#define POLL_DEFAULT_ACTIVE_MS 500    // interval while work is in flight
+#define POLL_MIN_INTERVAL_MS 50
+#define POLL_DECAY_FACTOR 2           // growth per idle check-in back toward the base
+
+// Check-in pacing: drops to the active interval on activity, decays back when idle
+typedef struct {
+    int base_ms;            // configured --sleep
+    int active_ms;
+    int current_ms;         // interval before jitter
+    int jitter_percent;
+    int adaptive;           // 0 keeps the base interval throughout
+} poll_schedule_t;
+
+// Poll schedule functions
+void poll_schedule_init(poll_schedule_t* schedule, int base_seconds, int jitter_percent,
+                        int active_ms, int adaptive);
+void poll_schedule_activity(poll_schedule_t* schedule);
+void poll_schedule_idle(poll_schedule_t* schedule);
+int poll_schedule_next_ms(const poll_schedule_t* schedule);
+
+// Sub-second sleep; returns early if a signal arrives, like sleep()
+void sleep_milliseconds(int milliseconds);
+
+// Milliseconds on a clock that never steps; 64 bits wide, so deadlines cannot wrap
+long long monotonic_ms(void);
+
+#endif // POLL_SCHEDULE_H
@@ -0,0 +1,111 @@
+/*
+ * Ghost Protocol Beacon - Records Implementation
+ * Header-plus-payload records sized to their actual contents
+ */
+
+#include "records.h"
+#include <stdarg.h>
+
+void* record_alloc(arena_t* arena, size_t size) {
+    return arena ? arena_alloc(arena, size) : malloc(size);
+}
+
+// Arena records are released with the arena
+void record_free(arena_t* arena, void* record) {
+    if (!arena) {
+        free(record);
+    }
+}
+
+// The caller fills id, name and args back to back, each followed by a NUL
+command_record_t* command_record_alloc(arena_t* arena, size_t payload_capacity) {
+    command_record_t* command = record_alloc(arena, sizeof(command_record_t) + payload_capacity);
+    if (command) {
+        memset(command, 0, sizeof(command_record_t));
+    }
+    return command;
+}
+
+size_t command_record_size(const command_record_t* command) {
+    return sizeof(command_record_t) + command->id_length + command->name_length + command->args_length + 3;
+}
+
+command_record_t* command_record_clone(arena_t* arena, const command_record_t* command) {
+    size_t size = command_record_size(command);
+    command_record_t* copy = record_alloc(arena, size);
+    if (copy) {
+        memcpy(copy, command, size);
+    }
+    return copy;
+}
+
+result_record_t* result_record_create(arena_t* arena, const char* command_id, size_t output_capacity) {
+    size_t id_length = strlen(command_id);
+    if (id_length > COMMAND_ID_MAX - 1) {
+        id_length = COMMAND_ID_MAX - 1;
+    }
+    
+    size_t capacity = id_length + 1 + output_capacity + 1;
+    result_record_t* result = record_alloc(arena, sizeof(result_record_t) + capacity);
+    if (!result) {
+        return NULL;
+    }
+    
+    memset(result, 0, sizeof(result_record_t));
+    result->id_length = (unsigned int)id_length;
+    result->capacity = (unsigned int)capacity;
+    memcpy(result->data, command_id, id_length);
+    result->data[id_length] = '\0';
+    RESULT_OUTPUT(result)[0] = '\0';
+    get_current_timestamp(result->timestamp, sizeof(result->timestamp));
+    return result;
+}
+
+size_t result_record_size(const result_record_t* result) {
+    return sizeof(result_record_t) + result->id_length + result->output_length + 2;
+}
+
+// Grows geometrically; an arena record that was allocated last is extended in place
+int result_record_append(arena_t* arena, result_record_t** result, const char* data, size_t length) {
+    result_record_t* record = *result;
+    size_t needed = record->id_length + 1 + record->output_length + length + 1;
+    
+    if (needed > record->capacity) {
+        size_t capacity = record->capacity ? record->capacity : 64;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        
+        size_t old_size = sizeof(result_record_t) + record->capacity;
+        size_t new_size = sizeof(result_record_t) + capacity;
+        record = arena ? arena_realloc(arena, record, old_size, new_size) : realloc(record, new_size);
+        if (!record) {
+            return -1;
+        }
+        record->capacity = (unsigned int)capacity;
+        *result = record;
+    }
+    
+    char* output = RESULT_OUTPUT(record);
+    memcpy(output + record->output_length, data, length);
+    record->output_length += (unsigned int)length;
+    output[record->output_length] = '\0';
+    return 0;
+}
+
+int result_record_printf(arena_t* arena, result_record_t** result, const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    
+    if (length < 0) {
+        return -1;
+    }
+    if ((size_t)length >= sizeof(buffer)) {
+        length = sizeof(buffer) - 1;
+    }
+    return result_record_append(arena, result, buffer, (size_t)length);
+}
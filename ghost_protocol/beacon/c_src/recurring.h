@@ -0,0 +1,21 @@
+/*
+ * Ghost Protocol Beacon - Recurring Commands
+ * Header file for commands the server schedules once and the beacon repeats locally
+ */
+
+#ifndef RECURRING_H
+#define RECURRING_H
+
+#include "beacon.h"
+#include "timer_wheel.h"
+
+#define RECURRING_MAX_TASKS 32
+#define RECURRING_TICK_MS 100    // timer wheel resolution
+
+// Recurring command functions; all belong to the check-in thread
+void recurring_init(void);
+int recurring_due(arena_t* arena, command_record_t** runs, int max_runs);
+int recurring_next_ms(void);
+void recurring_shutdown(void);
+
+#endif // RECURRING_H
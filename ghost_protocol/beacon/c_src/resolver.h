@@ -0,0 +1,58 @@
+/*
+ * Ghost Protocol Beacon - Name Resolution Module
+ * Header file for the cached getaddrinfo resolver and connect race
+ */
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "beacon.h"
+#include "event_loop.h"
+
+#ifndef _WIN32
+
+// Resolver configuration
+#define RESOLVER_CACHE_SIZE 4
+#define RESOLVER_MAX_ADDRS 8
+#define RESOLVER_DEFAULT_TTL 300          // seconds a lookup stays cached
+#define RESOLVER_ATTEMPT_DELAY_MS 250     // head start per address (RFC 8305)
+
+// resolver_race_step result while attempts are still in flight
+#define RESOLVER_RACE_PENDING -2
+
+// Cached lookup for one host/port pair
+typedef struct {
+    char hostname[256];
+    int port;
+    struct sockaddr_storage addrs[RESOLVER_MAX_ADDRS];
+    socklen_t addr_lens[RESOLVER_MAX_ADDRS];
+    int addr_count;
+    long expires;
+} resolver_entry_t;
+
+// Non-blocking connect race across the addresses of one entry
+typedef struct {
+    resolver_entry_t entry;           // copied, so a cache eviction cannot pull it away mid-race
+    event_loop_t* loop;               // pending sockets are watched here for writability
+    void* data;
+    int fds[RESOLVER_MAX_ADDRS];
+    int addrs[RESOLVER_MAX_ADDRS];    // entry index behind each pending socket
+    int pending;
+    int next;                         // next address to try
+    long next_attempt_ms;
+} resolver_race_t;
+
+// Resolver functions
+void resolver_set_ttl(int seconds);
+resolver_entry_t* resolver_lookup(const char* hostname, int port);
+void resolver_invalidate(const char* hostname, int port);
+
+// Connect race functions; the winner is returned non-blocking and still watched
+void resolver_race_start(resolver_race_t* race, event_loop_t* loop, const resolver_entry_t* entry, void* data);
+int resolver_race_step(resolver_race_t* race);
+long resolver_race_wakeup(const resolver_race_t* race);
+void resolver_race_abort(resolver_race_t* race);
+
+#endif
+
+#endif // RESOLVER_H
@@ -0,0 +1,201 @@
+/*
+ * Ghost Protocol Beacon - Result Queue Implementation
+ * Variable-size entries in a ring that grows up to a fixed budget and is freed when drained
+ */
+
+#include "result_queue.h"
+#include "records.h"
+
+#define ENTRY_ALIGNMENT 8
+#define ALIGN_UP(n) (((n) + (ENTRY_ALIGNMENT - 1)) & ~(size_t)(ENTRY_ALIGNMENT - 1))
+#define ALIGN_DOWN(n) ((n) & ~(size_t)(ENTRY_ALIGNMENT - 1))
+#define ENTRY_HEADER ALIGN_UP(sizeof(size_t))
+#define ENTRY_SIZE(record_size) ALIGN_UP(ENTRY_HEADER + (record_size))
+#define ENTRY_AT(offset) ((size_t*)(g_queue.buffer + (offset)))
+#define ENTRY_RECORD(entry) ((result_record_t*)((char*)(entry) + ENTRY_HEADER))
+
+static result_queue_t g_queue;
+
+void result_queue_init(size_t budget) {
+    memset(&g_queue, 0, sizeof(g_queue));
+    if (budget < RESULT_QUEUE_MIN_BUDGET) {
+        budget = RESULT_QUEUE_MIN_BUDGET;
+    }
+    g_queue.budget = ALIGN_DOWN(budget);
+}
+
+// Follows wrap markers so the offset always points at a real entry; returns its size word
+static size_t* entry_at(size_t* offset) {
+    if (g_queue.capacity - *offset < sizeof(size_t) || *ENTRY_AT(*offset) == 0) {
+        *offset = 0;
+    }
+    return ENTRY_AT(*offset);
+}
+
+// Write offset for an entry of `need` bytes in the current buffer, or -1 if it does not fit
+static long find_slot(size_t need) {
+    if (!g_queue.buffer) {
+        return -1;
+    }
+    if (g_queue.count == 0) {
+        return need <= g_queue.capacity ? 0 : -1;
+    }
+    
+    if (g_queue.tail > g_queue.head) {
+        // Free space runs from the tail to the end, then from the start to the head
+        if (g_queue.capacity - g_queue.tail >= need) {
+            return (long)g_queue.tail;
+        }
+        if (g_queue.head >= need) {
+            return 0;
+        }
+        return -1;
+    }
+    
+    // Wrapped: the only gap is between the tail and the head
+    return g_queue.head - g_queue.tail >= need ? (long)g_queue.tail : -1;
+}
+
+// Moves the live entries, oldest first, into a larger buffer
+static int grow(size_t need) {
+    size_t required = g_queue.used + need;
+    size_t capacity = g_queue.capacity ? g_queue.capacity * 2 : RESULT_QUEUE_INITIAL_SIZE;
+    
+    while (capacity < required) {
+        capacity *= 2;
+    }
+    if (capacity > g_queue.budget) {
+        capacity = g_queue.budget;
+    }
+    if (capacity < required) {
+        return -1;
+    }
+    
+    char* buffer = malloc(capacity);
+    if (!buffer) {
+        return -1;
+    }
+    
+    size_t offset = g_queue.head;
+    size_t written = 0;
+    for (int i = 0; i < g_queue.count; i++) {
+        size_t* entry = entry_at(&offset);
+        memcpy(buffer + written, entry, *entry);
+        written += *entry;
+        offset += *entry;
+    }
+    
+    free(g_queue.buffer);
+    g_queue.buffer = buffer;
+    g_queue.capacity = capacity;
+    g_queue.head = 0;
+    g_queue.tail = written;
+    return 0;
+}
+
+// True when a record of this size can be pushed without exceeding the budget
+int result_queue_fits(size_t record_size) {
+    size_t need = ENTRY_SIZE(record_size);
+    return find_slot(need) >= 0 || g_queue.used + need <= g_queue.budget;
+}
+
+// Stores a compact copy; the record itself stays with the caller
+int result_queue_push(const result_record_t* result) {
+    size_t record_size = result_record_size(result);
+    size_t need = ENTRY_SIZE(record_size);
+    
+    long slot = find_slot(need);
+    if (slot < 0) {
+        if (grow(need) != 0) {
+            return -1;
+        }
+        slot = find_slot(need);
+        if (slot < 0) {
+            return -1;
+        }
+    }
+    
+    // Skipping the end of the buffer leaves a marker for the reader
+    if (g_queue.count > 0 && (size_t)slot != g_queue.tail &&
+        g_queue.capacity - g_queue.tail >= sizeof(size_t)) {
+        *ENTRY_AT(g_queue.tail) = 0;
+    }
+    
+    size_t* entry = ENTRY_AT(slot);
+    result_record_t* record = ENTRY_RECORD(entry);
+    *entry = need;
+    memcpy(record, result, record_size);
+    record->capacity = (unsigned int)(record_size - sizeof(result_record_t));
+    record->upload_seq = g_queue.next_seq++;
+    
+    if (g_queue.count == 0) {
+        g_queue.head = (size_t)slot;
+    }
+    g_queue.tail = (size_t)slot + need;
+    g_queue.used += need;
+    g_queue.count++;
+    return 0;
+}
+
+// Points at the oldest results without removing them; stops at RESULT_QUEUE_BATCH_BYTES.
+// The pointers stay valid until the next push or pop.
+int result_queue_peek(const result_record_t** results, int max_results) {
+    size_t offset = g_queue.head;
+    size_t batch_bytes = 0;
+    int count = 0;
+    
+    while (count < g_queue.count && count < max_results) {
+        size_t* entry = entry_at(&offset);
+        const result_record_t* record = ENTRY_RECORD(entry);
+        if (count > 0 && batch_bytes + record->output_length > RESULT_QUEUE_BATCH_BYTES) {
+            break;
+        }
+        
+        results[count++] = record;
+        batch_bytes += record->output_length;
+        offset += *entry;
+    }
+    
+    return count;
+}
+
+// Drops the oldest entries once the server has acknowledged them; the sequence
+// numbers keep counting across the drained-queue reset below
+void result_queue_pop(int count) {
+    while (count-- > 0 && g_queue.count > 0) {
+        size_t size = *entry_at(&g_queue.head);
+        g_queue.used -= size;
+        g_queue.head += size;
+        g_queue.count--;
+        if (g_queue.count > 0) {
+            entry_at(&g_queue.head);
+        }
+    }
+    
+    // An idle beacon keeps no queue memory at all
+    if (g_queue.count == 0) {
+        free(g_queue.buffer);
+        g_queue.buffer = NULL;
+        g_queue.capacity = 0;
+        g_queue.head = 0;
+        g_queue.tail = 0;
+        g_queue.used = 0;
+    }
+}
+
+int result_queue_count(void) {
+    return g_queue.count;
+}
+
+size_t result_queue_bytes(void) {
+    return g_queue.used;
+}
+
+size_t result_queue_budget(void) {
+    return g_queue.budget;
+}
+
+void result_queue_destroy(void) {
+    free(g_queue.buffer);
+    memset(&g_queue, 0, sizeof(g_queue));
+}
@@ -0,0 +1,40 @@
+/*
+ * Ghost Protocol Beacon - Result Queue
+ * Header file for the budgeted ring buffer holding results until the server has them
+ */
+
+#ifndef RESULT_QUEUE_H
+#define RESULT_QUEUE_H
+
+#include "beacon.h"
+
+#define RESULT_QUEUE_DEFAULT_BUDGET (4 * 1024 * 1024)   // most bytes the ring may occupy
+#define RESULT_QUEUE_MIN_BUDGET (64 * 1024)
+#define RESULT_QUEUE_INITIAL_SIZE 16384
+#define RESULT_QUEUE_BATCH_BYTES (512 * 1024)           // output bytes per check-in
+
+// Each entry is a size word followed by a result record; entries are laid out
+// back to back and never straddle the end of the buffer
+typedef struct {
+    char* buffer;
+    size_t capacity;
+    size_t head;              // oldest entry
+    size_t tail;              // next write position
+    size_t used;              // bytes held by live entries
+    int count;
+    size_t budget;
+    long next_seq;            // upload_seq given to the next pushed result
+} result_queue_t;
+
+// Result queue functions
+void result_queue_init(size_t budget);
+int result_queue_fits(size_t record_size);
+int result_queue_push(const result_record_t* result);
+int result_queue_peek(const result_record_t** results, int max_results);
+void result_queue_pop(int count);
+int result_queue_count(void);
+size_t result_queue_bytes(void);
+size_t result_queue_budget(void);
+void result_queue_destroy(void);
+
+#endif // RESULT_QUEUE_H
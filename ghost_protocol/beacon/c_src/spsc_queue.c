@@ -0,0 +1,45 @@
+/*
+ * Ghost Protocol Beacon - SPSC Queue Implementation
+ * Bounded ring with free-running indices; the release store of an index publishes its slot
+ */
+
+#include "spsc_queue.h"
+#include "thread_sync.h"
+
+#define SPSC_QUEUE_MASK (SPSC_QUEUE_CAPACITY - 1)
+
+void spsc_queue_init(spsc_queue_t* queue) {
+    memset(queue, 0, sizeof(spsc_queue_t));
+}
+
+// Producer side; returns -1 when the ring is full
+int spsc_queue_push(spsc_queue_t* queue, void* item) {
+    unsigned long tail = queue->tail;
+    
+    if (tail - queue->cached_head == SPSC_QUEUE_CAPACITY) {
+        queue->cached_head = sync_load(&queue->head);
+        if (tail - queue->cached_head == SPSC_QUEUE_CAPACITY) {
+            return -1;
+        }
+    }
+    
+    queue->slots[tail & SPSC_QUEUE_MASK] = item;
+    sync_store(&queue->tail, tail + 1);
+    return 0;
+}
+
+// Consumer side; returns NULL when the ring is empty
+void* spsc_queue_pop(spsc_queue_t* queue) {
+    unsigned long head = queue->head;
+    
+    if (head == queue->cached_tail) {
+        queue->cached_tail = sync_load(&queue->tail);
+        if (head == queue->cached_tail) {
+            return NULL;
+        }
+    }
+    
+    void* item = queue->slots[head & SPSC_QUEUE_MASK];
+    sync_store(&queue->head, head + 1);
+    return item;
+}
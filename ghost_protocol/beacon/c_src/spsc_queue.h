@@ -0,0 +1,32 @@
+/*
+ * Ghost Protocol Beacon - SPSC Queue
+ * Header file for the lock-free single-producer, single-consumer rings between threads
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include "beacon.h"
+
+#define SPSC_QUEUE_CAPACITY 64        // slots per ring, a power of two
+#define SPSC_CACHE_LINE 64
+
+// Each side's index sits on its own cache line, next to its cached copy of the other
+// side's index, so a push or pop touches shared lines only when the ring looks full or empty
+typedef struct {
+    char pad_start[SPSC_CACHE_LINE];
+    volatile unsigned long tail;      // written by the producer
+    unsigned long cached_head;        // producer's last look at head
+    char pad_producer[SPSC_CACHE_LINE];
+    volatile unsigned long head;      // written by the consumer
+    unsigned long cached_tail;        // consumer's last look at tail
+    char pad_consumer[SPSC_CACHE_LINE];
+    void* slots[SPSC_QUEUE_CAPACITY];
+} spsc_queue_t;
+
+// Queue functions; push and pop are wait-free, each callable from one thread only
+void spsc_queue_init(spsc_queue_t* queue);
+int spsc_queue_push(spsc_queue_t* queue, void* item);
+void* spsc_queue_pop(spsc_queue_t* queue);
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,148 @@
+/*
+ * Ghost Protocol Beacon - Telemetry Implementation
+ * Rolling per-phase histograms, shipped to the listener with the next check-in
+ */
+
+#include "telemetry.h"
+#include "thread_sync.h"
+
+#include <limits.h>
+
+static const char* g_phase_names[TELEMETRY_PHASES] = {
+    "dns", "connect", "tls", "send", "ttfb", "hold", "receive", "encode", "parse", "execute", "checkin"
+};
+
+// Workers record execute samples while the check-in loop records the rest
+static telemetry_t g_window;
+static sync_mutex_t g_lock;
+static int g_enabled = 0;
+static telemetry_phase_t g_failed_phase = TELEMETRY_PHASES;
+
+void telemetry_init(void) {
+    if (!g_enabled) {
+        sync_mutex_init(&g_lock);
+        memset(&g_window, 0, sizeof(g_window));
+        g_enabled = 1;
+    }
+}
+
+// 64-bit on every platform, where long is 32 bits on Windows; the counter is split before
+// scaling so the multiply cannot overflow however long the host has been up
+long long telemetry_now_us(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart / frequency.QuadPart * 1000000 +
+           counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+const char* telemetry_phase_name(telemetry_phase_t phase) {
+    return phase < TELEMETRY_PHASES ? g_phase_names[phase] : "unknown";
+}
+
+// Bit length of the sample, so each bucket spans one power of two
+int telemetry_bucket(unsigned long elapsed_us) {
+    int bucket = 0;
+    while (elapsed_us > 0 && bucket < TELEMETRY_BUCKETS - 1) {
+        elapsed_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void telemetry_record(telemetry_phase_t phase, long long started_us) {
+    if (!g_enabled || phase >= TELEMETRY_PHASES) {
+        return;
+    }
+    
+    long long elapsed = telemetry_now_us() - started_us;
+    unsigned long elapsed_us = elapsed <= 0 ? 0 : (unsigned long long)elapsed < ULONG_MAX ? (unsigned long)elapsed : ULONG_MAX;
+    int bucket = telemetry_bucket(elapsed_us);
+    
+    sync_lock(&g_lock);
+    telemetry_histogram_t* histogram = &g_window.phases[phase];
+    histogram->count++;
+    histogram->sum_us += elapsed_us;
+    if (elapsed_us > histogram->max_us) {
+        histogram->max_us = elapsed_us;
+    }
+    histogram->buckets[bucket]++;
+    sync_unlock(&g_lock);
+}
+
+// Counts a phase that gave up; the first one since the last query names the failure
+void telemetry_failure(telemetry_phase_t phase) {
+    if (!g_enabled || phase >= TELEMETRY_PHASES) {
+        return;
+    }
+    
+    sync_lock(&g_lock);
+    g_window.phases[phase].failures++;
+    if (g_failed_phase == TELEMETRY_PHASES) {
+        g_failed_phase = phase;
+    }
+    sync_unlock(&g_lock);
+}
+
+telemetry_phase_t telemetry_failed_phase(void) {
+    if (!g_enabled) {
+        return TELEMETRY_PHASES;
+    }
+    
+    sync_lock(&g_lock);
+    telemetry_phase_t phase = g_failed_phase;
+    g_failed_phase = TELEMETRY_PHASES;
+    sync_unlock(&g_lock);
+    return phase;
+}
+
+// Moves the current window into the caller's copy; returns 1 if it holds anything worth sending
+int telemetry_take(telemetry_t* window) {
+    if (!g_enabled) {
+        return 0;
+    }
+    
+    sync_lock(&g_lock);
+    memcpy(window, &g_window, sizeof(telemetry_t));
+    memset(&g_window, 0, sizeof(telemetry_t));
+    sync_unlock(&g_lock);
+    
+    for (int i = 0; i < TELEMETRY_PHASES; i++) {
+        if (window->phases[i].count > 0 || window->phases[i].failures > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The listener never saw the window, so its samples count toward the next summary
+void telemetry_restore(const telemetry_t* window) {
+    if (!g_enabled) {
+        return;
+    }
+    
+    sync_lock(&g_lock);
+    for (int i = 0; i < TELEMETRY_PHASES; i++) {
+        const telemetry_histogram_t* from = &window->phases[i];
+        telemetry_histogram_t* to = &g_window.phases[i];
+        to->count += from->count;
+        to->failures += from->failures;
+        to->sum_us += from->sum_us;
+        if (from->max_us > to->max_us) {
+            to->max_us = from->max_us;
+        }
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            to->buckets[b] += from->buckets[b];
+        }
+    }
+    sync_unlock(&g_lock);
+}
@@ -0,0 +1,57 @@
+/*
+ * Ghost Protocol Beacon - Telemetry Module
+ * Header file for per-phase check-in timing histograms
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "beacon.h"
+#include <stdint.h>
+
+// Bucket i counts samples of 2^(i-1) to 2^i - 1 microseconds; the last bucket is open-ended
+#define TELEMETRY_BUCKETS 32
+
+// Timed phases of a check-in and of command execution
+typedef enum {
+    TELEMETRY_DNS,
+    TELEMETRY_CONNECT,
+    TELEMETRY_TLS,
+    TELEMETRY_SEND,
+    TELEMETRY_TTFB,        // request sent to first reply byte
+    TELEMETRY_HOLD,        // the same wait, for a check-in the listener was asked to hold
+    TELEMETRY_RECEIVE,     // first reply byte to last
+    TELEMETRY_ENCODE,
+    TELEMETRY_PARSE,
+    TELEMETRY_EXECUTE,
+    TELEMETRY_CHECKIN,     // the whole exchange, encode to parse
+    TELEMETRY_PHASES
+} telemetry_phase_t;
+
+// Samples of one phase since the last summary the listener received
+typedef struct {
+    unsigned long count;
+    unsigned long failures;
+    uint64_t sum_us;
+    unsigned long max_us;
+    unsigned long buckets[TELEMETRY_BUCKETS];
+} telemetry_histogram_t;
+
+typedef struct {
+    telemetry_histogram_t phases[TELEMETRY_PHASES];
+} telemetry_t;
+
+// Telemetry functions; samples are dropped until telemetry_init is called
+void telemetry_init(void);
+long long telemetry_now_us(void);
+void telemetry_record(telemetry_phase_t phase, long long started_us);
+void telemetry_failure(telemetry_phase_t phase);
+const char* telemetry_phase_name(telemetry_phase_t phase);
+int telemetry_bucket(unsigned long elapsed_us);
+
+// Summary hand-off: take empties the window, restore merges it back after a failed check-in
+int telemetry_take(telemetry_t* window);
+void telemetry_restore(const telemetry_t* window);
+telemetry_phase_t telemetry_failed_phase(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,120 @@
+/*
+ * Ghost Protocol Beacon - Thread Synchronization
+ * Portable mutex, condition variable, semaphore and atomic wrappers shared by the threaded modules
+ */
+
+#ifndef THREAD_SYNC_H
+#define THREAD_SYNC_H
+
+#include "beacon.h"
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION sync_mutex_t;
+typedef CONDITION_VARIABLE sync_cond_t;
+#define sync_mutex_init(m) InitializeCriticalSection(m)
+#define sync_lock(m) EnterCriticalSection(m)
+#define sync_unlock(m) LeaveCriticalSection(m)
+#define sync_cond_init(c) InitializeConditionVariable(c)
+#define sync_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define sync_cond_timedwait(c, m, ms) SleepConditionVariableCS(c, m, (DWORD)(ms))
+#define sync_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t sync_mutex_t;
+typedef pthread_cond_t sync_cond_t;
+#define sync_mutex_init(m) pthread_mutex_init(m, NULL)
+#define sync_lock(m) pthread_mutex_lock(m)
+#define sync_unlock(m) pthread_mutex_unlock(m)
+#define sync_cond_init(c) pthread_cond_init(c, NULL)
+#define sync_cond_wait(c, m) pthread_cond_wait(c, m)
+#define sync_cond_broadcast(c) pthread_cond_broadcast(c)
+
+// Waits up to ms milliseconds; pthread wants an absolute wall-clock deadline
+static inline void sync_cond_timedwait(sync_cond_t* c, sync_mutex_t* m, int ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(c, m, &deadline);
+}
+#endif
+
+// Counting semaphores: posting never blocks, which keeps wake-ups off any lock
+#if defined(_WIN32)
+typedef HANDLE sync_sem_t;
+#define sync_sem_init(s) (*(s) = CreateSemaphoreA(NULL, 0, 0x7FFFFFFF, NULL))
+#define sync_sem_post(s) ReleaseSemaphore(*(s), 1, NULL)
+#define sync_sem_wait(s) WaitForSingleObject(*(s), INFINITE)
+#define sync_sem_trywait(s) (WaitForSingleObject(*(s), 0) == WAIT_OBJECT_0 ? 0 : -1)
+#define sync_sem_timedwait(s, ms) (WaitForSingleObject(*(s), (DWORD)(ms)) == WAIT_OBJECT_0 ? 0 : -1)
+#elif defined(__APPLE__)
+// macOS has no unnamed POSIX semaphores
+#include <dispatch/dispatch.h>
+typedef dispatch_semaphore_t sync_sem_t;
+#define sync_sem_init(s) (*(s) = dispatch_semaphore_create(0))
+#define sync_sem_post(s) dispatch_semaphore_signal(*(s))
+#define sync_sem_wait(s) dispatch_semaphore_wait(*(s), DISPATCH_TIME_FOREVER)
+#define sync_sem_trywait(s) (dispatch_semaphore_wait(*(s), DISPATCH_TIME_NOW) == 0 ? 0 : -1)
+#define sync_sem_timedwait(s, ms) \
+    (dispatch_semaphore_wait(*(s), dispatch_time(DISPATCH_TIME_NOW, (int64_t)(ms) * 1000000)) == 0 ? 0 : -1)
+#else
+#include <errno.h>
+#include <semaphore.h>
+typedef sem_t sync_sem_t;
+#define sync_sem_init(s) sem_init(s, 0, 0)
+#define sync_sem_post(s) sem_post(s)
+#define sync_sem_trywait(s) sem_trywait(s)
+
+static inline void sync_sem_wait(sync_sem_t* s) {
+    while (sem_wait(s) != 0 && errno == EINTR) {
+    }
+}
+
+// Returns 0 once the semaphore is taken, -1 when ms milliseconds pass first
+static inline int sync_sem_timedwait(sync_sem_t* s, int ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(s, &deadline) != 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+#endif
+
+// Word-sized atomics; loads acquire and stores release, which is all the SPSC rings need
+#if defined(__GNUC__) || defined(__clang__)
+#define sync_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define sync_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define sync_fetch_add(p, v) __atomic_fetch_add(p, v, __ATOMIC_ACQ_REL)
+
+static inline int sync_cas(volatile long* p, long expected, long desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// 64-bit values such as millisecond deadlines, whatever the width of long
+#define sync_load64(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define sync_store64(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+// long is 32 bits here, the width of the Interlocked LONG functions
+#define sync_load(p) InterlockedCompareExchange((volatile LONG*)(p), 0, 0)
+#define sync_store(p, v) InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#define sync_fetch_add(p, v) InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v))
+#define sync_cas(p, expected, desired) \
+    (InterlockedCompareExchange((volatile LONG*)(p), (LONG)(desired), (LONG)(expected)) == (LONG)(expected))
+#define sync_load64(p) InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0)
+#define sync_store64(p, v) InterlockedExchange64((volatile LONG64*)(p), (LONG64)(v))
+#endif
+
+#endif // THREAD_SYNC_H
@@ -0,0 +1,187 @@
+/*
+ * Ghost Protocol Beacon - Timer Wheel
+ * Hierarchical timer wheel behind recurring commands
+ */
+
+#include "timer_wheel.h"
+
+#include <string.h>
+
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_BITS)
+#define SLOT_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+#define WHEEL_SPAN ((uint64_t)1 << LEVEL_SHIFT(TIMER_WHEEL_LEVELS))
+
+static void file_entry(timer_wheel_t* wheel, timer_entry_t* entry) {
+    uint64_t target = entry->expires;
+    int level = 0;
+    
+    // Overdue entries fire on the next tick; ones past the top level are parked at the far
+    // end of it and filed again when that slot cascades
+    if (target < wheel->next_tick) {
+        target = wheel->next_tick;
+    } else if (target - wheel->next_tick >= WHEEL_SPAN) {
+        target = wheel->next_tick + WHEEL_SPAN - 1;
+    }
+    
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           target - wheel->next_tick >= ((uint64_t)1 << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+    
+    int slot = (int)((target >> LEVEL_SHIFT(level)) & SLOT_MASK);
+    
+    entry->level = level;
+    entry->slot = slot;
+    entry->prev = NULL;
+    entry->next = wheel->slots[level][slot];
+    if (entry->next) {
+        entry->next->prev = entry;
+    }
+    wheel->slots[level][slot] = entry;
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+}
+
+// Detach a whole slot, leaving it empty
+static timer_entry_t* take_slot(timer_wheel_t* wheel, int level, int slot) {
+    timer_entry_t* list = wheel->slots[level][slot];
+    
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~((uint64_t)1 << slot);
+    return list;
+}
+
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->next_tick = now;
+}
+
+void timer_wheel_add(timer_wheel_t* wheel, timer_entry_t* entry, uint64_t expires) {
+    entry->expires = expires;
+    file_entry(wheel, entry);
+    wheel->count++;
+}
+
+void timer_wheel_remove(timer_wheel_t* wheel, timer_entry_t* entry) {
+    if (entry->level < 0) {
+        return;
+    }
+    
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        wheel->slots[entry->level][entry->slot] = entry->next;
+        if (!entry->next) {
+            wheel->occupied[entry->level] &= ~((uint64_t)1 << entry->slot);
+        }
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->level = -1;
+    wheel->count--;
+}
+
+// Run every tick up to and including now. The expired entries come back as a list linked
+// through next; each is already off the wheel, so the caller may add it again while walking
+// the list as long as it reads next first.
+timer_entry_t* timer_wheel_advance(timer_wheel_t* wheel, uint64_t now) {
+    timer_entry_t* expired = NULL;
+    
+    while (wheel->next_tick <= now) {
+        uint64_t tick = wheel->next_tick;
+        
+        if (wheel->count == 0) {
+            wheel->next_tick = now + 1;
+            break;
+        }
+        
+        // On a level-0 wrap, pull the slots that now fall inside the lower levels down,
+        // highest level first so refiled entries can cascade again on the same tick
+        if ((tick & SLOT_MASK) == 0) {
+            for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+                if ((tick & (((uint64_t)1 << LEVEL_SHIFT(level)) - 1)) != 0) {
+                    continue;
+                }
+                
+                timer_entry_t* list = take_slot(wheel, level, (int)((tick >> LEVEL_SHIFT(level)) & SLOT_MASK));
+                while (list) {
+                    timer_entry_t* next = list->next;
+                    file_entry(wheel, list);
+                    list = next;
+                }
+            }
+        }
+        
+        timer_entry_t* list = take_slot(wheel, 0, (int)(tick & SLOT_MASK));
+        while (list) {
+            timer_entry_t* next = list->next;
+            list->level = -1;
+            list->prev = NULL;
+            list->next = expired;
+            expired = list;
+            wheel->count--;
+            list = next;
+        }
+        
+        // Skip the idle stretch of this level-0 rotation in one step
+        uint64_t pending = wheel->occupied[0] >> (tick & SLOT_MASK) >> 1;
+        uint64_t skip_to;
+        
+        if ((tick & SLOT_MASK) == SLOT_MASK || pending == 0) {
+            skip_to = (tick | SLOT_MASK) + 1;
+        } else {
+            int gap = 1;
+            while (!(pending & 1)) {
+                pending >>= 1;
+                gap++;
+            }
+            skip_to = tick + gap;
+        }
+        
+        wheel->next_tick = skip_to <= now ? skip_to : now + 1;
+    }
+    
+    return expired;
+}
+
+// Ticks from next_tick until the first one that may expire something, or -1 when the wheel
+// is empty. Exact for level 0; for higher levels it is the time their slot cascades, which
+// is never later than the expiry it holds.
+int64_t timer_wheel_next(const timer_wheel_t* wheel) {
+    uint64_t now = wheel->next_tick;
+    int64_t best = -1;
+    
+    if (wheel->count == 0) {
+        return -1;
+    }
+    
+    for (int offset = 0; offset < TIMER_WHEEL_SLOTS; offset++) {
+        int slot = (int)((now + offset) & SLOT_MASK);
+        if (wheel->occupied[0] & ((uint64_t)1 << slot)) {
+            best = offset;
+            break;
+        }
+    }
+    
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        // First block of this level whose cascade is still ahead of us
+        uint64_t block = (now + ((uint64_t)1 << LEVEL_SHIFT(level)) - 1) >> LEVEL_SHIFT(level);
+        
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            if (!(wheel->occupied[level] & ((uint64_t)1 << slot))) {
+                continue;
+            }
+            
+            uint64_t target = block + (((uint64_t)slot - block) & SLOT_MASK);
+            int64_t ticks = (int64_t)((target << LEVEL_SHIFT(level)) - now);
+            if (best < 0 || ticks < best) {
+                best = ticks;
+            }
+        }
+    }
+    
+    return best;
+}
@@ -0,0 +1,40 @@
+/*
+ * Ghost Protocol Beacon - Timer Wheel
+ * Header file for the hierarchical timer wheel behind recurring commands
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4   // 2^24 ticks ahead; later expiries are filed again on the way
+
+// Embedded in the owner's record; the wheel never allocates
+typedef struct timer_entry {
+    struct timer_entry* next;
+    struct timer_entry* prev;
+    uint64_t expires;             // absolute tick
+    int level;                    // position while filed, -1 otherwise
+    int slot;
+} timer_entry_t;
+
+// Level 0 holds the next 64 ticks one per slot; each level above covers 64 times the span
+// of the one below and is cascaded down a slot at a time as the wheel turns
+typedef struct {
+    uint64_t next_tick;           // first tick not yet processed
+    timer_entry_t* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t occupied[TIMER_WHEEL_LEVELS];   // one bit per non-empty slot
+    int count;
+} timer_wheel_t;
+
+// Timer wheel functions
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now);
+void timer_wheel_add(timer_wheel_t* wheel, timer_entry_t* entry, uint64_t expires);
+void timer_wheel_remove(timer_wheel_t* wheel, timer_entry_t* entry);
+timer_entry_t* timer_wheel_advance(timer_wheel_t* wheel, uint64_t now);
+int64_t timer_wheel_next(const timer_wheel_t* wheel);
+
+#endif // TIMER_WHEEL_H
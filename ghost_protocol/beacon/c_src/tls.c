@@ -0,0 +1,239 @@
+/*
+ * Ghost Protocol Beacon - TLS Module Implementation
+ * OpenSSL client with one cached session so reconnects resume instead of doing a full handshake
+ */
+
+#include "tls.h"
+
+#if !defined(_WIN32) && !defined(BEACON_NO_TLS)
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <signal.h>
+
+struct tls_connection {
+    SSL* ssl;
+    char hostname[256];
+    int port;
+    int resuming;     // offered the cached session, dropped if the handshake fails
+};
+
+static SSL_CTX* g_ctx = NULL;
+
+// Newest session ticket from the listener we last talked to
+static SSL_SESSION* g_session = NULL;
+static char g_session_host[256];
+static int g_session_port = 0;
+
+// OpenSSL writes with plain send(), so a reset peer would raise SIGPIPE. Ignoring it
+// process-wide would leak into shell commands, so it is held off around each call instead.
+typedef struct {
+    sigset_t saved;
+} sigpipe_guard_t;
+
+static void sigpipe_hold(sigpipe_guard_t* guard) {
+#ifndef SO_NOSIGPIPE
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, &guard->saved);
+#else
+    (void)guard;
+#endif
+}
+
+static void sigpipe_release(sigpipe_guard_t* guard) {
+#ifndef SO_NOSIGPIPE
+    sigset_t set;
+    sigset_t pending;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    
+    // Swallow a SIGPIPE raised while blocked so it is not delivered on unblock
+    if (sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE)) {
+        struct timespec zero = {0, 0};
+        sigtimedwait(&set, NULL, &zero);
+    }
+    pthread_sigmask(SIG_SETMASK, &guard->saved, NULL);
+#else
+    (void)guard;
+#endif
+}
+
+static void drop_session(void) {
+    if (g_session) {
+        SSL_SESSION_free(g_session);
+        g_session = NULL;
+    }
+    g_session_host[0] = '\0';
+    g_session_port = 0;
+}
+
+// TLS 1.3 tickets arrive after the handshake, so they are picked up from this callback
+static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+    tls_connection_t* conn = SSL_get_app_data(ssl);
+    if (!conn) {
+        return 0;
+    }
+    
+    drop_session();
+    g_session = session;
+    snprintf(g_session_host, sizeof(g_session_host), "%s", conn->hostname);
+    g_session_port = conn->port;
+    return 1;   // we keep the reference
+}
+
+static int tls_init(void) {
+    if (g_ctx) {
+        return 0;
+    }
+    
+    g_ctx = SSL_CTX_new(TLS_client_method());
+    if (!g_ctx) {
+        return -1;
+    }
+    
+    SSL_CTX_set_min_proto_version(g_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_default_verify_paths(g_ctx);
+    
+    // Sessions are cached here rather than in OpenSSL's internal store
+    SSL_CTX_set_session_cache_mode(g_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(g_ctx, on_new_session);
+    
+    // Sockets are non-blocking, so a write may stop part way and be retried from a new offset
+    SSL_CTX_set_mode(g_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    return 0;
+}
+
+// TLS_WANT_* for a call that would block, -1 for anything else
+static int want_or_fail(tls_connection_t* conn, int result) {
+    int error = SSL_get_error(conn->ssl, result);
+    ERR_clear_error();
+    if (error == SSL_ERROR_WANT_READ) {
+        return TLS_WANT_READ;
+    }
+    if (error == SSL_ERROR_WANT_WRITE) {
+        return TLS_WANT_WRITE;
+    }
+    return -1;
+}
+
+// Sets up the client side; tls_handshake then drives it to completion
+tls_connection_t* tls_start(int sockfd, const char* hostname, int port, int verify_ssl) {
+    if (tls_init() != 0) {
+        return NULL;
+    }
+    
+    tls_connection_t* conn = calloc(1, sizeof(tls_connection_t));
+    if (!conn) {
+        return NULL;
+    }
+    snprintf(conn->hostname, sizeof(conn->hostname), "%s", hostname);
+    conn->port = port;
+    
+    conn->ssl = SSL_new(g_ctx);
+    if (!conn->ssl) {
+        free(conn);
+        return NULL;
+    }
+    SSL_set_app_data(conn->ssl, conn);
+    SSL_set_fd(conn->ssl, sockfd);
+    SSL_set_tlsext_host_name(conn->ssl, hostname);
+    
+    if (verify_ssl) {
+        SSL_set_verify(conn->ssl, SSL_VERIFY_PEER, NULL);
+        SSL_set1_host(conn->ssl, hostname);
+    } else {
+        SSL_set_verify(conn->ssl, SSL_VERIFY_NONE, NULL);
+    }
+    
+    conn->resuming = g_session && g_session_port == port && strcmp(g_session_host, hostname) == 0;
+    if (conn->resuming) {
+        SSL_set_session(conn->ssl, g_session);
+    }
+    
+    return conn;
+}
+
+// 0 once the handshake is done, TLS_WANT_* while it waits on the socket, -1 on failure
+int tls_handshake(tls_connection_t* conn) {
+    sigpipe_guard_t guard;
+    sigpipe_hold(&guard);
+    int connected = SSL_connect(conn->ssl);
+    sigpipe_release(&guard);
+    
+    if (connected == 1) {
+        return 0;
+    }
+    
+    int status = want_or_fail(conn, connected);
+    if (status == -1 && conn->resuming) {
+        // A rejected ticket must not poison the next attempt
+        drop_session();
+    }
+    return status;
+}
+
+// Bytes written, possibly fewer than asked, or TLS_WANT_* / -1
+long tls_send(tls_connection_t* conn, const char* data, size_t length) {
+    sigpipe_guard_t guard;
+    int chunk = length > 0x40000000 ? 0x40000000 : (int)length;
+    
+    sigpipe_hold(&guard);
+    int sent = SSL_write(conn->ssl, data, chunk);
+    sigpipe_release(&guard);
+    
+    return sent > 0 ? sent : want_or_fail(conn, sent);
+}
+
+// Same contract as recv: bytes read, 0 once the peer has closed, TLS_WANT_* / -1 otherwise
+long tls_recv(tls_connection_t* conn, char* buffer, size_t length) {
+    sigpipe_guard_t guard;
+    int chunk = length > 0x40000000 ? 0x40000000 : (int)length;
+    
+    // Reads can write too (alerts, key updates)
+    sigpipe_hold(&guard);
+    int received = SSL_read(conn->ssl, buffer, chunk);
+    sigpipe_release(&guard);
+    
+    if (received > 0) {
+        return received;
+    }
+    
+    int error = SSL_get_error(conn->ssl, received);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        return want_or_fail(conn, received);
+    }
+    ERR_clear_error();
+    // A missing close_notify is how most servers end an idle keep-alive connection
+    return (error == SSL_ERROR_ZERO_RETURN || error == SSL_ERROR_SYSCALL) ? 0 : -1;
+}
+
+int tls_session_reused(const tls_connection_t* conn) {
+    return SSL_session_reused(conn->ssl);
+}
+
+// Sends close_notify without waiting for the reply; the caller closes the socket
+void tls_close(tls_connection_t* conn) {
+    if (!conn) {
+        return;
+    }
+    sigpipe_guard_t guard;
+    sigpipe_hold(&guard);
+    SSL_shutdown(conn->ssl);
+    sigpipe_release(&guard);
+    ERR_clear_error();
+    SSL_free(conn->ssl);
+    free(conn);
+}
+
+void tls_cleanup(void) {
+    drop_session();
+    if (g_ctx) {
+        SSL_CTX_free(g_ctx);
+        g_ctx = NULL;
+    }
+}
+
+#endif
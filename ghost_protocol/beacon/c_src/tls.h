@@ -0,0 +1,31 @@
+/*
+ * Ghost Protocol Beacon - TLS Module
+ * Header file for the OpenSSL client transport used by https_request
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include "beacon.h"
+
+#if !defined(_WIN32) && !defined(BEACON_NO_TLS)
+
+// Returned instead of blocking on a non-blocking socket: wait for that readiness and retry
+#define TLS_WANT_READ -2
+#define TLS_WANT_WRITE -3
+
+// Opaque TLS state for one connected socket
+typedef struct tls_connection tls_connection_t;
+
+// TLS functions
+tls_connection_t* tls_start(int sockfd, const char* hostname, int port, int verify_ssl);
+int tls_handshake(tls_connection_t* conn);
+long tls_send(tls_connection_t* conn, const char* data, size_t length);
+long tls_recv(tls_connection_t* conn, char* buffer, size_t length);
+int tls_session_reused(const tls_connection_t* conn);
+void tls_close(tls_connection_t* conn);
+void tls_cleanup(void);
+
+#endif
+
+#endif // TLS_H
@@ -0,0 +1,248 @@
+/*
+ * Ghost Protocol Beacon - TLV Module Implementation
+ * Encodes check-ins and decodes command batches as type/length/value records
+ */
+
+#include "tlv.h"
+#include "records.h"
+
+int tlv_writer_init(tlv_writer_t* writer, arena_t* arena, size_t initial_capacity) {
+    memset(writer, 0, sizeof(tlv_writer_t));
+    writer->arena = arena;
+    writer->capacity = initial_capacity > TLV_MAGIC_SIZE ? initial_capacity : 256;
+    writer->data = arena ? arena_alloc(arena, writer->capacity) : malloc(writer->capacity);
+    if (!writer->data) {
+        writer->error = 1;
+        writer->capacity = 0;
+        return -1;
+    }
+    
+    memcpy(writer->data, TLV_MAGIC, TLV_MAGIC_SIZE);
+    writer->length = TLV_MAGIC_SIZE;
+    return 0;
+}
+
+void tlv_writer_free(tlv_writer_t* writer) {
+    if (!writer->arena) {
+        free(writer->data);
+    }
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+}
+
+static int reserve(tlv_writer_t* writer, size_t extra) {
+    if (writer->error) {
+        return -1;
+    }
+    if (writer->length + extra <= writer->capacity) {
+        return 0;
+    }
+    
+    size_t capacity = writer->capacity * 2;
+    while (writer->length + extra > capacity) {
+        capacity *= 2;
+    }
+    
+    char* grown = writer->arena
+        ? arena_realloc(writer->arena, writer->data, writer->capacity, capacity)
+        : realloc(writer->data, capacity);
+    if (!grown) {
+        writer->error = 1;
+        return -1;
+    }
+    writer->data = grown;
+    writer->capacity = capacity;
+    return 0;
+}
+
+static void store_u32(char* out, uint32_t value) {
+    out[0] = (char)(value >> 24);
+    out[1] = (char)(value >> 16);
+    out[2] = (char)(value >> 8);
+    out[3] = (char)value;
+}
+
+static void write_header(tlv_writer_t* writer, tlv_type_t type, size_t length) {
+    writer->data[writer->length] = (char)type;
+    store_u32(writer->data + writer->length + 1, (uint32_t)length);
+    writer->length += TLV_HEADER_SIZE;
+}
+
+void tlv_begin(tlv_writer_t* writer, tlv_type_t type) {
+    if (writer->depth >= TLV_MAX_DEPTH) {
+        writer->error = 1;
+        return;
+    }
+    if (reserve(writer, TLV_HEADER_SIZE) != 0) {
+        return;
+    }
+    
+    // The length is unknown until the container closes
+    writer->open[writer->depth++] = writer->length;
+    write_header(writer, type, 0);
+}
+
+void tlv_end(tlv_writer_t* writer) {
+    if (writer->error || writer->depth == 0) {
+        return;
+    }
+    size_t start = writer->open[--writer->depth];
+    store_u32(writer->data + start + 1, (uint32_t)(writer->length - start - TLV_HEADER_SIZE));
+}
+
+void tlv_put(tlv_writer_t* writer, tlv_type_t type, const char* value, size_t length) {
+    if (length > UINT32_MAX) {
+        writer->error = 1;
+        return;
+    }
+    if (reserve(writer, TLV_HEADER_SIZE + length) != 0) {
+        return;
+    }
+    write_header(writer, type, length);
+    if (length > 0) {
+        memcpy(writer->data + writer->length, value, length);
+        writer->length += length;
+    }
+}
+
+void tlv_put_string(tlv_writer_t* writer, tlv_type_t type, const char* value) {
+    tlv_put(writer, type, value, strlen(value));
+}
+
+void tlv_put_u8(tlv_writer_t* writer, tlv_type_t type, unsigned int value) {
+    char byte = (char)value;
+    tlv_put(writer, type, &byte, 1);
+}
+
+void tlv_put_u32(tlv_writer_t* writer, tlv_type_t type, uint32_t value) {
+    char bytes[4];
+    store_u32(bytes, value);
+    tlv_put(writer, type, bytes, sizeof(bytes));
+}
+
+void tlv_put_u64(tlv_writer_t* writer, tlv_type_t type, uint64_t value) {
+    char bytes[8];
+    store_u32(bytes, (uint32_t)(value >> 32));
+    store_u32(bytes + 4, (uint32_t)value);
+    tlv_put(writer, type, bytes, sizeof(bytes));
+}
+
+void tlv_reader_init(tlv_reader_t* reader, const char* data, size_t length) {
+    reader->pos = data;
+    reader->end = data + length;
+}
+
+// Returns 1 with the next record, 0 at the end, -1 on a truncated record
+int tlv_next(tlv_reader_t* reader, tlv_field_t* field) {
+    size_t left = (size_t)(reader->end - reader->pos);
+    if (left == 0) {
+        return 0;
+    }
+    if (left < TLV_HEADER_SIZE) {
+        return -1;
+    }
+    
+    const unsigned char* header = (const unsigned char*)reader->pos;
+    size_t length = ((size_t)header[1] << 24) | ((size_t)header[2] << 16) |
+                    ((size_t)header[3] << 8) | (size_t)header[4];
+    if (length > left - TLV_HEADER_SIZE) {
+        return -1;
+    }
+    
+    field->type = header[0];
+    field->value = reader->pos + TLV_HEADER_SIZE;
+    field->length = length;
+    reader->pos += TLV_HEADER_SIZE + length;
+    return 1;
+}
+
+// Integers are big-endian and as wide as their record says
+uint64_t tlv_field_uint(const tlv_field_t* field) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < field->length && i < 8; i++) {
+        value = (value << 8) | (unsigned char)field->value[i];
+    }
+    return value;
+}
+
+int tlv_is_tlv(const char* data, size_t length) {
+    return length >= TLV_MAGIC_SIZE && memcmp(data, TLV_MAGIC, TLV_MAGIC_SIZE) == 0;
+}
+
+static command_record_t* parse_command(const tlv_field_t* container, arena_t* arena) {
+    tlv_reader_t reader;
+    tlv_field_t field;
+    tlv_field_t id = {0, "", 0};
+    tlv_field_t name = {0, "", 0};
+    tlv_field_t args = {0, "", 0};
+    unsigned int opcode = 0;
+    int status;
+    
+    tlv_reader_init(&reader, container->value, container->length);
+    while ((status = tlv_next(&reader, &field)) == 1) {
+        if (field.type == TLV_COMMAND_ID) {
+            id = field;
+        } else if (field.type == TLV_COMMAND_NAME) {
+            name = field;
+        } else if (field.type == TLV_COMMAND_ARGS) {
+            args = field;
+        } else if (field.type == TLV_COMMAND_OPCODE) {
+            opcode = (unsigned int)tlv_field_uint(&field);
+        }
+    }
+    if (status < 0) {
+        return NULL;
+    }
+    
+    if (id.length > COMMAND_ID_MAX - 1) {
+        id.length = COMMAND_ID_MAX - 1;
+    }
+    command_record_t* command = command_record_alloc(arena, id.length + name.length + args.length + 3);
+    if (!command) {
+        return NULL;
+    }
+    
+    // Values are raw bytes, so each field is a straight copy
+    command->id_length = (unsigned int)id.length;
+    memcpy(COMMAND_ID(command), id.value, id.length);
+    COMMAND_ID(command)[id.length] = '\0';
+    command->name_length = (unsigned int)name.length;
+    memcpy(COMMAND_NAME(command), name.value, name.length);
+    COMMAND_NAME(command)[name.length] = '\0';
+    command->args_length = (unsigned int)args.length;
+    memcpy(COMMAND_ARGS(command), args.value, args.length);
+    COMMAND_ARGS(command)[args.length] = '\0';
+    command->opcode = opcode;
+    return command;
+}
+
+// ack receives the TLV_ACK value and is left alone when the reply has none
+int tlv_parse_commands(const char* data, size_t length, arena_t* arena,
+                       command_record_t** commands, int max_commands, long* ack) {
+    if (!tlv_is_tlv(data, length)) {
+        return 0;
+    }
+    
+    tlv_reader_t reader;
+    tlv_field_t field;
+    int count = 0;
+    
+    tlv_reader_init(&reader, data + TLV_MAGIC_SIZE, length - TLV_MAGIC_SIZE);
+    while (tlv_next(&reader, &field) == 1) {
+        if (field.type == TLV_ACK && ack) {
+            *ack = (long)tlv_field_uint(&field);
+            continue;
+        }
+        // Unknown top-level records are skipped so the listener can add new ones
+        if (field.type != TLV_COMMAND || count >= max_commands) {
+            continue;
+        }
+        if ((commands[count] = parse_command(&field, arena)) == NULL) {
+            return count;
+        }
+        count++;
+    }
+    
+    return count;
+}
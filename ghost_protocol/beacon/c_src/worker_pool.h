@@ -0,0 +1,44 @@
+/*
+ * Ghost Protocol Beacon - Worker Pool
+ * Header file for concurrent command execution off the network thread
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "beacon.h"
+#include "spsc_queue.h"
+#include "thread_sync.h"
+
+#define WORKER_POOL_DEFAULT_THREADS 4
+#define WORKER_POOL_MAX_THREADS 32
+#define WORKER_POOL_MAX_JOBS SPSC_QUEUE_CAPACITY   // commands submitted and not yet reported
+#define WORKER_POOL_DEFAULT_TIMEOUT 300   // seconds before a command is reported as timed out
+#define WORKER_POOL_TIMEOUT_GRACE_MS 5000   // shell commands kill themselves at the limit; the
+                                            // pool abandons only commands still running after this
+
+#define WORKER_ABANDONED (-1L)   // worker_t.running once its command has timed out
+
+// One worker thread and the rings it shares with the network thread. Commands go out
+// and results come back without a lock; the semaphore only wakes an idle worker
+typedef struct {
+    spsc_queue_t commands;        // heap command copies, network thread to worker
+    spsc_queue_t results;         // heap result records, worker to network thread
+    sync_sem_t work_ready;
+    volatile long running;        // ticket of the command being run, 0 while idle
+    volatile long long deadline_ms;
+    char running_id[COMMAND_ID_MAX];
+    int outstanding;              // network thread only: submitted, not yet reported
+    int alive;                    // network thread only: a thread serves the rings
+} worker_t;
+
+// Worker pool functions; all but notify belong to the network thread
+int worker_pool_init(int thread_count, int timeout_seconds);
+int worker_pool_submit(const command_record_t* command);
+int worker_pool_collect(result_record_t** results, int max_results);
+int worker_pool_pending(void);
+int worker_pool_wait(int timeout_ms);
+void worker_pool_notify(void);
+void worker_pool_shutdown(int grace_ms);
+
+#endif // WORKER_POOL_H
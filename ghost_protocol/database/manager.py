@@ -247,8 +247,9 @@ class DatabaseManager:
             self.logger.error(f"Failed to close session: {e}")
             return False
     
-    async def create_command(self, command_id: str, beacon_id: str, command: str, args: Dict[str, Any]) -> bool:
-        """Create a new command record"""
+    async def create_command(self, command_id: str, beacon_id: str, command: str, args: Dict[str, Any],
+                             status: str = 'pending') -> bool:
+        """Create a new command record; one the beacon started itself is created as 'sent'"""
         if not self._initialized or not HAS_DATABASE:
             return True
         
@@ -260,7 +261,7 @@ class DatabaseManager:
                     command=command,
                     args=json.dumps(args),
                     created_at=datetime.now(timezone.utc),
-                    status='pending'
+                    status=status
                 )
                 
                 session.add(command_record)
@@ -273,26 +274,51 @@ class DatabaseManager:
             self.logger.error(f"Failed to create command: {e}")
             return False
     
-    async def get_pending_commands(self, beacon_id: str) -> List[Dict[str, Any]]:
-        """Get pending commands for a beacon"""
+    async def get_command(self, command_id: str) -> Optional[Dict[str, Any]]:
+        """Get one command by id, or None if there is no such command"""
+        if not self._initialized or not HAS_DATABASE:
+            return None
+        
+        try:
+            async with self.async_session() as session:
+                cmd = await session.get(Command, command_id)
+                if cmd is None:
+                    return None
+                
+                return {
+                    "id": cmd.id,
+                    "beacon_id": cmd.beacon_id,
+                    "command": cmd.command,
+                    "args": json.loads(cmd.args) if cmd.args else {}
+                }
+                
+        except Exception as e:
+            self.logger.error(f"Failed to get command: {e}")
+            return None
+    
+    async def get_pending_commands(self, beacon_id: str, limit: Optional[int] = None) -> List[Dict[str, Any]]:
+        """Get pending commands for a beacon, oldest first, up to limit"""
         if not self._initialized or not HAS_DATABASE:
             return []
         
         try:
             async with self.async_session() as session:
-                result = await session.execute(
+                query = (
                     sa.select(Command)
                     .where(Command.beacon_id == beacon_id, Command.status == 'pending')
                     .order_by(Command.created_at)
                 )
+                if limit is not None:
+                    query = query.limit(limit)
                 
+                result = await session.execute(query)
                 commands = result.scalars().all()
                 
-                # Mark commands as sent
+                # Mark only the returned commands as sent; the rest stay pending
                 if commands:
                     await session.execute(
                         sa.update(Command)
-                        .where(Command.beacon_id == beacon_id, Command.status == 'pending')
+                        .where(Command.id.in_([cmd.id for cmd in commands]))
                         .values(status='sent', sent_at=datetime.now(timezone.utc))
                     )
                     await session.commit()
@@ -310,8 +336,19 @@ class DatabaseManager:
             self.logger.error(f"Failed to get pending commands: {e}")
             return []
     
+    @staticmethod
+    def _is_transient(error: Exception) -> bool:
+        """Whether a failed write may succeed if retried: a lost connection, a timeout or a lock"""
+        if isinstance(error, (asyncio.TimeoutError, ConnectionError, sa.exc.TimeoutError, sa.exc.OperationalError)):
+            return True
+        return isinstance(error, sa.exc.DBAPIError) and error.connection_invalidated
+    
     async def store_command_result(self, command_id: str, beacon_id: str, output: str, success: bool) -> bool:
-        """Store command execution result"""
+        """Store command execution result
+        
+        Returns False when the write may succeed if retried. Any other failure, such as a
+        missing command row or a duplicate result, is raised, since a resend fails the same way.
+        """
         if not self._initialized or not HAS_DATABASE:
             return True
         
@@ -342,6 +379,8 @@ class DatabaseManager:
             return True
             
         except Exception as e:
+            if not self._is_transient(e):
+                raise
             self.logger.error(f"Failed to store command result: {e}")
             return False
     
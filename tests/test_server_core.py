@@ -0,0 +1,459 @@
+"""
+Tests for Ghost Protocol team server core
+"""
+
+import asyncio
+import base64
+import json
+import zlib
+import pytest
+from unittest.mock import Mock, AsyncMock
+from ghost_protocol.server.core import TeamServerCore, HTTPListener
+
+
+@pytest.fixture
+def server_core(test_config):
+    """Create a server core with a mocked database"""
+    core = TeamServerCore(test_config, Mock())
+    core.db_manager = AsyncMock()
+    return core
+
+
+class TestBeaconOutput:
+    """Test command output handling"""
+    
+    @pytest.mark.asyncio
+    async def test_plain_output_stored(self, server_core):
+        """Test that unchunked output is stored directly"""
+        await server_core._handle_beacon_output({
+            "beacon_id": "beacon-1",
+            "command_id": "cmd-1",
+            "output": "hello",
+            "success": True
+        })
+        
+        server_core.db_manager.store_command_result.assert_called_once_with(
+            command_id="cmd-1", beacon_id="beacon-1", output="hello", success=True
+        )
+    
+    @pytest.mark.asyncio
+    async def test_chunks_reassembled_out_of_order(self, server_core):
+        """Test that chunked output is stored once, in sequence order"""
+        chunks = [
+            {"output": "C", "sequence": 2, "final": True, "success": False},
+            {"output": "A", "sequence": 0, "final": False, "success": True},
+            {"output": "B", "sequence": 1, "final": False, "success": True},
+        ]
+        
+        for chunk in chunks:
+            await server_core._handle_beacon_output(
+                dict(chunk, beacon_id="beacon-1", command_id="cmd-1")
+            )
+        
+        server_core.db_manager.store_command_result.assert_called_once_with(
+            command_id="cmd-1", beacon_id="beacon-1", output="ABC", success=False
+        )
+        assert server_core.output_streams == {}
+    
+    @pytest.mark.asyncio
+    async def test_incomplete_stream_not_stored(self, server_core):
+        """Test that a stream missing chunks stays buffered"""
+        await server_core._handle_beacon_output({
+            "beacon_id": "beacon-1", "command_id": "cmd-1",
+            "output": "B", "sequence": 1, "final": True
+        })
+        
+        server_core.db_manager.store_command_result.assert_not_called()
+        assert ("beacon-1", "cmd-1") in server_core.output_streams
+    
+    @pytest.mark.asyncio
+    async def test_retransmitted_chunk_ignored(self, server_core):
+        """Test that a resent chunk does not duplicate output"""
+        for chunk in [("A", 0, False), ("A", 0, False), ("B", 1, True)]:
+            await server_core._handle_beacon_output({
+                "beacon_id": "beacon-1", "command_id": "cmd-1",
+                "output": chunk[0], "sequence": chunk[1], "final": chunk[2]
+            })
+        
+        server_core.db_manager.store_command_result.assert_called_once_with(
+            command_id="cmd-1", beacon_id="beacon-1", output="AB", success=True
+        )
+
+
+class TestResultAcks:
+    """Test acknowledgement of numbered result uploads"""
+    
+    @pytest.mark.asyncio
+    async def test_retransmits_stored_once(self, server_core):
+        """Test that resent results are acknowledged without being stored again"""
+        batch = [{"command_id": f"cmd-{i}", "output": "x", "result_seq": i} for i in range(3)]
+        
+        assert await server_core.store_beacon_results("beacon-1", batch) == 3
+        assert await server_core.store_beacon_results("beacon-1", batch[1:]) == 3
+        
+        assert server_core.db_manager.store_command_result.call_count == 3
+    
+    @pytest.mark.asyncio
+    async def test_ack_stops_at_first_failure(self, server_core):
+        """Test that only the results before a failed store are acknowledged"""
+        server_core.db_manager.store_command_result.side_effect = [True, False, True]
+        batch = [{"command_id": f"cmd-{i}", "output": "x", "result_seq": 10 + i} for i in range(3)]
+        
+        assert await server_core.store_beacon_results("beacon-1", batch) == 11
+        assert server_core.db_manager.store_command_result.call_count == 2
+    
+    @pytest.mark.asyncio
+    async def test_rejected_result_acknowledged(self, server_core):
+        """Test that a result the database rejects on every resend does not hold back the rest"""
+        server_core.db_manager.store_command_result.side_effect = ValueError("duplicate key")
+        batch = [{"command_id": f"cmd-{i}", "output": "x", "result_seq": i} for i in range(2)]
+        
+        for _ in range(3):
+            assert await server_core.store_beacon_results("beacon-1", batch) == 2
+        assert server_core.db_manager.store_command_result.call_count == 2
+    
+    @pytest.mark.asyncio
+    async def test_unwritable_download_acknowledged(self, server_core, tmp_path):
+        """Test that a chunk that cannot be written is dropped rather than retried forever"""
+        local = tmp_path / "missing" / "loot.bin"
+        command_id = await server_core.start_download("beacon-1", "/etc/remote", str(local))
+        batch = [
+            {"command_id": command_id, "data": "AAAA", "offset": 0, "final": True, "result_seq": 0},
+            {"command_id": "cmd-1", "output": "x", "result_seq": 1},
+        ]
+        
+        assert await server_core.store_beacon_results("beacon-1", batch) == 2
+        server_core.db_manager.store_command_result.assert_called_once_with(
+            command_id="cmd-1", beacon_id="beacon-1", output="x", success=True
+        )
+    
+    @pytest.mark.asyncio
+    async def test_registration_restarts_numbering(self, server_core):
+        """Test that a restarted beacon's sequence numbers are not taken as retransmits"""
+        await server_core.store_beacon_results("beacon-1", [{"command_id": "cmd-1", "result_seq": 5}])
+        
+        ack = await server_core.store_beacon_results("beacon-1", [{"command_id": "cmd-2", "result_seq": 0}],
+                                                     registered=True)
+        
+        assert ack == 1
+        assert server_core.db_manager.store_command_result.call_count == 2
+    
+    @pytest.mark.asyncio
+    async def test_unnumbered_results_not_acknowledged(self, server_core):
+        """Test that results from older beacons are stored with no acknowledgement"""
+        assert await server_core.store_beacon_results("beacon-1", [{"command_id": "cmd-1"}]) is None
+        server_core.db_manager.store_command_result.assert_called_once()
+
+
+class TestCheckinTokens:
+    """Test check-in tokens and delta-encoded system_info"""
+    
+    async def _register(self, server_core, beacon_id, system_info=None):
+        await server_core._handle_beacon_checkin({
+            "beacon_id": beacon_id,
+            "data": {"system_info": system_info or {"hostname": "host", "pid": 1}}
+        })
+    
+    @pytest.mark.asyncio
+    async def test_token_resolves_to_its_beacon(self, server_core):
+        """Test that each token leads back to the beacon it was issued to, and is reissued unchanged"""
+        await self._register(server_core, "beacon-1")
+        await self._register(server_core, "beacon-2")
+        
+        first = server_core.issue_checkin_token("beacon-1")
+        second = server_core.issue_checkin_token("beacon-2")
+        
+        assert first != second
+        assert server_core.issue_checkin_token("beacon-1") == first
+        assert server_core.resolve_checkin_token(first) == "beacon-1"
+        assert server_core.resolve_checkin_token(second) == "beacon-2"
+    
+    @pytest.mark.asyncio
+    async def test_unknown_tokens_rejected(self, server_core):
+        """Test that forged, out-of-range and malformed tokens resolve to nothing"""
+        await self._register(server_core, "beacon-1")
+        token = server_core.issue_checkin_token("beacon-1")
+        index, _, check = token.partition(".")
+        
+        assert server_core.resolve_checkin_token(f"{index}.{'0' * len(check)}") is None
+        assert server_core.resolve_checkin_token(f"ff.{check}") is None
+        assert server_core.resolve_checkin_token(f"-1.{check}") is None
+        assert server_core.resolve_checkin_token("session") is None
+        assert server_core.issue_checkin_token("beacon-unknown") is None
+    
+    @pytest.mark.asyncio
+    async def test_system_info_delta_merged(self, server_core):
+        """Test that a later check-in's system_info updates only the fields it carries"""
+        await self._register(server_core, "beacon-1", {"hostname": "host", "pid": 1, "cwd": "/"})
+        await self._register(server_core, "beacon-1", {"cwd": "/tmp"})
+        
+        assert server_core.beacons["beacon-1"]["system_info"] == {"hostname": "host", "pid": 1, "cwd": "/tmp"}
+
+
+class TestFileTransfer:
+    """Test assembly of downloads and windowing of uploads"""
+    
+    @pytest.mark.asyncio
+    async def test_download_written_by_offset(self, server_core, tmp_path):
+        """Test that chunks land at their offsets and the file appears once complete"""
+        local = tmp_path / "loot.bin"
+        command_id = await server_core.start_download("beacon-1", "/etc/remote", str(local))
+        chunks = [
+            {"data": base64.b64encode(b"\x00\x01").decode(), "offset": 0, "final": False},
+            {"data": b"\xfe\xff", "offset": 2, "final": True},
+        ]
+        
+        for i, chunk in enumerate(chunks):
+            await server_core.store_beacon_results("beacon-1", [dict(chunk, command_id=command_id, result_seq=i)])
+        
+        assert local.read_bytes() == b"\x00\x01\xfe\xff"
+        assert not (tmp_path / "loot.bin.part").exists()
+        assert server_core.downloads == {}
+        server_core.db_manager.store_command_result.assert_called_once_with(
+            command_id=command_id, beacon_id="beacon-1", output=f"Downloaded 4 bytes to {local}", success=True
+        )
+    
+    @pytest.mark.asyncio
+    async def test_download_resumes_from_partial_file(self, server_core, tmp_path):
+        """Test that a restarted download asks only for the bytes not yet on disk"""
+        local = tmp_path / "loot.bin"
+        (tmp_path / "loot.bin.part").write_bytes(b"abc")
+        
+        command_id = await server_core.start_download("beacon-1", "/etc/remote", str(local))
+        await server_core._handle_beacon_output({
+            "beacon_id": "beacon-1", "command_id": command_id, "data": b"def", "offset": 3, "final": True
+        })
+        
+        server_core.db_manager.create_command.assert_called_once_with(
+            command_id=command_id, beacon_id="beacon-1", command="download",
+            args={"path": "/etc/remote", "offset": 3}
+        )
+        assert local.read_bytes() == b"abcdef"
+    
+    @pytest.mark.asyncio
+    async def test_upload_window_refilled_and_resumed(self, server_core, tmp_path):
+        """Test that acknowledged chunks open the window and a failed upload restarts at the gap"""
+        source = tmp_path / "tool.bin"
+        source.write_bytes(b"0123456789")
+        server_core.TRANSFER_CHUNK_SIZE = 4
+        server_core.UPLOAD_WINDOW = 2
+        
+        def queued():
+            return [call.kwargs for call in server_core.db_manager.create_command.call_args_list]
+        
+        await server_core.start_upload("beacon-1", str(source), "/tmp/tool")
+        assert [args["args"]["offset"] for args in queued()] == [0, 4]
+        
+        # The first chunk lands, the second fails: the window refills once, then stops
+        first, second = queued()
+        await server_core._handle_beacon_output({"beacon_id": "beacon-1", "command_id": first["command_id"]})
+        await server_core._handle_beacon_output({
+            "beacon_id": "beacon-1", "command_id": second["command_id"], "success": False
+        })
+        assert [args["args"]["offset"] for args in queued()] == [0, 4, 8]
+        assert queued()[2]["args"]["final"] is True
+        
+        await server_core.start_upload("beacon-1", str(source), "/tmp/tool")
+        resumed = queued()[3]["args"]
+        assert resumed["offset"] == 4
+        assert base64.b64decode(resumed["data"]) == b"4567"
+
+
+class TestSchedules:
+    """Test recurring commands run on the beacon's own timer"""
+    
+    @pytest.mark.asyncio
+    async def test_schedule_queued_once(self, server_core):
+        """Test that a schedule is one command carrying the interval and count"""
+        schedule_id = await server_core.schedule_command("beacon-1", "shell", {"cmd": "id"}, 60, 3)
+        
+        server_core.db_manager.create_command.assert_called_once_with(
+            command_id=schedule_id, beacon_id="beacon-1", command="schedule",
+            args={"command": "shell", "args": {"cmd": "id"}, "interval": 60, "count": 3}
+        )
+        assert len(f"{schedule_id}.3") <= 36
+    
+    @pytest.mark.asyncio
+    async def test_runs_recorded_until_count(self, server_core):
+        """Test that each run gets its own command record and the schedule ends with the last"""
+        schedule_id = await server_core.schedule_command("beacon-1", "pwd", {}, 1, 2)
+        server_core.db_manager.create_command.reset_mock()
+        
+        for run in (1, 2):
+            await server_core._handle_beacon_output({
+                "beacon_id": "beacon-1", "command_id": f"{schedule_id}.{run}", "output": "/tmp", "success": True
+            })
+        
+        assert [call.kwargs["command_id"] for call in server_core.db_manager.create_command.call_args_list] == [
+            f"{schedule_id}.1", f"{schedule_id}.2"
+        ]
+        assert server_core.db_manager.create_command.call_args.kwargs["status"] == "sent"
+        assert server_core.schedules == {}
+    
+    @pytest.mark.asyncio
+    async def test_refused_schedule_dropped(self, server_core):
+        """Test that a schedule the beacon turned down is forgotten"""
+        schedule_id = await server_core.schedule_command("beacon-1", "exit", {}, 1, 2)
+        await server_core._handle_beacon_output({
+            "beacon_id": "beacon-1", "command_id": schedule_id, "output": "Command exit cannot be scheduled",
+            "success": False
+        })
+        
+        assert server_core.schedules == {}
+    
+    @pytest.mark.asyncio
+    async def test_runs_after_cancel_recorded(self, server_core):
+        """Test that runs reported after a cancel still get a command record before their result"""
+        schedule_id = await server_core.schedule_command("beacon-1", "pwd", {}, 1, 5)
+        schedule_row = server_core.db_manager.create_command.call_args.kwargs
+        server_core.db_manager.get_command.return_value = {
+            "id": schedule_id, "beacon_id": "beacon-1", "command": "schedule", "args": schedule_row["args"]
+        }
+        cancel_id = await server_core.cancel_schedule("beacon-1", schedule_id)
+        server_core.db_manager.create_command.reset_mock()
+        
+        # One run lands before the cancel reaches the beacon, one after the cancel's result
+        for command_id in (f"{schedule_id}.1", cancel_id, f"{schedule_id}.2"):
+            await server_core._handle_beacon_output({
+                "beacon_id": "beacon-1", "command_id": command_id, "output": "/tmp", "success": True
+            })
+            if command_id == cancel_id:
+                assert server_core.schedules == {}
+        
+        assert [call.kwargs for call in server_core.db_manager.create_command.call_args_list] == [
+            {"command_id": f"{schedule_id}.{run}", "beacon_id": "beacon-1", "command": "pwd", "args": {},
+             "status": "sent"}
+            for run in (1, 2)
+        ]
+        server_core.db_manager.get_command.assert_called_once_with(schedule_id)
+        assert server_core.schedule_cancels == {}
+
+
+class TestTelemetry:
+    """Test aggregation of beacon check-in timings"""
+    
+    def test_histograms_merged_per_listener(self, server_core):
+        """Test that summaries from several beacons add up under their listener"""
+        server_core.record_telemetry("http", {"ttfb": {"count": 2, "sum_us": 300, "max_us": 200,
+                                                       "buckets": [[7, 1], [8, 1]]}})
+        server_core.record_telemetry("http", {"ttfb": {"count": 2, "failures": 1, "sum_us": 5000,
+                                                       "max_us": 4000, "buckets": [[8, 1], [12, 1]]}})
+        server_core.record_telemetry("https", {"connect": {"count": 1, "sum_us": 50, "max_us": 50,
+                                                           "buckets": [[6, 1]]}})
+        
+        telemetry = server_core.get_telemetry()
+        
+        assert telemetry["http"]["ttfb"] == {
+            "count": 4, "failures": 1, "mean_us": 1325, "max_us": 4000,
+            "p50_us": 255, "p90_us": 4000, "p99_us": 4000
+        }
+        assert telemetry["https"]["connect"]["p50_us"] == 50
+        assert "connect" not in telemetry["http"]
+    
+    def test_malformed_phases_ignored(self, server_core):
+        """Test that unknown phases and out-of-range buckets are dropped"""
+        server_core.record_telemetry("http", {
+            "made_up": {"count": 1, "buckets": [[1, 1]]},
+            "dns": {"count": 1, "buckets": [[99, 1]]},
+            "parse": {"count": "many"},
+            "send": {"count": 1, "sum_us": 3, "max_us": 3, "buckets": [[2, 1]]}
+        })
+        server_core.record_telemetry("http", ["not", "a", "dict"])
+        
+        assert list(server_core.get_telemetry()["http"]) == ["send"]
+
+
+class TestHTTPListener:
+    """Test HTTP listener tasking"""
+    
+    @pytest.mark.asyncio
+    async def test_queued_commands_respect_accept(self, server_core):
+        """Test that the beacon's accept count limits delivered commands"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        server_core.db_manager.get_pending_commands.return_value = [{"id": "cmd-1"}]
+        
+        commands = await listener._get_queued_commands("beacon-1", 1)
+        
+        assert commands == [{"id": "cmd-1"}]
+        server_core.db_manager.get_pending_commands.assert_called_once_with("beacon-1", 1)
+    
+    @pytest.mark.asyncio
+    async def test_no_commands_when_beacon_full(self, server_core):
+        """Test that a beacon reporting no room receives nothing"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        
+        commands = await listener._get_queued_commands("beacon-1", 0)
+        
+        assert commands == []
+        server_core.db_manager.get_pending_commands.assert_not_called()
+    
+    @pytest.mark.asyncio
+    async def test_long_poll_woken_by_queued_command(self, server_core):
+        """Test that queuing a command releases a held check-in"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        server_core.db_manager.get_pending_commands.side_effect = [[], [{"id": "cmd-1"}]]
+        
+        poll = asyncio.ensure_future(listener._get_queued_commands("beacon-1", 4, 30))
+        await asyncio.sleep(0)
+        assert not poll.done()
+        
+        await server_core._queue_beacon_command("beacon-1", "shell", {"cmd": "whoami"})
+        
+        assert await asyncio.wait_for(poll, 1) == [{"id": "cmd-1"}]
+    
+    @pytest.mark.asyncio
+    async def test_long_poll_times_out_empty(self, server_core):
+        """Test that a held check-in with nothing queued returns empty after the wait"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        server_core.db_manager.get_pending_commands.return_value = []
+        
+        commands = await listener._get_queued_commands("beacon-1", 4, 0.05)
+        
+        assert commands == []
+        server_core.db_manager.get_pending_commands.assert_called_once_with("beacon-1", 4)
+    
+    def test_deflated_body_decoded(self, server_core):
+        """Test that a deflated check-in body is inflated"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        body = json.dumps({"command_results": [{"output": "x" * 4096}]}).encode()
+        
+        assert listener._decode_body(zlib.compress(body), "deflate") == body
+        assert listener._decode_body(body, None) == body
+    
+    def test_unsupported_encoding_rejected(self, server_core):
+        """Test that unknown or oversized encoded bodies are refused"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        listener.MAX_INFLATED_SIZE = 1024
+        
+        with pytest.raises(ValueError):
+            listener._decode_body(b"{}", "br")
+        with pytest.raises(ValueError):
+            listener._decode_body(zlib.compress(b"x" * 4096), "deflate")
+    
+    def test_reply_deflated_when_accepted(self, server_core):
+        """Test that large replies are deflated only for beacons that accept it"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        commands = [{"id": f"cmd-{i}", "command": "shell", "args": "whoami"} for i in range(64)]
+        
+        compressed = listener._encode_response(commands, "deflate")
+        plain = listener._encode_response(commands, "")
+        
+        assert compressed.headers["Content-Encoding"] == "deflate"
+        assert json.loads(zlib.decompress(compressed.body)) == {"commands": commands}
+        assert "Content-Encoding" not in plain.headers
+        assert plain.headers["Accept-Encoding"] == "deflate"
+    
+    def test_reply_carries_ack(self, server_core):
+        """Test that the result acknowledgement is sent alongside the commands"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        
+        assert json.loads(listener._encode_response([], "", ack=7).body) == {"commands": [], "ack": 7}
+        assert json.loads(listener._encode_response([], "").body) == {"commands": []}
+    
+    def test_reply_carries_session(self, server_core):
+        """Test that a newly issued check-in token is sent alongside the commands"""
+        listener = HTTPListener("127.0.0.1", 8080, server_core)
+        
+        reply = json.loads(listener._encode_response([], "", session="0.deadbeef").body)
+        
+        assert reply == {"commands": [], "session": "0.deadbeef"}
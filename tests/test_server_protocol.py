@@ -0,0 +1,167 @@
+"""
+Tests for Ghost Protocol binary check-in framing
+"""
+
+import struct
+import pytest
+from ghost_protocol.server import protocol
+
+
+def record(record_type, value):
+    """Build one TLV record"""
+    return struct.pack(">BI", record_type, len(value)) + value
+
+
+class TestDecodeCheckin:
+    """Test decoding of beacon check-ins"""
+    
+    def test_checkin_decoded_like_json(self):
+        """Test that every section decodes to the JSON field names"""
+        result = (record(protocol.TLV_COMMAND_ID, b"cmd-1") +
+                  record(protocol.TLV_SUCCESS, b"\x01") +
+                  record(protocol.TLV_OUTPUT, "café\n".encode()) +
+                  record(protocol.TLV_SEQUENCE, struct.pack(">I", 3)) +
+                  record(protocol.TLV_FINAL, b"\x00"))
+        backpressure = (record(0x32, struct.pack(">Q", 5 << 32)) +
+                        record(0x34, struct.pack(">I", 12)))
+        body = (protocol.TLV_MAGIC +
+                record(protocol.TLV_BEACON_ID, b"beacon-1") +
+                record(protocol.TLV_SYSTEM_INFO, record(0x11, b"host") + record(0x16, struct.pack(">I", 4242))) +
+                record(protocol.TLV_RESULT, result) +
+                record(protocol.TLV_BACKPRESSURE, backpressure) +
+                record(0x7F, b"ignored"))
+        
+        checkin = protocol.decode_checkin(body)
+        
+        assert checkin["beacon_id"] == "beacon-1"
+        assert checkin["system_info"] == {"hostname": "host", "pid": 4242}
+        assert checkin["command_results"] == [{
+            "command_id": "cmd-1", "success": True, "output": "café\n", "sequence": 3, "final": False
+        }]
+        assert checkin["backpressure"] == {"queued_bytes": 5 << 32, "accept": 12}
+    
+    def test_file_chunk_kept_as_bytes(self):
+        """Test that download data is passed through raw rather than decoded as text"""
+        result = (record(protocol.TLV_COMMAND_ID, b"cmd-1") +
+                  record(protocol.TLV_FILE_DATA, b"\xff\x00\xfe") +
+                  record(protocol.TLV_OFFSET, struct.pack(">Q", 1 << 33)) +
+                  record(protocol.TLV_FINAL, b"\x01"))
+        body = protocol.TLV_MAGIC + record(protocol.TLV_RESULT, result)
+        
+        assert protocol.decode_checkin(body)["command_results"] == [{
+            "command_id": "cmd-1", "data": b"\xff\x00\xfe", "offset": 1 << 33, "final": True
+        }]
+    
+    def test_telemetry_decoded(self):
+        """Test that phase histograms decode to the JSON telemetry shape"""
+        phase = (record(protocol.TLV_PHASE_NAME, b"ttfb") +
+                 record(0x63, struct.pack(">I", 3)) +
+                 record(0x65, struct.pack(">Q", 4000)) +
+                 record(0x66, struct.pack(">Q", 2000)) +
+                 record(protocol.TLV_PHASE_BUCKETS, struct.pack(">BIBI", 10, 1, 11, 2)))
+        body = (protocol.TLV_MAGIC +
+                record(protocol.TLV_BEACON_ID, b"beacon-1") +
+                record(protocol.TLV_TELEMETRY, record(protocol.TLV_PHASE, phase)))
+        
+        checkin = protocol.decode_checkin(body)
+        
+        assert checkin["telemetry"] == {
+            "ttfb": {"count": 3, "sum_us": 4000, "max_us": 2000, "buckets": [[10, 1], [11, 2]]}
+        }
+    
+    def test_truncated_record_rejected(self):
+        """Test that a record running past the body is refused"""
+        body = protocol.TLV_MAGIC + struct.pack(">BI", protocol.TLV_BEACON_ID, 10) + b"short"
+        
+        with pytest.raises(ValueError):
+            protocol.decode_checkin(body)
+        with pytest.raises(ValueError):
+            protocol.decode_checkin(b'{"beacon_id": "json"}')
+
+
+class TestEncodeCommands:
+    """Test encoding of command batches"""
+    
+    def test_commands_round_trip(self):
+        """Test that commands encode as one container each with raw fields"""
+        body = protocol.encode_commands([
+            {"id": "cmd-1", "command": "shell", "args": {"cmd": "whoami"}},
+            {"id": "cmd-2", "command": "pwd", "args": None},
+        ])
+        
+        assert protocol.is_tlv(body)
+        commands = []
+        for record_type, value in protocol.iter_records(memoryview(body)[len(protocol.TLV_MAGIC):]):
+            assert record_type == protocol.TLV_COMMAND
+            commands.append({t: bytes(v) for t, v in protocol.iter_records(value)})
+        
+        assert commands == [
+            {protocol.TLV_COMMAND_ID: b"cmd-1", protocol.TLV_COMMAND_NAME: b"shell",
+             protocol.TLV_COMMAND_ARGS: b'{"cmd": "whoami"}', protocol.TLV_COMMAND_OPCODE: b"\x01"},
+            {protocol.TLV_COMMAND_ID: b"cmd-2", protocol.TLV_COMMAND_NAME: b"pwd",
+             protocol.TLV_COMMAND_ARGS: b"", protocol.TLV_COMMAND_OPCODE: b"\x02"},
+        ]
+    
+    def test_unknown_command_sent_by_name(self):
+        """Test that a command without an opcode is sent with its name only"""
+        body = protocol.encode_commands([{"id": "cmd-1", "command": "screenshot", "args": None}])
+        
+        (_, value), = protocol.iter_records(memoryview(body)[len(protocol.TLV_MAGIC):])
+        assert [t for t, _ in protocol.iter_records(value)] == [
+            protocol.TLV_COMMAND_ID, protocol.TLV_COMMAND_NAME, protocol.TLV_COMMAND_ARGS]
+    
+    def test_ack_encoded_first(self):
+        """Test that the result acknowledgement leads the reply"""
+        body = protocol.encode_commands([], 2 ** 40)
+        
+        records = list(protocol.iter_records(memoryview(body)[len(protocol.TLV_MAGIC):]))
+        assert [(t, int.from_bytes(v, "big")) for t, v in records] == [(protocol.TLV_ACK, 2 ** 40)]
+    
+    def test_session_encoded(self):
+        """Test that a check-in token is sent as its own top-level record"""
+        body = protocol.encode_commands([], None, "0.deadbeef")
+        
+        records = [(t, bytes(v)) for t, v in protocol.iter_records(memoryview(body)[len(protocol.TLV_MAGIC):])]
+        assert records == [(protocol.TLV_SESSION, b"0.deadbeef")]
+
+
+@pytest.mark.skipif(protocol._codec is None, reason="native codec not built (make codec)")
+class TestNativeCodec:
+    """Test that the C codec matches the pure-Python reference"""
+    
+    def test_checkin_matches_reference(self, monkeypatch):
+        """Test that every section, and every truncation of it, decodes the same way"""
+        result = (record(protocol.TLV_COMMAND_ID, b"cmd-\xff") +
+                  record(protocol.TLV_FILE_DATA, b"\x00\x01") +
+                  record(protocol.TLV_OFFSET, struct.pack(">Q", 1 << 40)) +
+                  record(protocol.TLV_FINAL, b"\x00\x01"))
+        phase = (record(protocol.TLV_PHASE_NAME, b"ttfb") +
+                 record(protocol.TLV_PHASE_BUCKETS, struct.pack(">BIBI", 10, 1, 11, 2)))
+        body = (protocol.TLV_MAGIC +
+                record(protocol.TLV_BEACON_ID, b"beacon-1") +
+                record(protocol.TLV_SYSTEM_INFO, record(0x10, b"host") + record(0x7f, b"?")) +
+                record(protocol.TLV_RESULT, result) +
+                record(protocol.TLV_TELEMETRY, record(protocol.TLV_PHASE, phase)))
+        
+        def decode(codec, data):
+            monkeypatch.setattr(protocol, "_codec", codec)
+            try:
+                return protocol.decode_checkin(data)
+            except ValueError as error:
+                return str(error)
+        
+        native = protocol._codec
+        for end in range(len(body) + 1):
+            assert decode(native, body[:end]) == decode(None, body[:end])
+    
+    def test_commands_match_reference(self, monkeypatch):
+        """Test that a reply batch encodes to the same bytes"""
+        commands = [
+            {"id": "cmd-1", "command": "shell", "args": {"cmd": "whoami"}},
+            {"id": 2, "command": "screenshot"},
+            {"command": "pwd", "args": "é"},
+        ]
+        native = protocol.encode_commands(commands, 2 ** 40, "0.deadbeef")
+        monkeypatch.setattr(protocol, "_codec", None)
+        
+        assert native == protocol.encode_commands(commands, 2 ** 40, "0.deadbeef")